@@ -0,0 +1,93 @@
+#include "assetArchive.hpp"
+#include "logger.hpp"
+#include "profiler.hpp"
+#include <cstring>
+#include <sys/stat.h>
+
+#ifdef CODEQUEST_WITH_LZ4
+#include <lz4.h>
+#endif
+
+bool AssetArchive::open(const std::string& path) {
+    PROFILE_ZONE("archive open");
+    close();
+    if (!file.open(path)) return false;
+
+    PackHeader header;
+    if (file.size() < sizeof(header)) {
+        close();
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, PackMagic, sizeof(PackMagic)) != 0 || header.version != PackVersion || header.tocOffset > file.size()) {
+        LOG_ERROR("Not an asset archive: " << path);
+        close();
+        return false;
+    }
+
+    std::size_t position = static_cast<std::size_t>(header.tocOffset);
+    for (std::uint32_t i = 0; i < header.entryCount; ++i) {
+        PackTocEntry toc;
+        if (position + sizeof(toc) > file.size()) break;
+        std::memcpy(&toc, file.data() + position, sizeof(toc));
+        position += sizeof(toc);
+
+        if (position + toc.nameLength > file.size() || toc.offset + toc.storedSize > file.size()) break;
+        std::string name(reinterpret_cast<const char*>(file.data() + position), toc.nameLength);
+        position += (toc.nameLength + 7) & ~static_cast<std::size_t>(7);
+
+        Entry entry;
+        entry.image.data = file.data() + toc.offset;
+        entry.image.storedSize = static_cast<std::size_t>(toc.storedSize);
+        entry.image.width = toc.width;
+        entry.image.height = toc.height;
+        entry.image.compression = toc.compression;
+        entry.sourceSize = toc.sourceSize;
+        entry.sourceMtime = toc.sourceMtime;
+
+        if (entry.image.compression == PackRaw && entry.image.storedSize != entry.image.pixelBytes()) continue;
+#ifndef CODEQUEST_WITH_LZ4
+        if (entry.image.compression == PackLz4) continue;
+#endif
+        images[name] = entry;
+    }
+
+    LOG_INFO("Opened asset archive " << path << " with " << images.size() << " images");
+    return true;
+}
+
+void AssetArchive::close() {
+    images.clear();
+    file.close();
+}
+
+const PackedImage* AssetArchive::find(const std::string& imageName) const {
+    auto found = images.find(imageName);
+    if (found == images.end()) return nullptr;
+
+    // Fall back to the PNG if it was replaced after packing
+    struct stat info;
+    if (stat(("images/" + imageName).c_str(), &info) == 0 &&
+        (static_cast<std::uint64_t>(info.st_size) != found->second.sourceSize ||
+         static_cast<std::int64_t>(info.st_mtime) != found->second.sourceMtime)) {
+        return nullptr;
+    }
+    return &found->second.image;
+}
+
+bool AssetArchive::unpack(const PackedImage& image, sf::Uint8* out) {
+    switch (image.compression) {
+    case PackRaw:
+        std::memcpy(out, image.data, image.pixelBytes());
+        return true;
+#ifdef CODEQUEST_WITH_LZ4
+    case PackLz4: {
+        int written = LZ4_decompress_safe(reinterpret_cast<const char*>(image.data), reinterpret_cast<char*>(out),
+                                          static_cast<int>(image.storedSize), static_cast<int>(image.pixelBytes()));
+        return written == static_cast<int>(image.pixelBytes());
+    }
+#endif
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <SFML/Config.hpp>
+#include "mappedFile.hpp"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// On-disk layout of images/assets.pak, written by the packer tool:
+//   PackHeader, then one page-aligned pixel block per image (raw RGBA or LZ4),
+//   then the table of contents at header.tocOffset: per image a PackTocEntry
+//   followed by its name, padded to 8 bytes.
+struct PackHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t entryCount;
+    std::uint64_t tocOffset;
+    std::uint64_t reserved;
+};
+
+struct PackTocEntry {
+    std::uint64_t offset;
+    std::uint64_t storedSize;
+    std::uint64_t sourceSize;  // of the PNG the block was made from, to detect stale blocks
+    std::int64_t sourceMtime;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t compression;
+    std::uint32_t nameLength;
+};
+
+enum PackCompression : std::uint32_t {
+    PackRaw = 0,
+    PackLz4 = 1
+};
+
+const char PackMagic[8] = {'C', 'Q', 'P', 'A', 'C', 'K', '0', '1'};
+const std::uint32_t PackVersion = 1;
+const std::size_t PackAlignment = 4096;
+
+// Pixel block of one image inside the mapped archive
+struct PackedImage {
+    const sf::Uint8* data;
+    std::size_t storedSize;
+    unsigned width;
+    unsigned height;
+    std::uint32_t compression;
+
+    std::size_t pixelBytes() const { return static_cast<std::size_t>(width) * height * 4; }
+};
+
+// Memory maps a packed archive so raw blocks can be handed straight to
+// sf::Texture::update without being copied or decoded.
+class AssetArchive {
+public:
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return file.isOpen(); }
+    std::size_t size() const { return images.size(); }
+
+    // Returns the block for images/<imageName>, or nullptr if it is not packed
+    // or the PNG has changed since it was packed
+    const PackedImage* find(const std::string& imageName) const;
+
+    // Expands a block into out (pixelBytes() bytes). Raw blocks are copied.
+    static bool unpack(const PackedImage& image, sf::Uint8* out);
+
+private:
+    struct Entry {
+        PackedImage image;
+        std::uint64_t sourceSize;
+        std::int64_t sourceMtime;
+    };
+
+    MappedFile file;
+    std::unordered_map<std::string, Entry> images;
+};
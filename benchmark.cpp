@@ -0,0 +1,618 @@
+#include <SFML/Graphics.hpp>
+#include "catalog.hpp"
+#include "catalogWriter.hpp"
+#include "imageDecoder.hpp"
+#include "ImageFunctions.hpp"
+#include "logger.hpp"
+#include "resample.hpp"
+#include "searchIndex.hpp"
+#include "threadPool.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <unistd.h>
+#endif
+
+// Headless benchmarks for the loading, decoding, catalog and search paths. Synthetic fixtures are
+// generated under a scratch directory and every scenario runs there without a
+// window. Results are printed as one JSON object per line on stdout; the
+// loaders' own logging is discarded while they are timed.
+//
+// usage: benchmark [--quick] [--data DIR] [--font PATH]
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Scale {
+    std::size_t images;
+    int topics;
+};
+
+double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+double percentile(std::vector<double> samples, double p) {
+    if (samples.empty()) return 0.0;
+    std::size_t rank = static_cast<std::size_t>(p / 100.0 * (samples.size() - 1) + 0.5);
+    std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+    return samples[rank];
+}
+
+double mean(const std::vector<double>& samples) {
+    double sum = 0.0;
+    for (double sample : samples) sum += sample;
+    return samples.empty() ? 0.0 : sum / samples.size();
+}
+
+void emit(const std::string& bench, std::initializer_list<std::pair<const char*, double>> fields) {
+    std::ostringstream line;
+    line << "{\"bench\":\"" << bench << "\"";
+    for (const auto& field : fields) {
+        line << ",\"" << field.first << "\":" << field.second;
+    }
+    line << "}";
+    std::cout << line.str() << std::endl;
+}
+
+// Mutes the log for as long as it lives, so timings do not include console output
+class Silence {
+public:
+    Silence() : level(Logger::instance().level()) {
+        Logger::instance().flush();
+        Logger::instance().setLevel(LogLevel::Off);
+    }
+    ~Silence() { Logger::instance().setLevel(level); }
+
+private:
+    LogLevel level;
+};
+
+bool makeDirectory(const std::string& path) {
+#ifdef _WIN32
+    return _mkdir(path.c_str()) == 0 || errno == EEXIST;
+#else
+    return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+bool changeDirectory(const std::string& path) {
+#ifdef _WIN32
+    return _chdir(path.c_str()) == 0;
+#else
+    return chdir(path.c_str()) == 0;
+#endif
+}
+
+bool fileExists(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0;
+}
+
+std::string imageName(std::size_t index) {
+    return "bench" + std::to_string(index) + ".png";
+}
+
+// Spreads the images round robin over the topics' text lists
+void writeTextLists(const Scale& scale) {
+    for (int topic = 0; topic < scale.topics; ++topic) {
+        std::ofstream list(TopicRegistry::listPath(topic));
+        for (std::size_t i = topic; i < scale.images; i += scale.topics) {
+            list << imageName(i) << "\n";
+        }
+    }
+}
+
+void benchTextLists(const Scale& scale, ThreadPool& pool) {
+    writeTextLists(scale);
+
+    std::vector<double> runs;
+    for (int run = 0; run < 3; ++run) {
+        TextureCache cache(TextureCache::DefaultByteBudget, &pool);
+        std::vector<std::vector<ImageHandle>> images(scale.topics);
+        Clock::time_point start = Clock::now();
+        {
+            Silence silence;
+            loadImagesFromTextFilesRecursively(0, cache, images);
+        }
+        runs.push_back(millisecondsSince(start));
+    }
+    emit("text_list_parse", {{"images", static_cast<double>(scale.images)}, {"topics", static_cast<double>(scale.topics)},
+                             {"best_ms", *std::min_element(runs.begin(), runs.end())}, {"mean_ms", mean(runs)},
+                             {"ns_per_image", *std::min_element(runs.begin(), runs.end()) * 1e6 / scale.images}});
+
+    // Unchanged lists, so this is the cost of re-reading and diffing every topic
+    TextureCache cache(TextureCache::DefaultByteBudget, &pool);
+    std::vector<std::vector<ImageHandle>> images(scale.topics);
+    std::vector<double> reloads;
+    {
+        Silence silence;
+        loadImagesFromTextFilesRecursively(0, cache, images);
+        for (int run = 0; run < 3; ++run) {
+            Clock::time_point start = Clock::now();
+            reloadImages(cache, images);
+            reloads.push_back(millisecondsSince(start));
+        }
+    }
+    emit("reload_images", {{"images", static_cast<double>(scale.images)}, {"topics", static_cast<double>(scale.topics)},
+                           {"best_ms", *std::min_element(reloads.begin(), reloads.end())}, {"mean_ms", mean(reloads)}});
+}
+
+void benchCatalog(const Scale& scale, const std::string& probeImage) {
+    std::remove("texts/catalog.bin");
+
+    Catalog catalog;
+    if (!catalog.open("texts/catalog.bin")) {
+        std::cerr << "Could not create the benchmark catalog" << std::endl;
+        return;
+    }
+
+    Clock::time_point start = Clock::now();
+    for (std::size_t i = 0; i < scale.images; ++i) {
+        CatalogEntry entry;
+        entry.name = imageName(i);
+        entry.topic = static_cast<int>(i % scale.topics);
+        entry.width = 1280;
+        entry.height = 720;
+        entry.fileSize = 4096;
+        entry.contentHash = i;
+        catalog.add(entry);
+    }
+    double buildMs = millisecondsSince(start);
+    emit("catalog_build", {{"images", static_cast<double>(scale.images)}, {"topics", static_cast<double>(scale.topics)},
+                           {"ms", buildMs}, {"us_per_add", buildMs * 1e3 / scale.images}});
+
+    catalog.close();
+    start = Clock::now();
+    catalog.open("texts/catalog.bin");
+    emit("catalog_open", {{"images", static_cast<double>(scale.images)}, {"topics", static_cast<double>(scale.topics)},
+                          {"ms", millisecondsSince(start)}});
+
+    std::vector<std::vector<ImageHandle>> images(catalog.topicCount());
+    TextureCache cache;
+    start = Clock::now();
+    loadImagesFromCatalog(catalog, cache, images);
+    emit("load_from_catalog", {{"images", static_cast<double>(scale.images)}, {"topics", static_cast<double>(scale.topics)},
+                               {"ms", millisecondsSince(start)}});
+
+    // Edits go through the same helpers as the input boxes, so they read real files
+    const std::size_t edits = 500;
+    std::vector<std::string> names;
+    {
+        std::ifstream probe(probeImage, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(probe)), std::istreambuf_iterator<char>());
+        for (std::size_t i = 0; i < edits; ++i) {
+            names.push_back("edit" + std::to_string(i) + ".png");
+            std::ofstream("images/" + names.back(), std::ios::binary) << bytes;
+        }
+    }
+
+    std::vector<double> addLatency, deleteLatency;
+    {
+        Silence silence;
+        for (const auto& name : names) {
+            Clock::time_point editStart = Clock::now();
+            addImageNameToTopic(catalog, 0, name);
+            addLatency.push_back(millisecondsSince(editStart) * 1e3);
+        }
+        for (const auto& name : names) {
+            Clock::time_point editStart = Clock::now();
+            deleteImageNameFromTopic(catalog, 0, name);
+            deleteLatency.push_back(millisecondsSince(editStart) * 1e3);
+        }
+    }
+
+    emit("add_image", {{"images", static_cast<double>(scale.images)}, {"topics", static_cast<double>(scale.topics)},
+                       {"p50_us", percentile(addLatency, 50)}, {"p99_us", percentile(addLatency, 99)}, {"mean_us", mean(addLatency)}});
+    emit("delete_image", {{"images", static_cast<double>(scale.images)}, {"topics", static_cast<double>(scale.topics)},
+                          {"p50_us", percentile(deleteLatency, 50)}, {"p99_us", percentile(deleteLatency, 99)}, {"mean_us", mean(deleteLatency)}});
+
+    // A whole deck through the write-behind path, then removed again, which also triggers compaction.
+    // longest_update_ms is what the UI thread pays in its worst frame.
+    const std::size_t deck = 5000;
+    {
+        std::ifstream probe(probeImage, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(probe)), std::istreambuf_iterator<char>());
+        for (std::size_t i = edits; i < deck; ++i) {
+            names.push_back("edit" + std::to_string(i) + ".png");
+            std::ofstream("images/" + names.back(), std::ios::binary) << bytes;
+        }
+    }
+
+    ThreadPool pool;
+    CatalogWriter writer(catalog, pool);
+    int deckTopic = static_cast<int>(scale.topics);
+    auto runBatch = [&](const char* bench, const std::vector<std::string>& list) {
+        Clock::time_point batchStart = Clock::now();
+        double longestUpdate = 0;
+        {
+            Silence silence;
+            writer.replace(deckTopic, list);
+            writer.submit();
+            do {
+                Clock::time_point updateStart = Clock::now();
+                writer.update();
+                longestUpdate = std::max(longestUpdate, millisecondsSince(updateStart));
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            } while (writer.isBusy());
+        }
+        double total = millisecondsSince(batchStart);
+        emit(bench, {{"images", static_cast<double>(scale.images)}, {"slides", static_cast<double>(list.size())},
+                     {"ms", total}, {"longest_update_ms", longestUpdate}, {"catalog_records", static_cast<double>(catalog.size() + catalog.deadCount())}});
+    };
+    runBatch("bulk_import", names);
+    runBatch("bulk_remove", std::vector<std::string>());
+
+    for (const auto& name : names) {
+        std::remove(("images/" + name).c_str());
+    }
+}
+
+std::vector<sf::Uint8> syntheticPixels(unsigned width, unsigned height, unsigned seed) {
+    std::vector<sf::Uint8> pixels(static_cast<std::size_t>(width) * height * 4);
+    unsigned state = seed * 2654435761u + 1;
+    for (unsigned y = 0; y < height; ++y) {
+        for (unsigned x = 0; x < width; ++x) {
+            state = state * 1664525u + 1013904223u;
+            sf::Uint8* pixel = &pixels[(static_cast<std::size_t>(y) * width + x) * 4];
+            pixel[0] = static_cast<sf::Uint8>(x * 255 / width);
+            pixel[1] = static_cast<sf::Uint8>(y * 255 / height);
+            pixel[2] = static_cast<sf::Uint8>(state >> 24) & 0x3F; // some noise so PNG does not collapse it
+            pixel[3] = 255;
+        }
+    }
+    return pixels;
+}
+
+std::vector<std::string> writeDecodeImages(std::size_t count, unsigned width, unsigned height) {
+    std::vector<std::string> names;
+    for (std::size_t i = 0; i < count; ++i) {
+        names.push_back("decode" + std::to_string(i) + ".png");
+        if (fileExists("images/" + names.back())) continue;
+
+        std::vector<sf::Uint8> pixels = syntheticPixels(width, height, static_cast<unsigned>(i));
+        sf::Image image;
+        image.create(width, height, pixels.data());
+        image.saveToFile("images/" + names.back());
+    }
+    return names;
+}
+
+// Decoding runs on the pool and never touches the GPU, so it is measured up to
+// the point the results are queued for upload
+void benchDecode(const std::vector<std::string>& names, const sf::Vector2u& fitArea, const char* bench, ThreadPool& pool) {
+    TextureCache cache(TextureCache::DefaultByteBudget, &pool);
+    cache.setDisplaySize(fitArea);
+
+    std::vector<ImageHandle> handles;
+    for (const auto& name : names) {
+        handles.push_back(cache.acquire(name));
+    }
+
+    Clock::time_point start = Clock::now();
+    for (const auto& handle : handles) {
+        cache.request(handle);
+    }
+    while (cache.progress().decoded < handles.size()) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    double ms = millisecondsSince(start);
+
+    emit(bench, {{"images", static_cast<double>(names.size())}, {"workers", static_cast<double>(pool.workerCount())},
+                 {"ms", ms}, {"images_per_s", names.size() * 1e3 / ms}});
+}
+
+// Each registered decoder on the same images, from memory and on one thread so
+// the numbers are the decoder's own and not the disk's or the pool's
+void benchDecoders(const std::vector<std::string>& names) {
+    DecoderRegistry& decoders = DecoderRegistry::instance();
+    std::vector<std::vector<unsigned char>> pngs;
+    std::vector<std::vector<sf::Uint8>> reference;
+    std::vector<sf::Vector2u> sizes;
+    for (const auto& name : names) {
+        std::ifstream in("images/" + name, std::ios::binary);
+        pngs.emplace_back((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        reference.emplace_back();
+        sizes.emplace_back();
+        if (!decoders.decode(pngs.back().data(), pngs.back().size(), reference.back(), sizes.back())) return;
+    }
+
+    std::vector<std::vector<std::vector<unsigned char>>> formats = {pngs, {}, {}};
+    for (std::size_t i = 0; i < names.size(); ++i) {
+        formats[1].emplace_back();
+        encodeQoi(reference[i].data(), sizes[i], formats[1].back());
+        formats[2].emplace_back();
+        encodeRawImage(reference[i].data(), sizes[i], formats[2].back());
+    }
+
+    for (const auto& files : formats) {
+        const ImageDecoder* decoder = decoders.find(files[0].data(), files[0].size());
+        std::size_t fileBytes = 0;
+        double pixelCount = 0;
+        int maxDifference = 0;
+        std::vector<double> runs;
+        for (int run = 0; run < 3; ++run) {
+            Clock::time_point start = Clock::now();
+            for (std::size_t i = 0; i < files.size(); ++i) {
+                std::vector<sf::Uint8> pixels;
+                sf::Vector2u size;
+                decoder->decode(files[i].data(), files[i].size(), decoders.pool(), pixels, size);
+                if (run == 0) {
+                    fileBytes += files[i].size();
+                    pixelCount += static_cast<double>(size.x) * size.y;
+                    if (size != sizes[i] || pixels.size() != reference[i].size()) {
+                        maxDifference = 255;
+                    } else {
+                        for (std::size_t b = 0; b < pixels.size(); ++b) {
+                            maxDifference = std::max(maxDifference, std::abs(static_cast<int>(pixels[b]) - reference[i][b]));
+                        }
+                    }
+                }
+                decoders.pool().release(std::move(pixels));
+            }
+            runs.push_back(millisecondsSince(start));
+        }
+
+        double best = *std::min_element(runs.begin(), runs.end());
+        std::cout << "{\"bench\":\"image_decoder\",\"decoder\":\"" << decoder->name() << "\",\"images\":" << files.size()
+                  << ",\"bytes_per_image\":" << static_cast<double>(fileBytes) / files.size()
+                  << ",\"ms_per_image\":" << best / files.size() << ",\"mpixels_per_s\":" << pixelCount / best / 1e3
+                  << ",\"max_difference\":" << maxDifference << "}" << std::endl;
+    }
+}
+
+// Copies next to the images that decodeImage prefers over the PNGs
+void writeTranscodedImages(const std::vector<std::string>& names, const char* extension) {
+    DecoderRegistry& decoders = DecoderRegistry::instance();
+    for (const auto& name : names) {
+        std::vector<sf::Uint8> pixels;
+        sf::Vector2u size;
+        if (!decoders.decodeFile("images/" + name, pixels, size)) continue;
+
+        std::vector<unsigned char> bytes;
+        if (std::strcmp(extension, ".qoi") == 0) {
+            encodeQoi(pixels.data(), size, bytes);
+        } else {
+            encodeRawImage(pixels.data(), size, bytes);
+        }
+        std::ofstream out("images/" + name + extension, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    }
+}
+
+void removeTranscodedImages(const std::vector<std::string>& names, const char* extension) {
+    for (const auto& name : names) {
+        std::remove(("images/" + name + extension).c_str());
+    }
+}
+
+// The SIMD backends must match the scalar one to within rounding. Every
+// source width from 1 to 40 pixels covers each tail the 16-byte vertical
+// loops can leave, odd heights and target sizes the uneven spans.
+bool checkResample() {
+    const int Tolerance = 1;
+    ResampleBackend best = bestResampleBackend();
+    std::size_t cases = 0;
+    int maxDifference = 0;
+    bool ok = true;
+    for (unsigned width = 1; width <= 40; ++width) {
+        for (unsigned height : {1u, 3u, 7u, 16u, 33u}) {
+            for (unsigned divisor : {1u, 2u, 3u, 7u}) {
+                unsigned targetWidth = std::max(1u, width / divisor);
+                unsigned targetHeight = std::max(1u, height * 2 / (divisor + 1));
+                std::vector<sf::Uint8> source = syntheticPixels(width, height, width * 31 + height);
+                std::vector<sf::Uint8> reference(static_cast<std::size_t>(targetWidth) * targetHeight * 4);
+                resampleArea(source.data(), width, height, reference.data(), targetWidth, targetHeight, ResampleBackend::Scalar);
+
+                for (ResampleBackend backend : {ResampleBackend::Sse2, ResampleBackend::Avx2}) {
+                    if (static_cast<int>(backend) > static_cast<int>(best)) break;
+
+                    std::vector<sf::Uint8> output(reference.size());
+                    resampleArea(source.data(), width, height, output.data(), targetWidth, targetHeight, backend);
+                    ++cases;
+                    for (std::size_t i = 0; i < output.size(); ++i) {
+                        int difference = std::abs(static_cast<int>(output[i]) - reference[i]);
+                        maxDifference = std::max(maxDifference, difference);
+                        if (difference > Tolerance && ok) {
+                            std::cerr << "resample: " << resampleBackendName(backend) << " differs from scalar by " << difference << " at byte " << i
+                                      << " of " << width << "x" << height << " -> " << targetWidth << "x" << targetHeight << std::endl;
+                            ok = false;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    emit("resample_check", {{"cases", static_cast<double>(cases)}, {"max_difference", static_cast<double>(maxDifference)}, {"passed", ok ? 1.0 : 0.0}});
+    return ok;
+}
+
+void benchResample(unsigned width, unsigned height, const sf::Vector2u& area) {
+    std::vector<sf::Uint8> source = syntheticPixels(width, height, 7);
+    sf::Vector2u fitted = fitSize(sf::Vector2u(width, height), area);
+    std::vector<sf::Uint8> reference(static_cast<std::size_t>(fitted.x) * fitted.y * 4);
+    resampleArea(source.data(), width, height, reference.data(), fitted.x, fitted.y, ResampleBackend::Scalar);
+
+    ResampleBackend best = bestResampleBackend();
+    for (ResampleBackend backend : {ResampleBackend::Scalar, ResampleBackend::Sse2, ResampleBackend::Avx2}) {
+        if (static_cast<int>(backend) > static_cast<int>(best)) break;
+
+        std::vector<sf::Uint8> output(reference.size());
+        std::vector<double> runs;
+        for (int run = 0; run < 5; ++run) {
+            Clock::time_point start = Clock::now();
+            resampleArea(source.data(), width, height, output.data(), fitted.x, fitted.y, backend);
+            runs.push_back(millisecondsSince(start));
+        }
+
+        int maxDifference = 0;
+        for (std::size_t i = 0; i < output.size(); ++i) {
+            maxDifference = std::max(maxDifference, std::abs(static_cast<int>(output[i]) - reference[i]));
+        }
+
+        std::cout << "{\"bench\":\"resample\",\"backend\":\"" << resampleBackendName(backend) << "\",\"source_pixels\":"
+                 << static_cast<double>(width) * height << ",\"best_ms\":" << *std::min_element(runs.begin(), runs.end())
+                 << ",\"max_difference\":" << maxDifference << "}" << std::endl;
+    }
+}
+
+// Builds the type-ahead index over every slide name, then times the queries a
+// user types letter by letter and re-syncing one edited topic
+void benchSearch(const Scale& scale) {
+    const char* words[] = {"loop", "array", "string", "function", "class", "pointer", "variable", "print", "input", "recursion"};
+    std::vector<std::vector<std::string>> topicNames(scale.topics);
+    for (std::size_t i = 0; i < scale.images; ++i) {
+        topicNames[i % scale.topics].push_back(std::string(words[i % 10]) + "_" + words[(i / 10) % 10] + "_" + imageName(i));
+    }
+
+    SearchIndex search;
+    Clock::time_point start = Clock::now();
+    for (int topic = 0; topic < scale.topics; ++topic) {
+        search.syncTopic(topic, "Topic " + std::to_string(topic), topicNames[topic]);
+    }
+    double buildMs = millisecondsSince(start);
+
+    const char* typed[] = {"recursion_loop", "bench12345", "pointer_str", "topic 42", "ing_var", "zzz"};
+    std::vector<double> samples;
+    for (int round = 0; round < 20; ++round) {
+        for (const char* text : typed) {
+            std::string query(text);
+            for (std::size_t length = SearchIndex::MinQueryLength; length <= query.size(); ++length) {
+                start = Clock::now();
+                std::vector<SearchIndex::Result> results = search.query(query.substr(0, length));
+                samples.push_back(millisecondsSince(start) * 1e3);
+            }
+        }
+    }
+
+    std::vector<double> syncs;
+    for (int edit = 0; edit < 50; ++edit) {
+        std::vector<std::string>& names = topicNames[edit % scale.topics];
+        names.erase(names.begin());
+        names.push_back("edited_" + std::to_string(edit) + ".png");
+        start = Clock::now();
+        search.syncTopic(edit % scale.topics, "Topic " + std::to_string(edit % scale.topics), names);
+        syncs.push_back(millisecondsSince(start) * 1e3);
+    }
+
+    emit("search", {{"entries", static_cast<double>(search.size())}, {"build_ms", buildMs},
+                    {"query_p50_us", percentile(samples, 50)}, {"query_p99_us", percentile(samples, 99)},
+                    {"query_max_us", percentile(samples, 100)}, {"sync_topic_us", mean(syncs)}});
+}
+
+// Glyphs are rendered into the font's texture, so this one needs a GL context
+// like any other sf::Texture use
+void benchWrapText(const sf::Font& font) {
+    typedef TextWrapper<char, std::string> Wrapper;
+    const char* words[] = {"pointers", "and", "dynamic", "memory", "management", "lets", "a", "program", "allocate", "storage", "at", "runtime"};
+
+    std::vector<std::string> paragraphs;
+    for (int i = 0; i < 1000; ++i) {
+        std::string paragraph;
+        for (int word = 0; word < 60; ++word) {
+            paragraph += words[(i + word * 7) % 12];
+            paragraph += word % 11 == 10 ? ". " : " ";
+        }
+        paragraphs.push_back(paragraph + std::to_string(i));
+    }
+
+    Clock::time_point start = Clock::now();
+    Wrapper::wrapText(paragraphs[0], 400, font, 17);
+    double coldUs = millisecondsSince(start) * 1e3;
+
+    start = Clock::now();
+    for (const auto& paragraph : paragraphs) {
+        Wrapper::wrapText(paragraph, 400, font, 17);
+    }
+    double uniqueUs = millisecondsSince(start) * 1e3 / paragraphs.size();
+
+    start = Clock::now();
+    for (const auto& paragraph : paragraphs) {
+        Wrapper::wrapText(paragraph, 400, font, 17);
+    }
+    double memoizedUs = millisecondsSince(start) * 1e3 / paragraphs.size();
+
+    emit("wrap_text", {{"paragraphs", static_cast<double>(paragraphs.size())}, {"chars", static_cast<double>(paragraphs[0].size())},
+                       {"cold_us", coldUs}, {"us_per_paragraph", uniqueUs}, {"memoized_us", memoizedUs}});
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool quick = false;
+    std::string dataDirectory = "bench-data";
+    std::string fontPath = "fonts/Montserrat Light.otf";
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else if (std::strcmp(argv[i], "--data") == 0 && i + 1 < argc) {
+            dataDirectory = argv[++i];
+        } else if (std::strcmp(argv[i], "--font") == 0 && i + 1 < argc) {
+            fontPath = argv[++i];
+        }
+    }
+
+    // Loaded before moving into the scratch directory so the default path resolves
+    sf::Font font;
+    bool hasFont = font.loadFromFile(fontPath);
+
+    if (!makeDirectory(dataDirectory) || !changeDirectory(dataDirectory) || !makeDirectory("texts") || !makeDirectory("images")) {
+        std::cerr << "Could not prepare benchmark directory: " << dataDirectory << std::endl;
+        return 1;
+    }
+
+    std::vector<Scale> scales = {{1000, 10}, {10000, 100}, {100000, 1000}};
+    if (quick) scales.pop_back();
+
+    ThreadPool pool;
+    std::vector<std::string> decodeNames = writeDecodeImages(quick ? 8 : 32, 1920, 1080);
+
+    // Small enough that hashing it does not drown the catalog work in the edit timings
+    sf::Image probe;
+    probe.create(64, 64, syntheticPixels(64, 64, 1).data());
+    probe.saveToFile("images/probe.png");
+
+    for (const auto& scale : scales) {
+        benchTextLists(scale, pool);
+        benchCatalog(scale, "images/probe.png");
+        benchSearch(scale);
+    }
+
+    benchDecode(decodeNames, sf::Vector2u(0, 0), "decode", pool);
+    benchDecode(decodeNames, sf::Vector2u(1080, 720), "decode_fit", pool);
+    benchDecoders(std::vector<std::string>(decodeNames.begin(), decodeNames.begin() + std::min<std::size_t>(decodeNames.size(), 4)));
+    for (const char* extension : TranscodedExtensions) {
+        writeTranscodedImages(decodeNames, extension);
+        benchDecode(decodeNames, sf::Vector2u(0, 0), (std::string("decode_") + (extension + 1)).c_str(), pool);
+        removeTranscodedImages(decodeNames, extension);
+    }
+    if (!checkResample()) return 1;
+    benchResample(1920, 1080, sf::Vector2u(1080, 720));
+
+    if (hasFont) {
+        benchWrapText(font);
+    } else {
+        std::cerr << "Could not load font, skipping wrap_text: " << fontPath << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,649 @@
+#include "catalog.hpp"
+#include "imageDecoder.hpp"
+#include "logger.hpp"
+#include "mappedFile.hpp"
+#include "profiler.hpp"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+namespace {
+
+const char CatalogMagic[8] = {'C', 'Q', 'C', 'A', 'T', 'L', 'G', '1'};
+const std::uint32_t CatalogVersion = 1;
+const std::size_t HeaderSize = 64;
+
+// A journal holds one batch: magic, record count, 4 reserved bytes, then the records.
+// Records carry their own checksums, so a torn journal shows up as a bad or missing record.
+const char JournalMagic[8] = {'C', 'Q', 'J', 'R', 'N', 'L', '0', '1'};
+const std::size_t JournalHeaderSize = 16;
+
+// Compact once removes have left this many records, and more dead than live ones
+const std::size_t CompactionThreshold = 1024;
+
+enum RecordFlags : std::uint8_t {
+    RecordLive = 1,
+    RecordDeleted = 2
+};
+
+struct Record {
+    std::uint32_t checksum;
+    std::uint16_t topic;
+    std::uint8_t flags;
+    std::uint8_t nameLength;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint64_t fileSize;
+    std::int64_t mtime;
+    std::uint64_t contentHash;
+    char name[Catalog::MaxNameLength + 1];
+};
+
+static_assert(sizeof(Record) == 256, "catalog records must stay 256 bytes");
+
+std::uint32_t fnv1a32(const unsigned char* data, std::size_t size) {
+    std::uint32_t hash = 2166136261u;
+    for (std::size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+std::uint32_t recordChecksum(const Record& record) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&record);
+    return fnv1a32(bytes + sizeof(record.checksum), sizeof(Record) - sizeof(record.checksum));
+}
+
+// The entry's name must already be checked against MaxNameLength
+Record makeRecord(const CatalogEntry& entry, bool live) {
+    Record record;
+    std::memset(&record, 0, sizeof(record));
+    record.topic = static_cast<std::uint16_t>(entry.topic);
+    record.flags = live ? RecordLive : RecordDeleted;
+    record.nameLength = static_cast<std::uint8_t>(entry.name.size());
+    record.width = entry.width;
+    record.height = entry.height;
+    record.fileSize = entry.fileSize;
+    record.mtime = entry.mtime;
+    record.contentHash = entry.contentHash;
+    std::memcpy(record.name, entry.name.data(), entry.name.size());
+    record.checksum = recordChecksum(record);
+    return record;
+}
+
+// False for a torn or unknown record
+bool readRecord(const unsigned char* data, CatalogEntry& entry, bool& live) {
+    Record record;
+    std::memcpy(&record, data, sizeof(Record));
+    if (record.checksum != recordChecksum(record) || record.nameLength > Catalog::MaxNameLength) return false;
+    if (record.flags != RecordLive && record.flags != RecordDeleted) return false;
+
+    entry.name.assign(record.name, record.nameLength);
+    entry.topic = record.topic;
+    entry.width = record.width;
+    entry.height = record.height;
+    entry.fileSize = record.fileSize;
+    entry.mtime = record.mtime;
+    entry.contentHash = record.contentHash;
+    live = record.flags == RecordLive;
+    return true;
+}
+
+bool writeHeader(std::FILE* out) {
+    unsigned char header[HeaderSize] = {};
+    std::memcpy(header, CatalogMagic, sizeof(CatalogMagic));
+    std::memcpy(header + sizeof(CatalogMagic), &CatalogVersion, sizeof(CatalogVersion));
+    std::uint32_t recordSize = sizeof(Record);
+    std::memcpy(header + sizeof(CatalogMagic) + sizeof(CatalogVersion), &recordSize, sizeof(recordSize));
+    return std::fwrite(header, 1, sizeof(header), out) == sizeof(header);
+}
+
+bool isValidEntry(const CatalogEntry& entry) {
+    return entry.topic >= 0 && entry.topic <= 0xFFFF && !entry.name.empty() && entry.name.size() <= Catalog::MaxNameLength;
+}
+
+// Atomically where the platform allows it: rename replaces the target in one
+// step on POSIX, on Windows only MoveFileEx does
+bool replaceFile(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+// A compaction is only written out whole, so one with a catalog header and
+// whole records was finished before a crash kept it from being renamed
+bool isCompleteCatalog(const std::string& path) {
+    MappedFile mapped;
+    return mapped.open(path) && mapped.size() >= HeaderSize && (mapped.size() - HeaderSize) % sizeof(Record) == 0 &&
+           std::memcmp(mapped.data(), CatalogMagic, sizeof(CatalogMagic)) == 0;
+}
+
+} // namespace
+
+const std::size_t Catalog::MaxNameLength;
+
+void CatalogBatch::add(const CatalogEntry& entry) {
+    operations.push_back(Operation{Kind::Add, entry});
+}
+
+void CatalogBatch::remove(int topic, const std::string& name) {
+    CatalogEntry entry;
+    entry.topic = topic;
+    entry.name = name;
+    operations.push_back(Operation{Kind::Remove, entry});
+}
+
+void CatalogBatch::update(const CatalogEntry& entry) {
+    operations.push_back(Operation{Kind::Update, entry});
+}
+
+Catalog::Catalog() : file(nullptr), liveCount(0), edits(0) {}
+
+Catalog::~Catalog() {
+    close();
+}
+
+bool Catalog::open(const std::string& path) {
+    PROFILE_ZONE("catalog open");
+    close();
+    filePath = path;
+
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0 && isCompleteCatalog(compactedPath())) {
+        LOG_WARNING("Catalog missing, adopting its finished compaction: " << compactedPath());
+        if (!replaceFile(compactedPath(), path)) LOG_ERROR("Failed to replace file: " << path);
+    }
+
+    std::size_t recordCount = 0;
+    {
+        MappedFile mapped;
+        if (mapped.open(path)) {
+            if (mapped.size() < HeaderSize || std::memcmp(mapped.data(), CatalogMagic, sizeof(CatalogMagic)) != 0) {
+                LOG_ERROR("Not a catalog file: " << path);
+                return false;
+            }
+
+            // A partial record at the end is a crashed append and gets overwritten by the next one
+            recordCount = (mapped.size() - HeaderSize) / sizeof(Record);
+            slots.resize(recordCount);
+
+            for (std::size_t i = 0; i < recordCount; ++i) {
+                Slot& slot = slots[i];
+                bool live = false;
+                slot.live = false;
+                if (!readRecord(mapped.data() + HeaderSize + i * sizeof(Record), slot.entry, live) || !live) continue;
+
+                if (contains(slot.entry.topic, slot.entry.name)) continue;
+                slot.live = true;
+                indexSlot(i);
+            }
+        }
+    }
+
+    file = std::fopen(path.c_str(), "r+b");
+    if (!file) {
+        file = std::fopen(path.c_str(), "w+b");
+        if (!file) {
+            LOG_ERROR("Failed to create catalog: " << path);
+            return false;
+        }
+
+        if (!writeHeader(file) || std::fflush(file) != 0) {
+            LOG_ERROR("Failed to write catalog header: " << path);
+            close();
+            return false;
+        }
+    }
+
+    replayJournal();
+    return true;
+}
+
+void Catalog::close() {
+    if (file) std::fclose(file);
+    file = nullptr;
+    slots.clear();
+    topics.clear();
+    liveCount = 0;
+}
+
+bool Catalog::contains(int topic, const std::string& name) const {
+    return find(topic, name) != nullptr;
+}
+
+const CatalogEntry* Catalog::find(int topic, const std::string& name) const {
+    const Topic* t = topicFor(topic);
+    if (!t) return nullptr;
+
+    auto found = t->index.find(name);
+    if (found == t->index.end()) return nullptr;
+    return &slots[*found->second].entry;
+}
+
+bool Catalog::add(const CatalogEntry& entry) {
+    if (!file || entry.topic < 0 || entry.topic > 0xFFFF) return false;
+    if (!isValidEntry(entry)) {
+        LOG_WARNING("Invalid image name for catalog: " << entry.name);
+        return false;
+    }
+    if (contains(entry.topic, entry.name)) return false;
+
+    slots.push_back(Slot{entry, true});
+    std::size_t slot = slots.size() - 1;
+    if (!writeRecord(slot)) {
+        slots.pop_back();
+        return false;
+    }
+
+    indexSlot(slot);
+    edits++;
+    return true;
+}
+
+bool Catalog::remove(int topic, const std::string& name) {
+    if (!file || topic < 0 || topic >= static_cast<int>(topics.size())) return false;
+
+    Topic& t = topics[topic];
+    auto found = t.index.find(name);
+    if (found == t.index.end()) return false;
+
+    std::size_t slot = *found->second;
+    slots[slot].live = false;
+    if (!writeRecord(slot)) {
+        slots[slot].live = true;
+        return false;
+    }
+
+    t.order.erase(found->second);
+    t.index.erase(found);
+    liveCount--;
+    edits++;
+    return true;
+}
+
+std::size_t Catalog::commit(const CatalogBatch& batch) {
+    PROFILE_ZONE("catalog commit");
+    if (!file || batch.isEmpty()) return 0;
+
+    CatalogWrite pending = prepare(batch);
+    write(pending);
+    return apply(pending);
+}
+
+CatalogWrite Catalog::prepare(const CatalogBatch& batch) const {
+    PROFILE_ZONE("catalog prepare");
+    CatalogWrite result;
+    result.changes.reserve(batch.size());
+
+    // Where each name touched by this batch lives once the earlier operations are applied
+    const std::size_t none = static_cast<std::size_t>(-1);
+    std::map<std::pair<int, std::string>, std::size_t> touched;
+    std::size_t nextSlot = slots.size();
+
+    for (const auto& operation : batch.operations) {
+        const CatalogEntry& entry = operation.entry;
+        if (!isValidEntry(entry)) {
+            LOG_WARNING("Invalid image name for catalog: " << entry.name);
+            continue;
+        }
+
+        auto key = std::make_pair(entry.topic, entry.name);
+        auto known = touched.find(key);
+        std::size_t slot = none;
+        if (known != touched.end()) {
+            slot = known->second;
+        } else if (const Topic* t = topicFor(entry.topic)) {
+            auto found = t->index.find(entry.name);
+            if (found != t->index.end()) slot = *found->second;
+        }
+
+        switch (operation.kind) {
+        case CatalogBatch::Kind::Remove:
+            if (slot == none) continue;
+            result.changes.push_back(CatalogWrite::Change{false, false, slot, entry});
+            touched[key] = none;
+            break;
+        case CatalogBatch::Kind::Update:
+            if (slot == none) continue;
+            result.changes.push_back(CatalogWrite::Change{true, false, slot, entry});
+            break;
+        case CatalogBatch::Kind::Add:
+            if (slot != none) continue;
+            result.changes.push_back(CatalogWrite::Change{true, true, nextSlot, entry});
+            touched[key] = nextSlot++;
+            break;
+        }
+    }
+    return result;
+}
+
+// The journal is complete before the catalog is touched, so a crash part way is finished on the next open
+void Catalog::write(CatalogWrite& pending) {
+    PROFILE_ZONE("catalog write");
+    if (!file) return;
+    if (pending.changes.empty()) {
+        pending.journaled = pending.written = true;
+        return;
+    }
+
+    std::vector<Record> records;
+    records.reserve(pending.changes.size());
+    for (const auto& change : pending.changes) {
+        records.push_back(makeRecord(change.entry, change.live));
+    }
+
+    std::uint32_t count = static_cast<std::uint32_t>(records.size());
+    std::uint32_t reserved = 0;
+    std::FILE* journal = std::fopen(journalPath().c_str(), "wb");
+    bool journaled = journal &&
+                     std::fwrite(JournalMagic, 1, sizeof(JournalMagic), journal) == sizeof(JournalMagic) &&
+                     std::fwrite(&count, sizeof(count), 1, journal) == 1 &&
+                     std::fwrite(&reserved, sizeof(reserved), 1, journal) == 1 &&
+                     std::fwrite(records.data(), sizeof(Record), records.size(), journal) == records.size();
+    journaled = journal && (std::fclose(journal) == 0) && journaled;
+    if (!journaled) {
+        LOG_ERROR("Failed to write catalog journal: " << journalPath());
+        std::remove(journalPath().c_str());
+        return;
+    }
+
+    pending.journaled = true;
+    pending.written = writeRecords(pending);
+    if (pending.written) {
+        std::remove(journalPath().c_str());
+    } else {
+        LOG_WARNING("Catalog edits will be completed from the journal on the next start: " << journalPath());
+    }
+}
+
+// Updates the index to match what write put on disk
+std::size_t Catalog::apply(const CatalogWrite& pending) {
+    if (!pending.journaled || pending.changes.empty()) return 0;
+
+    for (const auto& change : pending.changes) {
+        if (change.append) {
+            slots.push_back(Slot{change.entry, true});
+            indexSlot(slots.size() - 1);
+        } else if (!change.live) {
+            Topic& t = topics[change.entry.topic];
+            auto found = t.index.find(change.entry.name);
+            slots[change.slot].live = false;
+            t.order.erase(found->second);
+            t.index.erase(found);
+            liveCount--;
+        } else {
+            slots[change.slot].entry = change.entry;
+        }
+    }
+    edits++;
+    return pending.changes.size();
+}
+
+// Runs of neighbouring records go out as one write, then everything is flushed once
+bool Catalog::writeRecords(const CatalogWrite& pending) {
+    bool ok = true;
+    std::vector<Record> run;
+    std::size_t runStart = 0;
+    for (std::size_t i = 0; i <= pending.changes.size() && ok; ++i) {
+        bool extends = i < pending.changes.size() && !run.empty() && pending.changes[i].slot == runStart + run.size();
+        if (!run.empty() && !extends) {
+            long offset = static_cast<long>(HeaderSize + runStart * sizeof(Record));
+            ok = std::fseek(file, offset, SEEK_SET) == 0 && std::fwrite(run.data(), sizeof(Record), run.size(), file) == run.size();
+            run.clear();
+        }
+        if (i == pending.changes.size()) break;
+        if (run.empty()) runStart = pending.changes[i].slot;
+        run.push_back(makeRecord(pending.changes[i].entry, pending.changes[i].live));
+    }
+
+    ok = (std::fflush(file) == 0) && ok;
+    if (!ok) LOG_ERROR("Failed to write catalog records: " << filePath);
+    return ok;
+}
+
+void Catalog::replayJournal() {
+    CatalogBatch batch;
+    {
+        MappedFile mapped;
+        if (!mapped.open(journalPath())) return;
+
+        std::uint32_t count = 0;
+        bool complete = mapped.size() >= JournalHeaderSize && std::memcmp(mapped.data(), JournalMagic, sizeof(JournalMagic)) == 0;
+        if (complete) {
+            std::memcpy(&count, mapped.data() + sizeof(JournalMagic), sizeof(count));
+            complete = mapped.size() >= JournalHeaderSize + static_cast<std::size_t>(count) * sizeof(Record);
+        }
+
+        for (std::uint32_t i = 0; i < count && complete; ++i) {
+            CatalogEntry entry;
+            bool live = false;
+            complete = readRecord(mapped.data() + JournalHeaderSize + i * sizeof(Record), entry, live);
+            if (live) {
+                // An add or an update, both make the name listed with this metadata
+                batch.add(entry);
+                batch.update(entry);
+            } else {
+                batch.remove(entry.topic, entry.name);
+            }
+        }
+
+        // A torn journal means the crash came before the catalog was touched
+        if (!complete) {
+            LOG_WARNING("Discarding incomplete catalog journal: " << journalPath());
+            batch = CatalogBatch();
+        }
+    }
+
+    // Operations that already reached the catalog are skipped as duplicates
+    CatalogWrite pending = prepare(batch);
+    pending.journaled = true;
+    pending.written = writeRecords(pending);
+    std::size_t applied = apply(pending);
+    if (pending.written) {
+        std::remove(journalPath().c_str());
+        if (applied > 0) LOG_INFO("Replayed " << applied << " catalog edits from " << journalPath());
+    }
+}
+
+bool Catalog::needsCompaction() const {
+    return deadCount() >= CompactionThreshold && deadCount() > liveCount;
+}
+
+std::vector<CatalogEntry> Catalog::liveEntries() const {
+    std::vector<CatalogEntry> entries;
+    entries.reserve(liveCount);
+    for (const auto& t : topics) {
+        for (std::size_t slot : t.order) {
+            entries.push_back(slots[slot].entry);
+        }
+    }
+    return entries;
+}
+
+bool Catalog::writeCompacted(const std::string& path, const std::vector<CatalogEntry>& entries) {
+    PROFILE_ZONE("catalog compact");
+    std::FILE* out = std::fopen(path.c_str(), "wb");
+    if (!out) {
+        LOG_ERROR("Failed to open file for writing: " << path);
+        return false;
+    }
+
+    bool ok = writeHeader(out);
+    std::vector<Record> records;
+    records.reserve(entries.size());
+    for (const auto& entry : entries) {
+        records.push_back(makeRecord(entry, true));
+    }
+    ok = ok && std::fwrite(records.data(), sizeof(Record), records.size(), out) == records.size();
+    ok = (std::fclose(out) == 0) && ok;
+    if (!ok) {
+        LOG_ERROR("Failed to write catalog: " << path);
+        std::remove(path.c_str());
+    }
+    return ok;
+}
+
+bool Catalog::adoptCompacted(const std::string& compactedPath) {
+    std::string path = filePath;
+    std::size_t editsSoFar = edits;
+    close();
+
+    // Never removed first, a crash then leaves either the old catalog or the new one
+    if (!replaceFile(compactedPath, path)) {
+        LOG_ERROR("Failed to replace file: " << path);
+    }
+
+    bool opened = open(path);
+    edits = editsSoFar + 1;
+    return opened;
+}
+
+std::vector<std::string> Catalog::names(int topic) const {
+    std::vector<std::string> result;
+    const Topic* t = topicFor(topic);
+    if (!t) return result;
+
+    result.reserve(t->order.size());
+    for (std::size_t slot : t->order) {
+        result.push_back(slots[slot].entry.name);
+    }
+    return result;
+}
+
+bool Catalog::importTextList(int topic, const std::string& path) {
+    PROFILE_ZONE("catalog import");
+    std::ifstream list(path);
+    if (!list) {
+        LOG_ERROR("Failed to open file: " << path);
+        return false;
+    }
+
+    std::vector<std::string> listed;
+    std::unordered_map<std::string, bool> wanted;
+    std::string line;
+    while (std::getline(list, line)) {
+        if (line.empty() || wanted.count(line)) continue;
+        listed.push_back(line);
+        wanted[line] = true;
+    }
+
+    // One transaction and one flush however long the list is
+    CatalogBatch batch;
+    for (const auto& name : names(topic)) {
+        if (!wanted.count(name)) batch.remove(topic, name);
+    }
+
+    for (const auto& name : listed) {
+        if (contains(topic, name)) continue;
+
+        CatalogEntry entry;
+        entry.name = name;
+        entry.topic = topic;
+        readImageMetadata(name, entry);
+        batch.add(entry);
+    }
+    commit(batch);
+    return true;
+}
+
+bool Catalog::exportTextList(int topic, const std::string& path) const {
+    PROFILE_ZONE("catalog export");
+    // Written next to the target and renamed over it so a crash never leaves a half-written list
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::trunc);
+        if (!out) {
+            LOG_ERROR("Failed to open file for writing: " << tempPath);
+            return false;
+        }
+        for (const auto& name : names(topic)) {
+            out << name << '\n';
+        }
+        if (!out.flush()) {
+            LOG_ERROR("Failed to write file: " << tempPath);
+            return false;
+        }
+    }
+
+    if (!replaceFile(tempPath, path)) {
+        LOG_ERROR("Failed to replace file: " << path);
+        return false;
+    }
+    return true;
+}
+
+bool Catalog::writeRecord(std::size_t slot) {
+    Record record = makeRecord(slots[slot].entry, slots[slot].live);
+
+    long offset = static_cast<long>(HeaderSize + slot * sizeof(Record));
+    if (std::fseek(file, offset, SEEK_SET) != 0 ||
+        std::fwrite(&record, sizeof(record), 1, file) != 1 ||
+        std::fflush(file) != 0) {
+        LOG_ERROR("Failed to write catalog record: " << filePath);
+        return false;
+    }
+    return true;
+}
+
+void Catalog::indexSlot(std::size_t slot) {
+    const CatalogEntry& entry = slots[slot].entry;
+    Topic& t = topicFor(entry.topic);
+    t.order.push_back(slot);
+    t.index.emplace(entry.name, std::prev(t.order.end()));
+    liveCount++;
+}
+
+Catalog::Topic& Catalog::topicFor(int topic) {
+    if (topic >= static_cast<int>(topics.size())) topics.resize(topic + 1);
+    return topics[topic];
+}
+
+const Catalog::Topic* Catalog::topicFor(int topic) const {
+    if (topic < 0 || topic >= static_cast<int>(topics.size())) return nullptr;
+    return &topics[topic];
+}
+
+std::uint64_t currentContentHash(const CatalogEntry& entry) {
+    if (entry.contentHash == 0) return 0;
+    struct stat info;
+    if (stat(("images/" + entry.name).c_str(), &info) != 0) return 0;
+    bool current = static_cast<std::uint64_t>(info.st_size) == entry.fileSize && static_cast<std::int64_t>(info.st_mtime) == entry.mtime;
+    return current ? entry.contentHash : 0;
+}
+
+bool readImageMetadata(const std::string& imageName, CatalogEntry& entry) {
+    PROFILE_ZONE("read metadata");
+    std::string path = "images/" + imageName;
+
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) return false;
+    entry.fileSize = static_cast<std::uint64_t>(info.st_size);
+    entry.mtime = static_cast<std::int64_t>(info.st_mtime);
+
+    MappedFile mapped;
+    if (mapped.open(path)) {
+        std::uint64_t hash = 14695981039346656037ull;
+        for (std::size_t i = 0; i < mapped.size(); ++i) {
+            hash ^= mapped.data()[i];
+            hash *= 1099511628211ull;
+        }
+        entry.contentHash = hash;
+
+        sf::Vector2u size;
+        if (DecoderRegistry::instance().readSize(mapped.data(), mapped.size(), size)) {
+            entry.width = size.x;
+            entry.height = size.y;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,169 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Cached metadata of one image listed under a topic
+struct CatalogEntry {
+    std::string name;
+    int topic;
+    unsigned width;
+    unsigned height;
+    std::uint64_t fileSize;
+    std::int64_t mtime;
+    std::uint64_t contentHash;
+
+    CatalogEntry() : topic(0), width(0), height(0), fileSize(0), mtime(0), contentHash(0) {}
+};
+
+// Adds and removes applied to a catalog as one transaction, see Catalog::commit
+class CatalogBatch {
+public:
+    void add(const CatalogEntry& entry);
+    void remove(int topic, const std::string& name);
+    // New metadata for a listed name, rewritten in place so it keeps its position
+    void update(const CatalogEntry& entry);
+
+    std::size_t size() const { return operations.size(); }
+    bool isEmpty() const { return operations.empty(); }
+
+private:
+    friend class Catalog;
+
+    enum class Kind { Add, Remove, Update };
+
+    struct Operation {
+        Kind kind;
+        CatalogEntry entry; // only topic and name for removes
+    };
+
+    std::vector<Operation> operations;
+};
+
+// A batch resolved against the catalog: every record it writes and where.
+// See Catalog::prepare.
+struct CatalogWrite {
+    struct Change {
+        bool live;         // false for a remove
+        bool append;       // a new record, otherwise the one at slot is rewritten
+        std::size_t slot;
+        CatalogEntry entry;
+    };
+
+    std::vector<Change> changes;
+    bool journaled; // the batch survives a crash from here on, so it may be applied
+    bool written;
+
+    CatalogWrite() : journaled(false), written(false) {}
+};
+
+// Binary catalog of every topic's image list, replacing the texts/textN.txt scans.
+//
+// The file is a header followed by fixed-size records. Adding appends one
+// record and deleting flips the flag of one record in place, so both are O(1).
+// Every record carries a checksum; a record torn by a crash fails it and is
+// ignored when the catalog is opened (memory mapped) again. Lookups go through
+// a hashed name index per topic that is rebuilt on open.
+//
+// Batches are written to <path>.journal before they touch the catalog, and a
+// journal left behind by a crash is replayed on open. Removed records stay in
+// the file until it is compacted into a new file that is renamed over it.
+class Catalog {
+public:
+    static const std::size_t MaxNameLength = 215;
+
+    Catalog();
+    ~Catalog();
+
+    Catalog(const Catalog&) = delete;
+    Catalog& operator=(const Catalog&) = delete;
+
+    // Opens the catalog file, creating an empty one if it does not exist
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return file != nullptr; }
+    bool isEmpty() const { return liveCount == 0; }
+
+    bool contains(int topic, const std::string& name) const;
+    const CatalogEntry* find(int topic, const std::string& name) const;
+
+    // Both return false if nothing changed (duplicate or unknown name, I/O error)
+    bool add(const CatalogEntry& entry);
+    bool remove(int topic, const std::string& name);
+
+    // Applies the whole batch with a single flush, or none of it if the journal
+    // cannot be written. Adds of listed names and removes and updates of unknown
+    // names are skipped. Returns the number of operations applied.
+    std::size_t commit(const CatalogBatch& batch);
+
+    // commit in three steps, so the disk work can leave the thread that owns
+    // the catalog. prepare only reads the index and apply updates it, both on
+    // the owning thread. write only touches the files and may run on any
+    // thread, provided no other write, adoptCompacted or close overlaps it and
+    // the catalog does not change between prepare and apply.
+    CatalogWrite prepare(const CatalogBatch& batch) const;
+    void write(CatalogWrite& write);
+    std::size_t apply(const CatalogWrite& write);
+
+    // Records left behind by removes, reclaimed by compaction
+    std::size_t deadCount() const { return slots.size() - liveCount; }
+    bool needsCompaction() const;
+    // Bumped by every change, a compaction is only adopted if it did not move
+    std::size_t editCount() const { return edits; }
+    // Live entries topic by topic, in list order
+    std::vector<CatalogEntry> liveEntries() const;
+    // Writes a catalog holding just these entries; touches no catalog state, so
+    // it can run on a worker while the catalog stays in use
+    static bool writeCompacted(const std::string& path, const std::vector<CatalogEntry>& entries);
+    // Renames a file written by writeCompacted over this catalog and reopens it
+    bool adoptCompacted(const std::string& compactedPath);
+    // Where compactions are written; open() adopts one left complete by a crash
+    std::string compactedPath() const { return filePath + ".compact"; }
+
+    // Image names of a topic in the order they were added
+    std::vector<std::string> names(int topic) const;
+    std::size_t size() const { return liveCount; }
+    int topicCount() const { return static_cast<int>(topics.size()); }
+
+    // Makes a topic match a texts/textN.txt style list (one name per line)
+    bool importTextList(int topic, const std::string& path);
+    bool exportTextList(int topic, const std::string& path) const;
+
+    const std::string& path() const { return filePath; }
+
+private:
+    struct Slot {
+        CatalogEntry entry;
+        bool live;
+    };
+
+    struct Topic {
+        std::list<std::size_t> order; // slots in insertion order
+        std::unordered_map<std::string, std::list<std::size_t>::iterator> index;
+    };
+
+    bool writeRecord(std::size_t slot);
+    bool writeRecords(const CatalogWrite& write);
+    void replayJournal();
+    std::string journalPath() const { return filePath + ".journal"; }
+    void indexSlot(std::size_t slot);
+    Topic& topicFor(int topic);
+    const Topic* topicFor(int topic) const;
+
+    std::FILE* file;
+    std::string filePath;
+    std::vector<Slot> slots;
+    std::vector<Topic> topics;
+    std::size_t liveCount;
+    std::size_t edits;
+};
+
+// Fills size, mtime, content hash and (for PNGs) dimensions of images/<name>
+bool readImageMetadata(const std::string& imageName, CatalogEntry& entry);
+
+// The entry's content hash while images/<name> keeps the size and mtime it
+// was hashed at, 0 once the file was edited since; only then may it be shared
+std::uint64_t currentContentHash(const CatalogEntry& entry);
@@ -0,0 +1,220 @@
+#include "catalogWriter.hpp"
+#include "logger.hpp"
+#include "threadPool.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <unordered_set>
+
+namespace {
+
+// Images hashed per pool task; small enough to spread a big import over every worker
+const std::size_t MetadataChunk = 64;
+
+} // namespace
+
+CatalogWriter::CatalogWriter(Catalog& catalog, ThreadPool& pool)
+    : catalog(catalog), pool(pool), results(std::make_shared<ResultQueue>()), inFlight(0), compacting(false), compactionEdits(0) {}
+
+void CatalogWriter::add(int topic, const std::string& imageName) {
+    if (catalog.contains(topic, imageName)) {
+        LOG_INFO("Image name '" << imageName << "' already exists in topic " << topic);
+        return;
+    }
+
+    Edit edit;
+    edit.mustExist = true;
+    edit.entry.topic = topic;
+    edit.entry.name = imageName;
+    queued.push_back(edit);
+}
+
+void CatalogWriter::remove(int topic, const std::string& imageName) {
+    if (!catalog.contains(topic, imageName)) {
+        LOG_INFO("Image name '" << imageName << "' not found in topic " << topic);
+        return;
+    }
+
+    Edit edit;
+    edit.remove = true;
+    edit.entry.topic = topic;
+    edit.entry.name = imageName;
+    queued.push_back(edit);
+}
+
+void CatalogWriter::replace(int topic, const std::vector<std::string>& names) {
+    std::unordered_set<std::string> wanted(names.begin(), names.end());
+    for (const auto& name : catalog.names(topic)) {
+        if (wanted.count(name)) continue;
+        Edit edit;
+        edit.remove = true;
+        edit.entry.topic = topic;
+        edit.entry.name = name;
+        queued.push_back(edit);
+    }
+
+    std::unordered_set<std::string> listed;
+    for (const auto& name : names) {
+        if (name.empty() || catalog.contains(topic, name) || !listed.insert(name).second) continue;
+        Edit edit;
+        edit.entry.topic = topic;
+        edit.entry.name = name;
+        queued.push_back(edit);
+    }
+}
+
+void CatalogWriter::refresh(const std::string& imageName) {
+    for (int topic = 0; topic < catalog.topicCount(); ++topic) {
+        if (!catalog.contains(topic, imageName)) continue;
+        Edit edit;
+        edit.update = true;
+        edit.mustExist = true;
+        edit.entry.topic = topic;
+        edit.entry.name = imageName;
+        queued.push_back(edit);
+    }
+}
+
+void CatalogWriter::submit() {
+    if (queued.empty()) return;
+
+    auto job = std::make_shared<Job>();
+    job->edits.swap(queued);
+    std::size_t chunks = (job->edits.size() + MetadataChunk - 1) / MetadataChunk;
+    job->remaining = chunks;
+    inFlight++;
+
+    std::shared_ptr<ResultQueue> queue = results;
+    for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+        std::size_t begin = chunk * MetadataChunk;
+        std::size_t end = std::min(begin + MetadataChunk, job->edits.size());
+        pool.submit([queue, job, begin, end] {
+            for (std::size_t i = begin; i < end; ++i) {
+                Edit& edit = job->edits[i];
+                if (!edit.remove) edit.missing = !readImageMetadata(edit.entry.name, edit.entry);
+            }
+            if (--job->remaining > 0) return;
+
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            queue->items.push_back(Finished{job, nullptr, true});
+            queue->ready.notify_all();
+        });
+    }
+}
+
+std::vector<int> CatalogWriter::update() {
+    std::vector<int> changed;
+
+    std::deque<Finished> finished;
+    {
+        std::lock_guard<std::mutex> lock(results->mutex);
+        finished.swap(results->items);
+    }
+
+    for (const Finished& result : finished) {
+        if (result.job) {
+            inFlight--;
+            CatalogBatch batch = makeBatch(*result.job);
+            if (!batch.isEmpty()) batches.push_back(std::move(batch));
+            continue;
+        }
+        if (result.write) {
+            writing.reset();
+            std::size_t applied = catalog.apply(*result.write);
+            for (const auto& change : result.write->changes) {
+                if (change.append || !change.live) changed.push_back(change.entry.topic);
+            }
+            if (applied > 0) {
+                LOG_INFO("Committed " << applied << " catalog edits to " << catalog.path());
+            }
+            continue;
+        }
+
+        compacting = false;
+        if (!result.written) continue;
+        if (catalog.editCount() != compactionEdits) {
+            std::remove(compactedPath().c_str()); // stale copy, retried on a later frame
+            continue;
+        }
+        std::size_t dead = catalog.deadCount();
+        if (catalog.adoptCompacted(compactedPath())) {
+            LOG_INFO("Compacted " << catalog.path() << ", dropped " << dead << " removed records");
+        }
+    }
+
+    if (!writing && !compacting && !batches.empty()) startWrite();
+    if (!writing && !compacting && batches.empty() && inFlight == 0 && catalog.needsCompaction()) startCompaction();
+
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+    return changed;
+}
+
+std::vector<int> CatalogWriter::finish() {
+    submit();
+
+    std::vector<int> changed = update();
+    while (isBusy()) {
+        {
+            std::unique_lock<std::mutex> lock(results->mutex);
+            results->ready.wait(lock, [this] { return !results->items.empty(); });
+        }
+        std::vector<int> more = update();
+        changed.insert(changed.end(), more.begin(), more.end());
+    }
+
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+    return changed;
+}
+
+CatalogBatch CatalogWriter::makeBatch(const Job& job) const {
+    CatalogBatch batch;
+    for (const Edit& edit : job.edits) {
+        if (edit.remove) {
+            batch.remove(edit.entry.topic, edit.entry.name);
+        } else if (edit.update) {
+            // Deleted or mid-write, the next change event refreshes it again
+            if (!edit.missing) batch.update(edit.entry);
+        } else if (edit.missing && edit.mustExist) {
+            LOG_WARNING("Image does not exist, not adding to catalog: " << edit.entry.name);
+        } else {
+            batch.add(edit.entry);
+        }
+    }
+    return batch;
+}
+
+// One batch at a time, resolved against the index as it is now; the index
+// only changes when the write comes back, so the slots it picked stay free
+void CatalogWriter::startWrite() {
+    auto write = std::make_shared<CatalogWrite>(catalog.prepare(batches.front()));
+    batches.pop_front();
+    writing = write;
+
+    std::shared_ptr<ResultQueue> queue = results;
+    Catalog* target = &catalog;
+    pool.submit([queue, write, target] {
+        target->write(*write);
+
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->items.push_back(Finished{nullptr, write, false});
+        queue->ready.notify_all();
+    });
+}
+
+// Nothing changes the index while a compaction runs, so the copy is taken on the pool too
+void CatalogWriter::startCompaction() {
+    compacting = true;
+    compactionEdits = catalog.editCount();
+
+    std::shared_ptr<ResultQueue> queue = results;
+    std::string path = compactedPath();
+    const Catalog* source = &catalog;
+    pool.submit([queue, path, source] {
+        bool written = Catalog::writeCompacted(path, source->liveEntries());
+
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->items.push_back(Finished{nullptr, nullptr, written});
+        queue->ready.notify_all();
+    });
+}
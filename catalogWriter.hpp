@@ -0,0 +1,95 @@
+#pragma once
+#include "catalog.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// Write-behind front end for catalog edits made while the app runs. Queued
+// edits go out together: image metadata is read on the pool, update resolves
+// them against the index, the journal and records are written and flushed on
+// the pool one batch at a time, and the index is updated once a batch is on
+// disk. No frame waits on hashing images or on the disk. A catalog left
+// mostly dead by removes is copied and compacted on the pool and swapped in
+// if no edit raced the copy; batches wait while it runs.
+class CatalogWriter {
+public:
+    CatalogWriter(Catalog& catalog, ThreadPool& pool);
+
+    // Queue edits for the next submit; add skips images that do not exist
+    void add(int topic, const std::string& imageName);
+    void remove(int topic, const std::string& imageName);
+    // Queues whatever makes the topic list exactly these names
+    void replace(int topic, const std::vector<std::string>& names);
+    // Re-reads the metadata of an image that changed on disk, in every topic listing it
+    void refresh(const std::string& imageName);
+
+    // Sends everything queued so far off as one batch
+    void submit();
+
+    // Batches or a compaction still in flight
+    bool isBusy() const { return inFlight > 0 || !batches.empty() || writing || compacting; }
+
+    const Catalog& target() const { return catalog; }
+
+    // Call once per frame. Applies batches that reached the disk, sends the
+    // next one, starts or adopts a compaction and returns the topics whose
+    // lists changed; refreshed metadata alone does not count.
+    std::vector<int> update();
+
+    // Waits until everything submitted is committed, for exit and the command line
+    std::vector<int> finish();
+
+private:
+    struct Edit {
+        bool remove;
+        bool update;    // new metadata for a listed name
+        bool mustExist; // dropped if readImageMetadata finds no file
+        bool missing;
+        CatalogEntry entry;
+
+        Edit() : remove(false), update(false), mustExist(false), missing(false) {}
+    };
+
+    // A submitted batch; its metadata is read in chunks across the pool
+    struct Job {
+        std::vector<Edit> edits;
+        std::atomic<std::size_t> remaining;
+
+        Job() : remaining(0) {}
+    };
+
+    struct Finished {
+        std::shared_ptr<Job> job;            // metadata read, or
+        std::shared_ptr<CatalogWrite> write; // a batch on disk, or with neither a compaction
+        bool written;                        // the compacted copy is complete
+    };
+
+    // Shared with in-flight tasks so they never outlive it
+    struct ResultQueue {
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<Finished> items;
+    };
+
+    CatalogBatch makeBatch(const Job& job) const;
+    void startWrite();
+    void startCompaction();
+    std::string compactedPath() const { return catalog.compactedPath(); }
+
+    Catalog& catalog;
+    ThreadPool& pool;
+    std::vector<Edit> queued;
+    std::shared_ptr<ResultQueue> results;
+    std::size_t inFlight;
+    std::deque<CatalogBatch> batches;      // metadata read, waiting for the disk
+    std::shared_ptr<CatalogWrite> writing; // the batch on its way to disk
+    bool compacting;
+    std::size_t compactionEdits; // catalog.editCount() when the copy was taken
+};
@@ -0,0 +1,339 @@
+#include <SFML/Graphics.hpp>
+#include "catalog.hpp"
+#include "imageDecoder.hpp"
+#include "ImageFunctions.hpp"
+#include "logger.hpp"
+#include "resample.hpp"
+#include "searchIndex.hpp"
+#include "threadPool.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+// Offline tool: renders every topic of the catalog to files for handouts,
+// without a window. Each slide is written scaled to fit --width x --height as
+// <out>/<NN> <topic>/<page>.png, and the topic's slides are laid out on
+// contact sheets of --columns x --rows as sheet-<n>.png beside them.
+//
+// One task per slide runs on the ThreadPool: decode (through the
+// DecoderRegistry, so transcoded copies are used), resample, PNG encode and
+// its cell of the sheet. The worker that fills the last cell of a sheet
+// encodes it, so nothing waits on the main thread and the export scales
+// with the cores until the disk is the limit. None of that needs OpenGL.
+//
+// --captions adds the captions from texts/captions.txt under each cell,
+// wrapped with TextWrapper. Text is rasterised by SFML through a render
+// texture, which needs an OpenGL context: on a build machine without a
+// display run it under a virtual one (xvfb-run), or leave captions out.
+//
+// usage: export [--out DIR] [--width W] [--height H] [--columns N] [--rows N]
+//               [--threads N] [--captions] [--no-slides] [--no-sheets]
+
+namespace {
+
+const unsigned CellWidth = 320;
+const unsigned CellHeight = 180;
+const unsigned CellGap = 12;
+const unsigned CaptionHeight = 48;
+const unsigned CaptionSize = 12;
+const sf::Uint8 Background = 255;
+
+struct Options {
+    std::string out;
+    sf::Vector2u slideSize;
+    unsigned columns;
+    unsigned rows;
+    unsigned threads;
+    bool captions;
+    bool slides;
+    bool sheets;
+};
+
+// Filled cell by cell from the workers, written by whichever fills the last one
+struct Sheet {
+    std::string path;
+    sf::Vector2u size;
+    std::size_t cells;
+    std::size_t filled;
+    std::vector<sf::Uint8> pixels;
+    std::mutex mutex;
+};
+
+struct ExportJob {
+    std::string imageName;
+    std::string slidePath; // empty with --no-slides
+    Sheet* sheet;          // null with --no-sheets
+    sf::Vector2u cellOrigin;
+    sf::Image caption;     // empty without --captions or a caption
+    bool written;
+};
+
+bool makeDirectory(const std::string& path) {
+#ifdef _WIN32
+    return _mkdir(path.c_str()) == 0 || errno == EEXIST;
+#else
+    return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+// Topic titles become directory names
+std::string fileNameFor(const std::string& title) {
+    std::string name;
+    for (char c : title) {
+        bool plain = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == ' ' || c == '-' || c == '_';
+        name += plain ? c : '_';
+    }
+    return name;
+}
+
+std::string numbered(const char* format, std::size_t number) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), format, static_cast<unsigned>(number));
+    return buffer;
+}
+
+bool savePng(const std::string& path, const sf::Uint8* pixels, const sf::Vector2u& size) {
+    sf::Image image;
+    image.create(size.x, size.y, pixels);
+    return image.saveToFile(path);
+}
+
+// Shrinks to fit size, or copies when it already fits
+void scaleToFit(const std::vector<sf::Uint8>& pixels, const sf::Vector2u& size, const sf::Vector2u& area,
+                std::vector<sf::Uint8>& scaled, sf::Vector2u& scaledSize) {
+    scaledSize = fitSize(size, area);
+    if (scaledSize == size) {
+        scaled.assign(pixels.begin(), pixels.begin() + static_cast<std::size_t>(size.x) * size.y * 4);
+        return;
+    }
+    scaled.resize(static_cast<std::size_t>(scaledSize.x) * scaledSize.y * 4);
+    if (!scaled.empty()) resampleArea(pixels.data(), size.x, size.y, scaled.data(), scaledSize.x, scaledSize.y);
+}
+
+// The sheet is laid out so every cell and caption fits
+void blit(const sf::Uint8* pixels, const sf::Vector2u& size, Sheet& sheet, const sf::Vector2u& origin) {
+    for (unsigned y = 0; y < size.y; ++y) {
+        std::memcpy(&sheet.pixels[(static_cast<std::size_t>(origin.y + y) * sheet.size.x + origin.x) * 4],
+                    pixels + static_cast<std::size_t>(y) * size.x * 4, static_cast<std::size_t>(size.x) * 4);
+    }
+}
+
+// Counts the cell even when the slide could not be decoded, so the sheet is still written
+void fillCell(const ExportJob& job, const std::vector<sf::Uint8>& cell, const sf::Vector2u& cellSize) {
+    Sheet* sheet = job.sheet;
+    {
+        std::lock_guard<std::mutex> lock(sheet->mutex);
+        if (sheet->pixels.empty()) sheet->pixels.assign(static_cast<std::size_t>(sheet->size.x) * sheet->size.y * 4, Background);
+    }
+    // Cells do not overlap, so they are copied in without the lock
+    if (!cell.empty()) {
+        blit(cell.data(), cellSize, *sheet, sf::Vector2u(job.cellOrigin.x + (CellWidth - cellSize.x) / 2, job.cellOrigin.y + (CellHeight - cellSize.y) / 2));
+    }
+    if (job.caption.getSize().x > 0) {
+        blit(job.caption.getPixelsPtr(), job.caption.getSize(), *sheet, sf::Vector2u(job.cellOrigin.x, job.cellOrigin.y + CellHeight));
+    }
+
+    std::vector<sf::Uint8> finished;
+    {
+        std::lock_guard<std::mutex> lock(sheet->mutex);
+        if (++sheet->filled == sheet->cells) finished.swap(sheet->pixels);
+    }
+    if (!finished.empty() && !savePng(sheet->path, finished.data(), sheet->size)) {
+        LOG_ERROR("Could not write " << sheet->path);
+    }
+}
+
+// Runs on a worker: the slide's PNG and its cell of the contact sheet
+void exportSlide(ExportJob& job, const Options& options) {
+    DecoderRegistry& decoders = DecoderRegistry::instance();
+    std::vector<sf::Uint8> pixels;
+    sf::Vector2u size;
+    if (!decoders.decodeImage(job.imageName, pixels, size)) {
+        LOG_ERROR("Could not decode image: " << job.imageName);
+        if (job.sheet) fillCell(job, std::vector<sf::Uint8>(), sf::Vector2u());
+        return;
+    }
+
+    std::vector<sf::Uint8> slide;
+    sf::Vector2u slideSize;
+    scaleToFit(pixels, size, options.slideSize, slide, slideSize);
+    decoders.pool().release(std::move(pixels));
+
+    job.written = true;
+    if (!job.slidePath.empty() && !savePng(job.slidePath, slide.data(), slideSize)) {
+        LOG_ERROR("Could not write " << job.slidePath);
+        job.written = false;
+    }
+
+    if (!job.sheet) return;
+
+    // From the scaled slide, which is already close to the cell
+    std::vector<sf::Uint8> cell;
+    sf::Vector2u cellSize;
+    scaleToFit(slide, slideSize, sf::Vector2u(CellWidth, CellHeight), cell, cellSize);
+    fillCell(job, cell, cellSize);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options{"export", sf::Vector2u(1280, 720), 4, 5, 0, false, true, true};
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--out") == 0 && hasValue) {
+            options.out = argv[++i];
+        } else if (std::strcmp(argv[i], "--width") == 0 && hasValue) {
+            options.slideSize.x = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--height") == 0 && hasValue) {
+            options.slideSize.y = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--columns") == 0 && hasValue) {
+            options.columns = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--rows") == 0 && hasValue) {
+            options.rows = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--threads") == 0 && hasValue) {
+            options.threads = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--captions") == 0) {
+            options.captions = true;
+        } else if (std::strcmp(argv[i], "--no-slides") == 0) {
+            options.slides = false;
+        } else if (std::strcmp(argv[i], "--no-sheets") == 0) {
+            options.sheets = false;
+        }
+    }
+    if (options.slideSize.x == 0 || options.slideSize.y == 0 || options.columns == 0 || options.rows == 0) {
+        LOG_ERROR("Slide size, columns and rows must be positive");
+        return 1;
+    }
+
+    TopicRegistry topics;
+    topics.discover();
+
+    Catalog catalog;
+    if (!openCatalog(catalog, "texts/catalog.bin", topics)) {
+        LOG_ERROR("Could not open the catalog");
+        return 1;
+    }
+
+    // Captions are rendered here, on the thread that owns the font and the GL context
+    sf::Font font;
+    std::unordered_map<std::string, std::string> captions;
+    std::unique_ptr<sf::RenderTexture> captionTexture;
+    unsigned captionHeight = 0;
+    if (options.captions && options.sheets) {
+        captions = SearchIndex::readCaptions("texts/captions.txt");
+        captionTexture.reset(new sf::RenderTexture());
+        if (!font.loadFromFile("fonts/Montserrat Light.otf") || !captionTexture->create(CellWidth, CaptionHeight)) {
+            LOG_ERROR("Captions need the font and an OpenGL context");
+            return 1;
+        }
+        captionHeight = CaptionHeight;
+    }
+
+    if (!makeDirectory(options.out)) {
+        LOG_ERROR("Could not create " << options.out);
+        return 1;
+    }
+
+    // Every job and sheet is created up front so workers only touch their own
+    std::vector<ExportJob> jobs;
+    std::vector<std::unique_ptr<Sheet>> sheets;
+    std::size_t perSheet = static_cast<std::size_t>(options.columns) * options.rows;
+    sf::Vector2u pitch(CellWidth + CellGap, CellHeight + captionHeight + CellGap);
+    for (int topic = 0; topic < catalog.topicCount(); ++topic) {
+        std::vector<std::string> names = catalog.names(topic);
+        if (names.empty()) continue;
+
+        std::string directory = options.out + "/" + numbered("%02u ", topic + 1) + fileNameFor(topics.name(topic));
+        if (!makeDirectory(directory)) {
+            LOG_ERROR("Could not create " << directory);
+            continue;
+        }
+
+        for (std::size_t page = 0; page < names.size(); ++page) {
+            ExportJob job;
+            job.imageName = names[page];
+            job.sheet = nullptr;
+            job.written = false;
+            if (options.slides) job.slidePath = directory + "/" + numbered("%03u.png", page + 1);
+
+            if (options.sheets) {
+                std::size_t index = page % perSheet;
+                if (index == 0) {
+                    std::size_t cells = std::min(perSheet, names.size() - page);
+                    std::size_t rows = (cells + options.columns - 1) / options.columns;
+                    std::size_t columns = std::min<std::size_t>(cells, options.columns);
+                    sheets.emplace_back(new Sheet());
+                    Sheet& sheet = *sheets.back();
+                    sheet.path = directory + "/" + numbered("sheet-%02u.png", page / perSheet + 1);
+                    sheet.size = sf::Vector2u(static_cast<unsigned>(CellGap + columns * pitch.x), static_cast<unsigned>(CellGap + rows * pitch.y));
+                    sheet.cells = cells;
+                    sheet.filled = 0;
+                }
+                job.sheet = sheets.back().get();
+                job.cellOrigin = sf::Vector2u(static_cast<unsigned>(CellGap + index % options.columns * pitch.x),
+                                              static_cast<unsigned>(CellGap + index / options.columns * pitch.y));
+            }
+            jobs.push_back(std::move(job));
+        }
+    }
+
+    sf::Clock clock;
+    ThreadPool pool(options.threads);
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::size_t done = 0;
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+        ExportJob* target = &jobs[i];
+
+        auto caption = captions.find(target->imageName);
+        if (captionTexture && caption != captions.end()) {
+            sf::Text text(TextWrapper<char, std::string>::wrapText(caption->second, CellWidth - 8, font, CaptionSize), font, CaptionSize);
+            text.setFillColor(sf::Color::Black);
+            text.setPosition(4, 4);
+            captionTexture->clear(sf::Color(Background, Background, Background));
+            captionTexture->draw(text);
+            captionTexture->display();
+            target->caption = captionTexture->getTexture().copyToImage();
+
+            // Rendered captions wait in memory, so stay only a few tasks ahead of the workers
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [&done, &pool, i] { return i - done < 4 * pool.workerCount(); });
+        }
+
+        pool.submit([target, &options, &mutex, &finished, &done] {
+            exportSlide(*target, options);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            ++done;
+            finished.notify_all();
+        });
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&done, &jobs] { return done == jobs.size(); });
+    }
+
+    std::size_t written = 0;
+    for (const auto& job : jobs) {
+        if (job.written) ++written;
+    }
+    float seconds = clock.getElapsedTime().asSeconds();
+    LOG_INFO("Exported " << written << " of " << jobs.size() << " slides and " << sheets.size() << " contact sheets to "
+             << options.out << " in " << seconds << " s on " << pool.workerCount() << " threads ("
+             << (seconds > 0 ? written / seconds : 0.0f) << " slides/s)");
+    return written == jobs.size() ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+#include "fileWatcher.hpp"
+#include "logger.hpp"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+FileWatcher::FileWatcher(std::chrono::milliseconds settle) : settle(settle), fd(-1), watching(false), stopping(false) {}
+
+FileWatcher::~FileWatcher() {
+    stopping = true;
+    if (thread.joinable()) thread.join();
+#ifdef __linux__
+    if (fd >= 0) close(fd);
+#endif
+}
+
+#ifdef __linux__
+
+bool FileWatcher::watch(const std::string& directory) {
+    if (fd < 0) {
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0) {
+            LOG_ERROR("Could not start watching files");
+            return false;
+        }
+    }
+
+    int wd = inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE);
+    if (wd < 0) {
+        LOG_ERROR("Could not watch directory: " << directory);
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        directories[wd] = directory;
+    }
+
+    if (!watching) {
+        watching = true;
+        thread = std::thread(&FileWatcher::run, this);
+    }
+    return true;
+}
+
+void FileWatcher::run() {
+    // Large enough for a burst of events with long names
+    alignas(inotify_event) char buffer[64 * 1024];
+
+    while (!stopping) {
+        pollfd ready = {fd, POLLIN, 0};
+        if (::poll(&ready, 1, 100) <= 0) continue;
+
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        for (ssize_t offset = 0; offset < length;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (const auto& directory : directories) {
+                    Pending rescan;
+                    rescan.change.directory = directory.second;
+                    rescan.last = Clock::now();
+                    pending[directory.second + "/"] = rescan;
+                }
+                continue;
+            }
+            if (event->len == 0) continue;
+
+            std::string directory;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto found = directories.find(event->wd);
+                if (found == directories.end()) continue;
+                directory = found->second;
+            }
+            note(directory, event->name, (event->mask & (IN_DELETE | IN_MOVED_FROM)) != 0);
+        }
+    }
+}
+
+#else
+
+bool FileWatcher::watch(const std::string& directory) {
+    LOG_WARNING("File watching is not supported on this platform, not watching " << directory);
+    return false;
+}
+
+void FileWatcher::run() {}
+
+#endif
+
+void FileWatcher::note(const std::string& directory, const std::string& name, bool removed) {
+    if (name.empty() || name[0] == '.') return;
+    if (name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0) return;
+
+    Pending change;
+    change.change.directory = directory;
+    change.change.name = name;
+    change.change.removed = removed;
+    change.last = Clock::now();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    pending[directory + "/" + name] = change;
+}
+
+std::vector<FileChange> FileWatcher::poll() {
+    std::vector<FileChange> settled;
+    if (!watching) return settled;
+
+    Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = pending.begin(); it != pending.end();) {
+        if (now - it->second.last < settle) {
+            ++it;
+            continue;
+        }
+        settled.push_back(it->second.change);
+        it = pending.erase(it);
+    }
+    return settled;
+}
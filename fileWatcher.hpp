@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A file in a watched directory that was written, moved in or removed. An
+// empty name means events were lost and the whole directory should be rescanned.
+struct FileChange {
+    std::string directory;
+    std::string name;
+    bool removed;
+
+    FileChange() : removed(false) {}
+};
+
+// Watches directories (not recursively) on a background thread. A path is only
+// reported once it has been quiet for the settle time, so a burst of writes,
+// like an rsync of new slides, turns into one change per file. Hidden and .tmp
+// files are ignored; they are partial writes that get renamed into place.
+//
+// Uses inotify on Linux. Elsewhere watch() fails and nothing is reported.
+class FileWatcher {
+public:
+    explicit FileWatcher(std::chrono::milliseconds settle = std::chrono::milliseconds(250));
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    bool watch(const std::string& directory);
+    bool isWatching() const { return watching; }
+
+    // Changes that have settled since the last call
+    std::vector<FileChange> poll();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Pending {
+        FileChange change;
+        Clock::time_point last;
+    };
+
+    void run();
+    void note(const std::string& directory, const std::string& name, bool removed);
+
+    std::chrono::milliseconds settle;
+    int fd;
+    bool watching;
+    std::atomic<bool> stopping;
+    std::thread thread;
+
+    std::mutex mutex;
+    std::map<int, std::string> directories; // watch descriptor to directory
+    std::map<std::string, Pending> pending;  // keyed by directory/name
+};
@@ -0,0 +1,73 @@
+#include "glyphMetrics.hpp"
+#include <cmath>
+#include <limits>
+#include <map>
+#include <memory>
+#include <tuple>
+
+namespace {
+
+typedef std::tuple<const sf::Font*, unsigned, bool> MetricsKey;
+
+std::map<MetricsKey, std::unique_ptr<GlyphMetrics>>& registry() {
+    static std::map<MetricsKey, std::unique_ptr<GlyphMetrics>> metrics;
+    return metrics;
+}
+
+} // namespace
+
+GlyphMetrics& GlyphMetrics::get(const sf::Font& font, unsigned characterSize, bool bold) {
+    std::unique_ptr<GlyphMetrics>& metrics = registry()[MetricsKey(&font, characterSize, bold)];
+    if (!metrics) {
+        metrics.reset(new GlyphMetrics(font, characterSize, bold));
+    }
+    return *metrics;
+}
+
+void GlyphMetrics::clearAll() {
+    registry().clear();
+}
+
+GlyphMetrics::GlyphMetrics(const sf::Font& font, unsigned characterSize, bool bold)
+    : font(font), characterSize(characterSize), bold(bold),
+      asciiKerning(AsciiCount * AsciiCount, std::numeric_limits<float>::quiet_NaN()) {
+    for (unsigned i = 0; i < AsciiCount; ++i) {
+        asciiAdvance[i] = -1.0f;
+    }
+    space = advance(' ');
+}
+
+float GlyphMetrics::advance(sf::Uint32 codePoint) {
+    if (codePoint < AsciiCount) {
+        float& cached = asciiAdvance[codePoint];
+        if (cached < 0.0f) {
+            cached = font.getGlyph(codePoint, characterSize, bold).advance;
+        }
+        return cached;
+    }
+
+    auto found = advances.find(codePoint);
+    if (found != advances.end()) return found->second;
+    float value = font.getGlyph(codePoint, characterSize, bold).advance;
+    advances.emplace(codePoint, value);
+    return value;
+}
+
+float GlyphMetrics::kerning(sf::Uint32 first, sf::Uint32 second) {
+    if (first == 0) return 0.0f;
+
+    if (first < AsciiCount && second < AsciiCount) {
+        float& cached = asciiKerning[first * AsciiCount + second];
+        if (std::isnan(cached)) {
+            cached = font.getKerning(first, second, characterSize);
+        }
+        return cached;
+    }
+
+    unsigned long long key = (static_cast<unsigned long long>(first) << 32) | second;
+    auto found = kernings.find(key);
+    if (found != kernings.end()) return found->second;
+    float value = font.getKerning(first, second, characterSize);
+    kernings.emplace(key, value);
+    return value;
+}
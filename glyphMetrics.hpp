@@ -0,0 +1,53 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+// Advances and kerning of one (font, character size, style), looked up from
+// the font once and then served from tables. sf::Font is not thread safe so
+// neither is this, use it from the thread that owns the font.
+class GlyphMetrics {
+public:
+    // Shared metrics for the combination, created on first use
+    static GlyphMetrics& get(const sf::Font& font, unsigned characterSize, bool bold = false);
+    // Drops every cached table, call after reloading a font at the same address
+    static void clearAll();
+
+    float advance(sf::Uint32 codePoint);
+    float kerning(sf::Uint32 first, sf::Uint32 second);
+    float spaceAdvance() { return space; }
+
+    // Width of a run of code points with the kerning between them
+    template<typename Iterator>
+    float measure(Iterator begin, Iterator end) {
+        float width = 0.0f;
+        sf::Uint32 previous = 0;
+        for (; begin != end; ++begin) {
+            width += kerning(previous, *begin) + advance(*begin);
+            previous = *begin;
+        }
+        return width;
+    }
+
+    const sf::Font& getFont() const { return font; }
+    unsigned getCharacterSize() const { return characterSize; }
+    bool isBold() const { return bold; }
+
+private:
+    GlyphMetrics(const sf::Font& font, unsigned characterSize, bool bold);
+
+    static const unsigned AsciiCount = 128;
+
+    const sf::Font& font;
+    unsigned characterSize;
+    bool bold;
+    float space;
+
+    // ASCII is served from flat tables, anything else from hash maps. A
+    // negative advance and NaN kerning mark slots not fetched yet.
+    float asciiAdvance[AsciiCount];
+    std::vector<float> asciiKerning;
+    std::unordered_map<sf::Uint32, float> advances;
+    std::unordered_map<unsigned long long, float> kernings;
+};
@@ -0,0 +1,106 @@
+#include "hotReload.hpp"
+#include "ImageFunctions.hpp"
+#include "logger.hpp"
+#include "profiler.hpp"
+#include "threadPool.hpp"
+#include <algorithm>
+#include <fstream>
+#include <unordered_set>
+
+HotReload::HotReload(TopicRegistry& topics, TextureCache& cache, ThreadPool& pool, CatalogWriter* writer)
+    : topics(topics), cache(cache), pool(pool), writer(writer), lists(std::make_shared<ListQueue>()) {}
+
+bool HotReload::start() {
+    bool texts = watcher.watch("texts");
+    bool images = watcher.watch("images");
+    return texts && images;
+}
+
+std::vector<int> HotReload::update(std::vector<std::vector<ImageHandle>>& images) {
+    std::vector<int> changed;
+
+    for (const FileChange& change : watcher.poll()) {
+        PROFILE_ZONE("hot reload");
+        if (change.directory == "texts") {
+            if (change.name.empty()) {
+                // Events were dropped, so every list may have changed
+                rediscover(images, changed);
+                for (std::size_t i = 0; i < images.size(); ++i) queueList(static_cast<int>(i));
+            } else if (change.name == "topics.txt") {
+                rediscover(images, changed);
+            } else {
+                int topic = TopicRegistry::topicOfList(change.name);
+                if (topic < 0) continue;
+                if (topic >= static_cast<int>(images.size())) rediscover(images, changed);
+                queueList(topic);
+            }
+        } else if (change.directory == "images" && !change.name.empty()) {
+            if (cache.reload(change.name)) {
+                LOG_INFO("Reloading changed image: " << change.name);
+            }
+            // Keeps the size, mtime and hash current so it is not shared by a stale hash
+            if (writer) writer->refresh(change.name);
+        }
+    }
+    if (writer) writer->submit();
+
+    std::deque<ListResult> finished;
+    {
+        std::lock_guard<std::mutex> lock(lists->mutex);
+        finished.swap(lists->items);
+    }
+    for (const ListResult& result : finished) {
+        if (apply(result, images)) changed.push_back(result.topic);
+    }
+
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+    return changed;
+}
+
+void HotReload::rediscover(std::vector<std::vector<ImageHandle>>& images, std::vector<int>& changed) {
+    topics.discover();
+    if (writer) topics.include(writer->target());
+    if (topics.size() > images.size()) images.resize(topics.size());
+    for (std::size_t i = 0; i < images.size(); ++i) changed.push_back(static_cast<int>(i));
+}
+
+void HotReload::queueList(int topic) {
+    std::shared_ptr<ListQueue> queue = lists;
+    std::string path = TopicRegistry::listPath(topic);
+
+    pool.submit([queue, topic, path] {
+        ListResult result;
+        result.topic = topic;
+
+        std::ifstream list(path);
+        result.read = static_cast<bool>(list);
+        std::unordered_set<std::string> listed;
+        std::string line;
+        while (std::getline(list, line)) {
+            if (line.empty() || !listed.insert(line).second) continue;
+            result.names.push_back(line);
+        }
+
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->items.push_back(std::move(result));
+    });
+}
+
+bool HotReload::apply(const ListResult& result, std::vector<std::vector<ImageHandle>>& images) {
+    if (!result.read) {
+        LOG_ERROR("Failed to open file: " << TopicRegistry::listPath(result.topic));
+        return false;
+    }
+    if (result.topic >= static_cast<int>(images.size())) images.resize(result.topic + 1);
+
+    if (!writer) {
+        applyTopicList(result.topic, result.names, cache, images);
+        return true;
+    }
+
+    // Metadata of new names is read and the batch written on the pool
+    writer->replace(result.topic, result.names);
+    writer->submit();
+    return false;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "catalogWriter.hpp"
+#include "fileWatcher.hpp"
+#include "textureCache.hpp"
+#include "topicRegistry.hpp"
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// Picks up content copied onto a running install. An edited texts/textN.txt is
+// re-read and diffed against its topic, an edited topics.txt renames topics and
+// a changed image is decoded again in place. Lists are read on the pool; with
+// a catalog, the edits go through its CatalogWriter like any other and the
+// topic is reloaded once CatalogWriter::update reports it.
+class HotReload {
+public:
+    HotReload(TopicRegistry& topics, TextureCache& cache, ThreadPool& pool, CatalogWriter* writer = nullptr);
+
+    // Watches texts/ and images/, false where file watching is unsupported
+    bool start();
+    bool isActive() const { return watcher.isWatching(); }
+
+    // Call once per frame. Returns the topics whose name or slides changed,
+    // every topic after topics.txt changed since names may have moved.
+    std::vector<int> update(std::vector<std::vector<ImageHandle>>& images);
+
+private:
+    // A topic list read on the pool
+    struct ListResult {
+        int topic;
+        bool read;
+        std::vector<std::string> names;
+
+        ListResult() : topic(0), read(false) {}
+    };
+
+    // Shared with in-flight tasks so they never outlive it
+    struct ListQueue {
+        std::mutex mutex;
+        std::deque<ListResult> items;
+    };
+
+    void queueList(int topic);
+    void rediscover(std::vector<std::vector<ImageHandle>>& images, std::vector<int>& changed);
+    // True if the topic changed now rather than once the catalog writer got to it
+    bool apply(const ListResult& result, std::vector<std::vector<ImageHandle>>& images);
+
+    TopicRegistry& topics;
+    TextureCache& cache;
+    ThreadPool& pool;
+    CatalogWriter* writer;
+    FileWatcher watcher;
+    std::shared_ptr<ListQueue> lists;
+};
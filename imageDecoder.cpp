@@ -0,0 +1,370 @@
+#include "imageDecoder.hpp"
+#include "logger.hpp"
+#include "mappedFile.hpp"
+#include "profiler.hpp"
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cstring>
+#include <sys/stat.h>
+
+const std::size_t PixelPool::MaxBytes;
+
+std::vector<sf::Uint8> PixelPool::acquire(std::size_t bytes) {
+    std::vector<sf::Uint8> buffer;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto best = buffers.end();
+        for (auto it = buffers.begin(); it != buffers.end(); ++it) {
+            if (it->capacity() >= bytes && (best == buffers.end() || it->capacity() < best->capacity())) best = it;
+        }
+        if (best != buffers.end()) {
+            pooled -= best->capacity();
+            buffer.swap(*best);
+            buffers.erase(best);
+        }
+    }
+    buffer.resize(bytes);
+    return buffer;
+}
+
+void PixelPool::release(std::vector<sf::Uint8>&& buffer) {
+    std::vector<sf::Uint8> released(std::move(buffer));
+    if (released.capacity() == 0 || released.capacity() > MaxBytes) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    pooled += released.capacity();
+    buffers.push_back(std::move(released));
+    while (pooled > MaxBytes) {
+        auto smallest = std::min_element(buffers.begin(), buffers.end(), [](const std::vector<sf::Uint8>& a, const std::vector<sf::Uint8>& b) {
+            return a.capacity() < b.capacity();
+        });
+        pooled -= smallest->capacity();
+        buffers.erase(smallest);
+    }
+}
+
+std::size_t PixelPool::pooledBytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pooled;
+}
+
+namespace {
+
+// Larger images are rejected rather than trusted with a huge allocation
+const std::uint64_t MaxPixels = 400000000;
+
+std::uint32_t readBigEndian(const unsigned char* bytes) {
+    return (static_cast<std::uint32_t>(bytes[0]) << 24) | (static_cast<std::uint32_t>(bytes[1]) << 16) |
+           (static_cast<std::uint32_t>(bytes[2]) << 8) | bytes[3];
+}
+
+void writeBigEndian(std::vector<unsigned char>& out, std::uint32_t value) {
+    out.push_back(static_cast<unsigned char>(value >> 24));
+    out.push_back(static_cast<unsigned char>(value >> 16));
+    out.push_back(static_cast<unsigned char>(value >> 8));
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+bool validSize(std::uint32_t width, std::uint32_t height) {
+    return width > 0 && height > 0 && static_cast<std::uint64_t>(width) * height <= MaxPixels;
+}
+
+// "Quite OK Image" format (qoiformat.org): about as small as PNG for slides and
+// several times faster to decode, since it is one pass over the bytes with no
+// entropy coding
+const unsigned char QoiMagic[4] = {'q', 'o', 'i', 'f'};
+const std::size_t QoiHeaderSize = 14;
+const unsigned char QoiEnd[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+const unsigned char QoiIndex = 0x00;
+const unsigned char QoiDiff = 0x40;
+const unsigned char QoiLuma = 0x80;
+const unsigned char QoiRun = 0xC0;
+const unsigned char QoiRgb = 0xFE;
+const unsigned char QoiRgba = 0xFF;
+
+unsigned qoiHash(const sf::Uint8* pixel) {
+    return (pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64;
+}
+
+class QoiDecoder : public ImageDecoder {
+public:
+    const char* name() const override { return "qoi"; }
+
+    bool accepts(const unsigned char* data, std::size_t length) const override {
+        return length >= sizeof(QoiMagic) && std::memcmp(data, QoiMagic, sizeof(QoiMagic)) == 0;
+    }
+
+    bool readSize(const unsigned char* data, std::size_t length, sf::Vector2u& size) const override {
+        if (length < QoiHeaderSize + sizeof(QoiEnd) || !accepts(data, length)) return false;
+        std::uint32_t width = readBigEndian(data + 4);
+        std::uint32_t height = readBigEndian(data + 8);
+        unsigned channels = data[12];
+        if (!validSize(width, height) || (channels != 3 && channels != 4)) return false;
+        size = sf::Vector2u(width, height);
+        return true;
+    }
+
+    bool decode(const unsigned char* data, std::size_t length, PixelPool& pool, std::vector<sf::Uint8>& pixels, sf::Vector2u& size) const override {
+        PROFILE_ZONE("decode qoi");
+        sf::Vector2u header;
+        if (!readSize(data, length, header)) return false;
+
+        std::size_t count = static_cast<std::size_t>(header.x) * header.y;
+        std::vector<sf::Uint8> out = pool.acquire(count * 4);
+        sf::Uint8 index[64 * 4] = {};
+        sf::Uint8 pixel[4] = {0, 0, 0, 255};
+        std::size_t position = QoiHeaderSize;
+        std::size_t end = length - sizeof(QoiEnd);
+        unsigned run = 0;
+
+        for (std::size_t i = 0; i < count; ++i) {
+            if (run > 0) {
+                --run;
+            } else {
+                if (position >= end) {
+                    pool.release(std::move(out));
+                    return false;
+                }
+                unsigned op = data[position++];
+                if (op == QoiRgb || op == QoiRgba) {
+                    std::size_t bytes = op == QoiRgb ? 3 : 4;
+                    if (position + bytes > end) {
+                        pool.release(std::move(out));
+                        return false;
+                    }
+                    std::memcpy(pixel, data + position, bytes);
+                    position += bytes;
+                } else if ((op & 0xC0) == QoiIndex) {
+                    std::memcpy(pixel, index + op * 4, 4);
+                } else if ((op & 0xC0) == QoiDiff) {
+                    pixel[0] = static_cast<sf::Uint8>(pixel[0] + ((op >> 4) & 3) - 2);
+                    pixel[1] = static_cast<sf::Uint8>(pixel[1] + ((op >> 2) & 3) - 2);
+                    pixel[2] = static_cast<sf::Uint8>(pixel[2] + (op & 3) - 2);
+                } else if ((op & 0xC0) == QoiLuma) {
+                    if (position >= end) {
+                        pool.release(std::move(out));
+                        return false;
+                    }
+                    unsigned next = data[position++];
+                    int green = static_cast<int>(op & 0x3F) - 32;
+                    pixel[0] = static_cast<sf::Uint8>(pixel[0] + green - 8 + ((next >> 4) & 0x0F));
+                    pixel[1] = static_cast<sf::Uint8>(pixel[1] + green);
+                    pixel[2] = static_cast<sf::Uint8>(pixel[2] + green - 8 + (next & 0x0F));
+                } else {
+                    run = op & 0x3F;
+                }
+                std::memcpy(index + qoiHash(pixel) * 4, pixel, 4);
+            }
+            std::memcpy(&out[i * 4], pixel, 4);
+        }
+
+        pixels.swap(out);
+        pool.release(std::move(out));
+        size = header;
+        return true;
+    }
+};
+
+class RawImageDecoder : public ImageDecoder {
+public:
+    const char* name() const override { return "raw"; }
+
+    bool accepts(const unsigned char* data, std::size_t length) const override {
+        return length >= sizeof(RawImageMagic) && std::memcmp(data, RawImageMagic, sizeof(RawImageMagic)) == 0;
+    }
+
+    bool readSize(const unsigned char* data, std::size_t length, sf::Vector2u& size) const override {
+        RawImageHeader header;
+        if (length < sizeof(header) || !accepts(data, length)) return false;
+        std::memcpy(&header, data, sizeof(header));
+        if (header.version != RawImageVersion || !validSize(header.width, header.height) ||
+            length - sizeof(header) < static_cast<std::uint64_t>(header.width) * header.height * 4) {
+            return false;
+        }
+        size = sf::Vector2u(header.width, header.height);
+        return true;
+    }
+
+    bool decode(const unsigned char* data, std::size_t length, PixelPool& pool, std::vector<sf::Uint8>& pixels, sf::Vector2u& size) const override {
+        PROFILE_ZONE("decode raw");
+        sf::Vector2u header;
+        if (!readSize(data, length, header)) return false;
+
+        std::vector<sf::Uint8> out = pool.acquire(static_cast<std::size_t>(header.x) * header.y * 4);
+        std::memcpy(out.data(), data + sizeof(RawImageHeader), out.size());
+        pixels.swap(out);
+        pool.release(std::move(out));
+        size = header;
+        return true;
+    }
+};
+
+// PNG, JPEG, BMP, TGA and whatever else SFML reads. Takes any file, so it is
+// asked last; the pixels are copied out of the sf::Image it decodes into.
+class SfmlDecoder : public ImageDecoder {
+public:
+    const char* name() const override { return "sfml"; }
+
+    bool accepts(const unsigned char*, std::size_t) const override { return true; }
+
+    // Only PNG, where IHDR is always the first chunk
+    bool readSize(const unsigned char* data, std::size_t length, sf::Vector2u& size) const override {
+        static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+        if (length < 24 || std::memcmp(data, signature, sizeof(signature)) != 0 || std::memcmp(data + 12, "IHDR", 4) != 0) return false;
+        size = sf::Vector2u(readBigEndian(data + 16), readBigEndian(data + 20));
+        return true;
+    }
+
+    bool decode(const unsigned char* data, std::size_t length, PixelPool& pool, std::vector<sf::Uint8>& pixels, sf::Vector2u& size) const override {
+        PROFILE_ZONE("decode sfml");
+        sf::Image image;
+        if (!image.loadFromMemory(data, length)) return false;
+
+        std::vector<sf::Uint8> out = pool.acquire(static_cast<std::size_t>(image.getSize().x) * image.getSize().y * 4);
+        if (!out.empty()) std::memcpy(out.data(), image.getPixelsPtr(), out.size());
+        pixels.swap(out);
+        pool.release(std::move(out));
+        size = image.getSize();
+        return true;
+    }
+};
+
+} // namespace
+
+DecoderRegistry& DecoderRegistry::instance() {
+    static DecoderRegistry registry;
+    return registry;
+}
+
+DecoderRegistry::DecoderRegistry() {
+    add(std::make_unique<SfmlDecoder>());
+    add(std::make_unique<RawImageDecoder>());
+    add(std::make_unique<QoiDecoder>());
+}
+
+void DecoderRegistry::add(std::unique_ptr<ImageDecoder> decoder) {
+    list.insert(list.begin(), std::move(decoder));
+}
+
+const ImageDecoder* DecoderRegistry::find(const unsigned char* data, std::size_t length) const {
+    for (const auto& decoder : list) {
+        if (decoder->accepts(data, length)) return decoder.get();
+    }
+    return nullptr;
+}
+
+const ImageDecoder* DecoderRegistry::find(const std::string& name) const {
+    for (const auto& decoder : list) {
+        if (name == decoder->name()) return decoder.get();
+    }
+    return nullptr;
+}
+
+std::vector<const ImageDecoder*> DecoderRegistry::decoders() const {
+    std::vector<const ImageDecoder*> all;
+    for (const auto& decoder : list) all.push_back(decoder.get());
+    return all;
+}
+
+bool DecoderRegistry::readSize(const unsigned char* data, std::size_t length, sf::Vector2u& size) const {
+    const ImageDecoder* decoder = find(data, length);
+    return decoder && decoder->readSize(data, length, size);
+}
+
+bool DecoderRegistry::decode(const unsigned char* data, std::size_t length, std::vector<sf::Uint8>& pixels, sf::Vector2u& size) {
+    const ImageDecoder* decoder = find(data, length);
+    return decoder && decoder->decode(data, length, buffers, pixels, size);
+}
+
+bool DecoderRegistry::decodeFile(const std::string& path, std::vector<sf::Uint8>& pixels, sf::Vector2u& size) {
+    MappedFile file;
+    return file.open(path) && decode(file.data(), file.size(), pixels, size);
+}
+
+bool DecoderRegistry::decodeImage(const std::string& imageName, std::vector<sf::Uint8>& pixels, sf::Vector2u& size) {
+    std::string path = "images/" + imageName;
+    struct stat source;
+    bool hasSource = stat(path.c_str(), &source) == 0;
+
+    for (const char* extension : TranscodedExtensions) {
+        std::string copyPath = path + extension;
+        struct stat copy;
+        if (stat(copyPath.c_str(), &copy) != 0 || (hasSource && copy.st_mtime < source.st_mtime)) continue;
+        if (decodeFile(copyPath, pixels, size)) return true;
+        LOG_WARNING("Unreadable transcoded image, decoding the original: " << copyPath);
+    }
+    return hasSource && decodeFile(path, pixels, size);
+}
+
+void encodeQoi(const sf::Uint8* pixels, const sf::Vector2u& size, std::vector<unsigned char>& out) {
+    out.clear();
+    out.reserve(QoiHeaderSize + static_cast<std::size_t>(size.x) * size.y + sizeof(QoiEnd));
+    out.insert(out.end(), QoiMagic, QoiMagic + sizeof(QoiMagic));
+    writeBigEndian(out, size.x);
+    writeBigEndian(out, size.y);
+    out.push_back(4); // channels
+    out.push_back(0); // sRGB with linear alpha
+
+    sf::Uint8 index[64 * 4] = {};
+    sf::Uint8 previous[4] = {0, 0, 0, 255};
+    unsigned run = 0;
+    std::size_t count = static_cast<std::size_t>(size.x) * size.y;
+
+    for (std::size_t i = 0; i < count; ++i) {
+        const sf::Uint8* pixel = pixels + i * 4;
+        if (std::memcmp(pixel, previous, 4) == 0) {
+            if (++run == 62 || i + 1 == count) {
+                out.push_back(static_cast<unsigned char>(QoiRun | (run - 1)));
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            out.push_back(static_cast<unsigned char>(QoiRun | (run - 1)));
+            run = 0;
+        }
+
+        unsigned hash = qoiHash(pixel);
+        if (std::memcmp(index + hash * 4, pixel, 4) == 0) {
+            out.push_back(static_cast<unsigned char>(QoiIndex | hash));
+        } else {
+            std::memcpy(index + hash * 4, pixel, 4);
+            if (pixel[3] == previous[3]) {
+                int red = static_cast<signed char>(pixel[0] - previous[0]);
+                int green = static_cast<signed char>(pixel[1] - previous[1]);
+                int blue = static_cast<signed char>(pixel[2] - previous[2]);
+                int redGreen = red - green;
+                int blueGreen = blue - green;
+                if (red >= -2 && red <= 1 && green >= -2 && green <= 1 && blue >= -2 && blue <= 1) {
+                    out.push_back(static_cast<unsigned char>(QoiDiff | (red + 2) << 4 | (green + 2) << 2 | (blue + 2)));
+                } else if (redGreen >= -8 && redGreen <= 7 && green >= -32 && green <= 31 && blueGreen >= -8 && blueGreen <= 7) {
+                    out.push_back(static_cast<unsigned char>(QoiLuma | (green + 32)));
+                    out.push_back(static_cast<unsigned char>((redGreen + 8) << 4 | (blueGreen + 8)));
+                } else {
+                    out.push_back(QoiRgb);
+                    out.insert(out.end(), pixel, pixel + 3);
+                }
+            } else {
+                out.push_back(QoiRgba);
+                out.insert(out.end(), pixel, pixel + 4);
+            }
+        }
+        std::memcpy(previous, pixel, 4);
+    }
+
+    out.insert(out.end(), QoiEnd, QoiEnd + sizeof(QoiEnd));
+}
+
+void encodeRawImage(const sf::Uint8* pixels, const sf::Vector2u& size, std::vector<unsigned char>& out) {
+    RawImageHeader header = {};
+    std::memcpy(header.magic, RawImageMagic, sizeof(RawImageMagic));
+    header.version = RawImageVersion;
+    header.width = size.x;
+    header.height = size.y;
+
+    std::size_t pixelBytes = static_cast<std::size_t>(size.x) * size.y * 4;
+    out.resize(sizeof(header) + pixelBytes);
+    std::memcpy(out.data(), &header, sizeof(header));
+    std::memcpy(out.data() + sizeof(header), pixels, pixelBytes);
+}
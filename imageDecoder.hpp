@@ -0,0 +1,97 @@
+#pragma once
+#include <SFML/System.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Recycles pixel buffers between decodes, so loading a slide reuses the
+// memory of one that was uploaded before instead of allocating it again
+class PixelPool {
+public:
+    static const std::size_t MaxBytes = 64u * 1024u * 1024u;
+
+    PixelPool() : pooled(0) {}
+
+    // A buffer of exactly bytes, from the smallest pooled one that holds them
+    std::vector<sf::Uint8> acquire(std::size_t bytes);
+    // Keeps the buffer for a later acquire. Over MaxBytes the smallest are freed.
+    void release(std::vector<sf::Uint8>&& buffer);
+
+    std::size_t pooledBytes() const;
+
+private:
+    mutable std::mutex mutex;
+    std::vector<std::vector<sf::Uint8>> buffers;
+    std::size_t pooled;
+};
+
+// One image format. Decoders are stateless and called from any thread.
+class ImageDecoder {
+public:
+    virtual ~ImageDecoder() {}
+
+    virtual const char* name() const = 0;
+    // Checks the file's signature only
+    virtual bool accepts(const unsigned char* data, std::size_t length) const = 0;
+    // Reads the dimensions from the header without decoding
+    virtual bool readSize(const unsigned char* data, std::size_t length, sf::Vector2u& size) const = 0;
+    // Decodes to RGBA in a buffer from the pool. Returns false if the file is corrupt.
+    virtual bool decode(const unsigned char* data, std::size_t length, PixelPool& pool, std::vector<sf::Uint8>& pixels, sf::Vector2u& size) const = 0;
+};
+
+// On-disk layout of an uncompressed image: RawImageHeader, then width * height
+// RGBA pixels. Decoding it is a copy, at the price of 4 bytes per pixel on disk.
+struct RawImageHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t reserved;
+};
+
+const char RawImageMagic[8] = {'C', 'Q', 'R', 'A', 'W', 'I', 'M', 'G'};
+const std::uint32_t RawImageVersion = 1;
+
+// Extensions transcode appends to an image's name for its copy in another
+// format, e.g. images/intro.png.qoi, fastest to decode first
+const char* const TranscodedExtensions[] = {".raw", ".qoi"};
+
+// Picks the decoder for a file from its first bytes, not its name, so a list
+// may name a QOI or raw image as well as a PNG. Built in are QOI, raw and
+// SFML's loader, which takes everything the others do not.
+class DecoderRegistry {
+public:
+    static DecoderRegistry& instance();
+
+    // Decoders added later are asked first, so one can take over a format.
+    // Not thread safe; add decoders before any image is loaded.
+    void add(std::unique_ptr<ImageDecoder> decoder);
+
+    const ImageDecoder* find(const unsigned char* data, std::size_t length) const;
+    const ImageDecoder* find(const std::string& name) const;
+    std::vector<const ImageDecoder*> decoders() const;
+
+    bool readSize(const unsigned char* data, std::size_t length, sf::Vector2u& size) const;
+    bool decode(const unsigned char* data, std::size_t length, std::vector<sf::Uint8>& pixels, sf::Vector2u& size);
+    bool decodeFile(const std::string& path, std::vector<sf::Uint8>& pixels, sf::Vector2u& size);
+
+    // Decodes images/<imageName>, or its transcoded copy if one is at least as
+    // new as the file. An edited original is used until it is transcoded again.
+    bool decodeImage(const std::string& imageName, std::vector<sf::Uint8>& pixels, sf::Vector2u& size);
+
+    // Buffers handed out by decode; give them back once uploaded
+    PixelPool& pool() { return buffers; }
+
+private:
+    DecoderRegistry();
+
+    std::vector<std::unique_ptr<ImageDecoder>> list; // asked in order
+    PixelPool buffers;
+};
+
+// Encoders used by the transcode tool and the benchmarks
+void encodeQoi(const sf::Uint8* pixels, const sf::Vector2u& size, std::vector<unsigned char>& out);
+void encodeRawImage(const sf::Uint8* pixels, const sf::Vector2u& size, std::vector<unsigned char>& out);
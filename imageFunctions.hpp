@@ -3,131 +3,261 @@
 #include <vector>
 #include <string>
 #include <functional>
+#include <sstream>
+#include <unordered_map>
+#include "catalog.hpp"
+#include "glyphMetrics.hpp"
+#include "textureCache.hpp"
+#include "topicRegistry.hpp"
+#include "widgets.hpp"
 
 // classes
 // template
 // OOP
 
 struct Button {
-    sf::RectangleShape shape;
-    sf::Text text;
+    WidgetLayer& layer;
+    WidgetLayer::WidgetId id;
     bool isActive;
 
-    Button(const sf::Vector2f& position, const sf::Vector2f& size, const std::string& label, const sf::Font& font) {
-        shape.setPosition(position);
-        shape.setSize(size);
-        shape.setFillColor(sf::Color::Blue); // Example color
-
-        text.setFont(font);
-        text.setString(label);
-        text.setCharacterSize(20); // Example size
-        text.setFillColor(sf::Color::White);
-        text.setPosition(position.x + (size.x - text.getLocalBounds().width) / 2, position.y + (size.y - text.getLocalBounds().height) / 2);
-
+    Button(WidgetLayer& layer, const sf::Vector2f& position, const sf::Vector2f& size, const std::string& label) : layer(layer) {
+        // Example color and size
+        id = layer.add(sf::FloatRect(position, size), sf::Color::Blue, label, 20, sf::Color::White);
         isActive = true;
     }
 
-    void draw(sf::RenderWindow& window) {
-        if (isActive) {
-            window.draw(shape);
-            window.draw(text);
-        }
+    // Shown while active and the surrounding controls are visible
+    void setVisible(bool visible) {
+        layer.setVisible(id, isActive && visible);
     }
 };
 
 struct InputBox {
-    sf::RectangleShape shape;
-    sf::Text text;
+    WidgetLayer& layer;
+    WidgetLayer::WidgetId id;
+    std::string value;
     bool isActive;
     sf::Clock inputClock; // Clock to track time since last input
     std::function<void(const std::string&)> onSubmit; // Callback for submission
+    std::function<void(const std::string&)> onChange; // Called after every edit, e.g. to set suggestions
+    std::function<void(std::size_t)> onChoose;        // A suggestion was picked, by its index
 
-    InputBox(const sf::Vector2f& position, const sf::Vector2f& size, const sf::Font& font, std::function<void(const std::string&)> onSubmitCallback = nullptr) :
-        onSubmit(onSubmitCallback) {
-        shape.setPosition(position);
-        shape.setSize(size);
-        shape.setFillColor(sf::Color::White);
+    // Rows under the box, created on first use; Up/Down moves the highlight
+    // and Return or a click picks one instead of submitting the text
+    static const std::size_t MaxSuggestions = 8;
+    std::vector<WidgetLayer::WidgetId> suggestionRows;
+    std::size_t suggestionCount;
+    std::size_t highlighted;
 
-        text.setFont(font);
-        text.setCharacterSize(20);
-        text.setFillColor(sf::Color::Black);
-        text.setPosition(position.x + 5, position.y + 5); // Small padding
+    InputBox(WidgetLayer& layer, const sf::Vector2f& position, const sf::Vector2f& size, std::function<void(const std::string&)> onSubmitCallback = nullptr) :
+        layer(layer), onSubmit(onSubmitCallback), suggestionCount(0), highlighted(0) {
+        id = layer.add(sf::FloatRect(position, size), sf::Color::White, "", 20, sf::Color::Black, WidgetLayer::Align::TopLeft);
+        layer.setLabelOffset(id, sf::Vector2f(5, 5)); // Small padding
 
         isActive = false;
+        layer.setVisible(id, false);
     }
 
-    void draw(sf::RenderWindow& window) {
-        if (isActive) {
-            window.draw(shape);
-            window.draw(text);
+    void setVisible(bool visible) {
+        layer.setVisible(id, isActive && visible);
+        for (std::size_t i = 0; i < suggestionRows.size(); ++i) {
+            layer.setVisible(suggestionRows[i], isActive && visible && i < suggestionCount);
+        }
+    }
+
+    void setSuggestions(const std::vector<std::string>& labels) {
+        suggestionCount = labels.size() < MaxSuggestions ? labels.size() : MaxSuggestions;
+        highlighted = 0;
+
+        const sf::FloatRect& box = layer.getBounds(id);
+        while (suggestionRows.size() < suggestionCount) {
+            sf::FloatRect row(box.left, box.top + box.height + suggestionRows.size() * 30, box.width, 30);
+            WidgetLayer::WidgetId rowId = layer.add(row, sf::Color(230, 230, 230), "", 15, sf::Color::Black, WidgetLayer::Align::TopLeft);
+            layer.setLabelOffset(rowId, sf::Vector2f(5, 6));
+            suggestionRows.push_back(rowId);
+        }
+
+        for (std::size_t i = 0; i < suggestionRows.size(); ++i) {
+            layer.setVisible(suggestionRows[i], isActive && i < suggestionCount);
+            if (i < suggestionCount) layer.setLabel(suggestionRows[i], labels[i]);
+        }
+        highlight(0);
+    }
+
+    // Returns true if the click picked a suggestion
+    bool handleClick(WidgetLayer::WidgetId hit) {
+        for (std::size_t i = 0; i < suggestionCount; ++i) {
+            if (hit == suggestionRows[i] && isActive) {
+                choose(i);
+                return true;
+            }
         }
+        return false;
     }
 
     void handleInput(sf::Event event) {
         if (isActive) {
             if (event.type == sf::Event::TextEntered && inputClock.getElapsedTime().asMilliseconds() > 100) {
-                if (event.text.unicode == '\b' && !text.getString().isEmpty()) { // Handle backspace
-                    std::string currentText = text.getString();
-                    currentText.pop_back();
-                    text.setString(currentText);
+                if (event.text.unicode == '\b') { // Handle backspace
+                    if (!value.empty()) value.pop_back();
+                } else if (event.text.unicode < 32) {
+                    return; // Control keys, Return is handled as a key press
                 } else if (event.text.unicode < 128) { // Ignore non-ASCII characters
-                    text.setString(text.getString() + static_cast<char>(event.text.unicode));
+                    value += static_cast<char>(event.text.unicode);
                 }
+                layer.setLabel(id, value);
                 inputClock.restart(); // Restart the clock after handling input
+                if (onChange) onChange(value);
+            }
+            if (event.type == sf::Event::KeyPressed && suggestionCount > 0) {
+                if (event.key.code == sf::Keyboard::Down) highlight((highlighted + 1) % suggestionCount);
+                if (event.key.code == sf::Keyboard::Up) highlight((highlighted + suggestionCount - 1) % suggestionCount);
             }
             if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Return) {
-                if (onSubmit) {
-                    onSubmit(text.getString()); // Call the submission callback
+                if (suggestionCount > 0 && onChoose) {
+                    choose(highlighted);
+                } else if (onSubmit) {
+                    onSubmit(value); // Call the submission callback
                     isActive = false; // Optionally deactivate
                 }
             }
         }
     }
+
+private:
+    void highlight(std::size_t index) {
+        highlighted = index;
+        for (std::size_t i = 0; i < suggestionCount; ++i) {
+            layer.setFill(suggestionRows[i], i == highlighted ? sf::Color(255, 230, 120) : sf::Color(230, 230, 230));
+        }
+    }
+
+    void choose(std::size_t index) {
+        if (onChoose) onChoose(index);
+        isActive = false;
+        value.clear();
+        layer.setLabel(id, value);
+        setSuggestions(std::vector<std::string>());
+        setVisible(false);
+    }
 };
 
 template<typename CharType, typename StringType = std::basic_string<CharType>>
 class TextWrapper {
 public:
+    // Words are measured once from cached glyph metrics and lines grow word by word, so
+    // a paragraph costs one pass. Input is decoded as UTF-8/16/32 by the width of CharType.
+    // Results are remembered per (font, size, style, width, text).
     static StringType wrapText(const StringType& text, unsigned width, const sf::Font& font, unsigned characterSize, bool bold = false) {
-        unsigned currentLineLength = 0;
-        StringType wordsBuffer;
-        StringType wrappedText;
-        std::basic_istringstream<CharType> words(text);
-        StringType word;
-
-        while (words >> word) {
-            // Since sf::Text does not directly support std::wstring or other character types, we need to convert
-            // the StringType to a string if CharType is not char. This is a limitation of SFML.
-            sf::Text line(StringTypeToString(wordsBuffer + " " + word), font, characterSize);
-            if (bold) {
-                line.setStyle(sf::Text::Bold);
-            }
-            currentLineLength = line.getLocalBounds().width;
-
-            if (currentLineLength > width) {
-                wrappedText += wordsBuffer + "\n";
-                wordsBuffer = word;
-            } else {
-                if (!wordsBuffer.empty()) {
-                    wordsBuffer += " ";
-                }
-                wordsBuffer += word;
-            }
+        GlyphMetrics& metrics = GlyphMetrics::get(font, characterSize, bold);
+        WrapKey key{&metrics, width, text};
+
+        Memo& memo = memoized();
+        auto found = memo.find(key);
+        if (found != memo.end()) {
+            return found->second;
         }
 
-        return wrappedText + wordsBuffer;
+        StringType wrappedText = wrap(text, static_cast<float>(width), metrics);
+        if (memo.size() >= MaxMemoized) {
+            memo.clear();
+        }
+        memo.emplace(std::move(key), wrappedText);
+        return wrappedText;
     }
 
-    // Assuming you want to keep the StringTypeToString function simple and avoid template specialization for now:
     private:
-        static std::string StringTypeToString(const StringType& text) {
-            // Directly convert assuming StringType can be iterated over and contains char-like elements
-            return std::string(text.begin(), text.end());
+        static const std::size_t MaxMemoized = 4096;
+
+        typedef sf::Utf<sizeof(CharType) == 1 ? 8 : sizeof(CharType) == 2 ? 16 : 32> Utf;
+
+        struct WrapKey {
+            const GlyphMetrics* metrics;
+            unsigned width;
+            StringType text;
+
+            bool operator==(const WrapKey& other) const {
+                return metrics == other.metrics && width == other.width && text == other.text;
+            }
+        };
+
+        struct WrapKeyHash {
+            std::size_t operator()(const WrapKey& key) const {
+                std::size_t hash = std::hash<StringType>()(key.text);
+                hash ^= std::hash<const void*>()(key.metrics) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+                hash ^= std::hash<unsigned>()(key.width) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+                return hash;
+            }
+        };
+
+        typedef std::unordered_map<WrapKey, StringType, WrapKeyHash> Memo;
+
+        static Memo& memoized() {
+            static Memo memo;
+            return memo;
+        }
+
+        // Same separators as reading words with operator>>
+        static bool isSpace(CharType c) {
+            return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+        }
+
+        static StringType wrap(const StringType& text, float width, GlyphMetrics& metrics) {
+            StringType wrappedText;
+            wrappedText.reserve(text.size());
+
+            float lineWidth = 0.0f;
+            sf::Uint32 lineLast = 0; // last code point on the current line, 0 while it is empty
+            auto it = text.begin();
+            auto end = text.end();
+
+            while (true) {
+                while (it != end && isSpace(*it)) ++it;
+                if (it == end) break;
+
+                auto wordBegin = it;
+                float wordWidth = 0.0f;
+                sf::Uint32 first = 0;
+                sf::Uint32 previous = 0;
+                while (it != end && !isSpace(*it)) {
+                    sf::Uint32 codePoint = 0;
+                    it = Utf::decode(it, end, codePoint);
+                    if (first == 0) first = codePoint;
+                    wordWidth += metrics.kerning(previous, codePoint) + metrics.advance(codePoint);
+                    previous = codePoint;
+                }
+
+                if (lineLast == 0) {
+                    lineWidth = wordWidth;
+                } else {
+                    float joined = lineWidth + metrics.kerning(lineLast, ' ') + metrics.spaceAdvance() + metrics.kerning(' ', first) + wordWidth;
+                    if (joined > width) {
+                        wrappedText += static_cast<CharType>('\n');
+                        lineWidth = wordWidth;
+                    } else {
+                        wrappedText += static_cast<CharType>(' ');
+                        lineWidth = joined;
+                    }
+                }
+                wrappedText.append(wordBegin, it);
+                lineLast = previous;
+            }
+
+            return wrappedText;
         }
     };
 
-void loadImagesFromTextFilesRecursively(int fileIndex, std::vector<std::vector<std::unique_ptr<sf::Texture>>>& textures, std::vector<std::vector<sf::Sprite>>& images, sf::RenderWindow& window);
-void reloadImages(int fileIndex, std::vector<std::vector<std::unique_ptr<sf::Texture>>>& textures, std::vector<std::vector<sf::Sprite>>& images, sf::RenderWindow& window);
+void loadImagesFromTextFilesRecursively(int fileIndex, TextureCache& cache, std::vector<std::vector<ImageHandle>>& images);
+void loadImagesFromCatalog(const Catalog& catalog, TextureCache& cache, std::vector<std::vector<ImageHandle>>& images);
+void reloadImages(TextureCache& cache, std::vector<std::vector<ImageHandle>>& images);
+void reloadTopic(int fileIndex, TextureCache& cache, std::vector<std::vector<ImageHandle>>& images);
+void reloadTopic(const Catalog& catalog, int fileIndex, TextureCache& cache, std::vector<std::vector<ImageHandle>>& images);
+void applyTopicList(int fileIndex, const std::vector<std::string>& names, TextureCache& cache, std::vector<std::vector<ImageHandle>>& images);
+sf::Sprite makeSlideSprite(const sf::Texture& texture, const sf::Vector2u& sourceSize, const sf::Vector2u& windowSize);
+sf::Vector2u slideAreaPixels(const sf::RenderWindow& window);
+bool openCatalog(Catalog& catalog, const std::string& path, const TopicRegistry& topics);
+void exportCatalog(const Catalog& catalog);
+bool importTopicList(int topic, const std::string& listPath);
 bool checkImageExists(const std::string& imageName);
-void addImageNameToTopic(int fileIndex, const std::string& imageName);
-void deleteImageNameFromTopic(int fileIndex, const std::string& imageName);
+void addImageNameToTopic(Catalog& catalog, int fileIndex, const std::string& imageName);
+void deleteImageNameFromTopic(Catalog& catalog, int fileIndex, const std::string& imageName);
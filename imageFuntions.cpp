@@ -1,7 +1,13 @@
 #include "ImageFunctions.hpp"
+#include "catalogWriter.hpp"
+#include "logger.hpp"
+#include "resample.hpp"
+#include "threadPool.hpp"
+#include "topicRegistry.hpp"
 #include <fstream>
-#include <iostream>
 #include <memory>
+#include <sys/stat.h>
+#include <unordered_set>
 
 // operator overloading
 
@@ -21,165 +27,246 @@ std::ostream& operator<<(std::ostream& os, const RecursiveCallState& state) {
     return os;
 }
 
-void loadImagesFromTextFilesRecursively(int fileIndex, std::vector<std::vector<std::unique_ptr<sf::Texture>>>& textures, std::vector<std::vector<sf::Sprite>>& images, sf::RenderWindow& window) {
+void loadImagesFromTextFilesRecursively(int fileIndex, TextureCache& cache, std::vector<std::vector<ImageHandle>>& images) {
     try {
-        RecursiveCallState state(fileIndex, textures.size(), images.size());
-        std::cout << state << std::endl;
+        RecursiveCallState state(fileIndex, cache.residentCount(), images.size());
+        LOG_DEBUG(state);
 
-        if (fileIndex >= 12) return;
+        if (fileIndex >= static_cast<int>(images.size())) return;
 
-        std::cout << "Loading images from: texts/text" + std::to_string(fileIndex) + ".txt" << std::endl; 
+        LOG_DEBUG("Loading images from: " << TopicRegistry::listPath(fileIndex)); 
 
-        textures.resize(12);
-        images.resize(12);
-
-        std::ifstream file("texts/text" + std::to_string(fileIndex) + ".txt");
+        std::ifstream file(TopicRegistry::listPath(fileIndex));
         if (!file) {
-            throw std::runtime_error("Failed to open file: texts/text" + std::to_string(fileIndex) + ".txt");
+            throw std::runtime_error("Failed to open file: " + TopicRegistry::listPath(fileIndex));
         }
 
+        // Only the names are read here, textures are decoded when first displayed
         std::string imageName;
         while (std::getline(file, imageName)) {
-            auto texture = std::make_unique<sf::Texture>();
-            if (!texture->loadFromFile("images/" + imageName)) {
-                std::cerr << "Could not load image: " << imageName << std::endl;
-                continue;
-            }
-
-            std::cout << "Loading texture at address: " << texture.get() << std::endl;
-
-            textures[fileIndex].push_back(std::move(texture));
-
-            sf::Sprite sprite(*textures[fileIndex].back());
-            sprite.setOrigin(sprite.getLocalBounds().width / 2, sprite.getLocalBounds().height / 2);
-            sprite.setPosition((window.getSize().x / 2) + 100, window.getSize().y / 2);
-            sprite.setScale(1.00f, 1.00f);
-            images[fileIndex].push_back(sprite);
+            if (imageName.empty()) continue;
+            images[fileIndex].push_back(cache.acquire(imageName));
         }
     } catch (const std::exception& e) {
-        std::cerr << "Exception caught: " << e.what() << std::endl;
+        LOG_ERROR("Exception caught: " << e.what());
     }
 
-    loadImagesFromTextFilesRecursively(fileIndex + 1, textures, images, window);
+    loadImagesFromTextFilesRecursively(fileIndex + 1, cache, images);
 }
 
 
-// Function to reload images and textures
-void reloadImages(int fileIndex, std::vector<std::vector<std::unique_ptr<sf::Texture>>>& textures,
-                  std::vector<std::vector<sf::Sprite>>& images, sf::RenderWindow& window) {
-    textures.clear();
-    images.clear();
-    textures.resize(12);
-    images.resize(12);
-
-    for (int i = 0; i < 12; ++i) {
-        std::ifstream file("texts/text" + std::to_string(i) + ".txt");
-        if (!file) {
-            std::cerr << "Failed to open file: texts/text" + std::to_string(i) + ".txt" << std::endl;
-            continue;
-        }
+// Applies a topic's new name list to its handles: new images are queued for
+// decoding, removed ones are released and everything else keeps its texture.
+// Handles are compared rather than names, since names with the same content
+// share one entry. The catalog, if given, supplies those content hashes.
+static void applyTopicNames(int fileIndex, const std::vector<std::string>& names, TextureCache& cache, std::vector<std::vector<ImageHandle>>& images, const Catalog* catalog = nullptr) {
+    std::vector<ImageHandle>& oldHandles = images[fileIndex];
+    std::unordered_set<size_t> oldIds;
+    for (const auto& handle : oldHandles) {
+        oldIds.insert(handle.id);
+    }
 
-        std::string imageName;
-        while (std::getline(file, imageName)) {
-            auto texture = std::make_unique<sf::Texture>();
-            if (!texture->loadFromFile("images/" + imageName)) {
-                std::cerr << "Could not load image: " << imageName << std::endl;
-                continue;
-            }
-
-            textures[i].push_back(std::move(texture));
-            sf::Sprite sprite(*textures[i].back());
-            sprite.setOrigin(sprite.getLocalBounds().width / 2, sprite.getLocalBounds().height / 2);
-            sprite.setPosition((window.getSize().x / 2) + 100, window.getSize().y / 2);
-            sprite.setScale(1.00f, 1.00f);
-            images[i].push_back(sprite);
+    // Acquire the new list before releasing the old one so shared images never drop to zero references
+    std::vector<ImageHandle> newHandles;
+    std::unordered_set<size_t> newIds;
+    size_t added = 0;
+    for (const auto& imageName : names) {
+        const CatalogEntry* entry = catalog ? catalog->find(fileIndex, imageName) : nullptr;
+        newHandles.push_back(cache.acquire(imageName, entry ? currentContentHash(*entry) : 0));
+        bool first = newIds.insert(newHandles.back().id).second;
+        if (first && oldIds.find(newHandles.back().id) == oldIds.end()) {
+            cache.request(newHandles.back());
+            added++;
         }
     }
-}
 
-bool checkImageExists(const std::string& imageName) {
-    std::ifstream imgFile("images/" + imageName);
-    bool exists = imgFile.good();
-    imgFile.close();
-    return exists;
-}
+    size_t removed = 0;
+    for (size_t id : oldIds) {
+        if (newIds.find(id) == newIds.end()) removed++;
+    }
 
-void addImageNameToTopic(int fileIndex, const std::string& imageName) {
-    if (!checkImageExists(imageName)) {
-        std::cerr << "Image does not exist, not adding to file: " << imageName << std::endl;
-        return;
+    for (const auto& handle : oldHandles) {
+        cache.release(handle);
     }
+    oldHandles.swap(newHandles);
 
-    std::string filePath = "texts/text" + std::to_string(fileIndex) + ".txt";
-    std::ifstream file(filePath);
+    LOG_INFO("Reloaded topic " << fileIndex << ": " << added << " added, " << removed << " removed");
+}
+
+// Re-reads one topic file and applies only the difference to the cache
+void reloadTopic(int fileIndex, TextureCache& cache, std::vector<std::vector<ImageHandle>>& images) {
+    if (fileIndex < 0 || fileIndex >= static_cast<int>(images.size())) return;
+
+    std::ifstream file(TopicRegistry::listPath(fileIndex));
     if (!file) {
-        std::cerr << "Failed to open file for reading: " << filePath << std::endl;
+        LOG_ERROR("Failed to open file: " << TopicRegistry::listPath(fileIndex));
         return;
     }
 
-    bool exists = false;
-    std::string line;
-    while (std::getline(file, line)) {
-        if (line == imageName) {
-            exists = true;
-            break;
+    std::vector<std::string> names;
+    std::string imageName;
+    while (std::getline(file, imageName)) {
+        if (!imageName.empty()) names.push_back(imageName);
+    }
+    applyTopicNames(fileIndex, names, cache, images);
+}
+
+void reloadTopic(const Catalog& catalog, int fileIndex, TextureCache& cache, std::vector<std::vector<ImageHandle>>& images) {
+    if (fileIndex < 0 || fileIndex >= static_cast<int>(images.size())) return;
+    applyTopicNames(fileIndex, catalog.names(fileIndex), cache, images, &catalog);
+}
+
+// Applies a list that was already read, e.g. off the UI thread
+void applyTopicList(int fileIndex, const std::vector<std::string>& names, TextureCache& cache, std::vector<std::vector<ImageHandle>>& images) {
+    if (fileIndex < 0 || fileIndex >= static_cast<int>(images.size())) return;
+    applyTopicNames(fileIndex, names, cache, images);
+}
+
+void loadImagesFromCatalog(const Catalog& catalog, TextureCache& cache, std::vector<std::vector<ImageHandle>>& images) {
+    for (size_t i = 0; i < images.size(); ++i) {
+        for (const auto& imageName : catalog.names(static_cast<int>(i))) {
+            const CatalogEntry* entry = catalog.find(static_cast<int>(i), imageName);
+            images[i].push_back(cache.acquire(imageName, entry ? currentContentHash(*entry) : 0));
         }
     }
-    file.close();
+    if (cache.sharedCount() > 0) {
+        LOG_INFO(cache.sharedCount() << " images share a texture with an identical image");
+    }
+}
 
-    if (exists) {
-        std::cout << "Image name '" << imageName << "' already exists in file: " << filePath << std::endl;
-        return;
+// Function to reload images and textures
+void reloadImages(TextureCache& cache, std::vector<std::vector<ImageHandle>>& images) {
+    for (size_t i = 0; i < images.size(); ++i) {
+        reloadTopic(static_cast<int>(i), cache, images);
     }
+}
 
-    std::ofstream outFile(filePath, std::ios::app);
-    if (!outFile) {
-        std::cerr << "Failed to open file for appending: " << filePath << std::endl;
-        return;
+// Slides are centred in the area right of the 200px sidebar and shrunk to fit it.
+// The texture may already be downscaled, sourceSize is the image's original size.
+// A window too narrow to leave any area gets a sprite without texture, which draws nothing.
+sf::Sprite makeSlideSprite(const sf::Texture& texture, const sf::Vector2u& sourceSize, const sf::Vector2u& windowSize) {
+    sf::Vector2u area(windowSize.x > 200 ? windowSize.x - 200 : 0, windowSize.y);
+    if (area.x == 0 || area.y == 0) return sf::Sprite();
+
+    sf::Sprite sprite(texture);
+    sprite.setOrigin(sprite.getLocalBounds().width / 2, sprite.getLocalBounds().height / 2);
+    sprite.setPosition((windowSize.x / 2) + 100, windowSize.y / 2);
+
+    sf::Vector2u textureSize = texture.getSize();
+    sf::Vector2u shown = fitSize(sourceSize.x > 0 ? sourceSize : textureSize, area);
+    if (textureSize.x > 0 && textureSize.y > 0) {
+        sprite.setScale(static_cast<float>(shown.x) / textureSize.x, static_cast<float>(shown.y) / textureSize.y);
     }
+    return sprite;
+}
 
-    outFile << imageName << std::endl;
-    if (outFile.fail()) {
-        std::cerr << "Failed to write image name to file: " << filePath << std::endl;
-    } else {
-        std::cout << "Debug: Added image name '" << imageName << "' to file: " << filePath << std::endl;
+// Size in screen pixels of the slide area, which differs from the view once the window is resized
+sf::Vector2u slideAreaPixels(const sf::RenderWindow& window) {
+    sf::Vector2f view = window.getView().getSize();
+    sf::Vector2u pixels = window.getSize();
+    if (view.x <= 200 || view.y <= 0) return sf::Vector2u(0, 0);
+    return sf::Vector2u(static_cast<unsigned>((view.x - 200) * pixels.x / view.x),
+                        static_cast<unsigned>(view.y * pixels.y / view.y));
+}
+
+bool checkImageExists(const std::string& imageName) {
+    struct stat info;
+    return stat(("images/" + imageName).c_str(), &info) == 0;
+}
+
+static time_t modificationTime(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 ? info.st_mtime : 0;
+}
+
+// Opens the catalog and imports any texts/textN.txt list edited since the catalog was last written
+bool openCatalog(Catalog& catalog, const std::string& path, const TopicRegistry& topics) {
+    time_t catalogTime = modificationTime(path);
+    if (!catalog.open(path)) return false;
+
+    for (int i = 0; i < static_cast<int>(topics.size()); ++i) {
+        time_t listTime = modificationTime(TopicRegistry::listPath(i));
+        if (listTime == 0) continue;
+        if (catalogTime == 0 || listTime > catalogTime) {
+            LOG_INFO("Importing " << TopicRegistry::listPath(i) << " into " << path);
+            catalog.importTextList(i, TopicRegistry::listPath(i));
+        }
     }
+    return true;
 }
 
-void deleteImageNameFromTopic(int fileIndex, const std::string& imageName) {
-    std::string filePath = "texts/text" + std::to_string(fileIndex) + ".txt";
-    std::ifstream file(filePath);
-    if (!file) {
-        std::cerr << "Failed to open file for reading: " << filePath << std::endl;
-        return;
+void exportCatalog(const Catalog& catalog) {
+    for (int i = 0; i < catalog.topicCount(); ++i) {
+        catalog.exportTextList(i, TopicRegistry::listPath(i));
     }
+}
 
-    std::vector<std::string> lines;
+// Command line bulk import: makes a topic list exactly the names in listPath
+// in one catalog transaction, hashing the images on every core
+bool importTopicList(int topic, const std::string& listPath) {
+    std::ifstream list(listPath);
+    if (!list) {
+        LOG_ERROR("Failed to open file: " << listPath);
+        return false;
+    }
+    std::vector<std::string> names;
     std::string line;
-    bool found = false;
-    while (std::getline(file, line)) {
-        if (line != imageName) {
-            lines.push_back(line);
-        } else {
-            found = true;
-        }
+    while (std::getline(list, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty()) names.push_back(line);
+    }
+
+    TopicRegistry topics;
+    topics.discover();
+    Catalog catalog;
+    if (!openCatalog(catalog, "texts/catalog.bin", topics)) {
+        LOG_ERROR("Could not open the catalog");
+        return false;
     }
-    file.close();
 
-    if (!found) {
-        std::cout << "Image name '" << imageName << "' not found in file: " << filePath << std::endl;
+    sf::Clock clock;
+    ThreadPool pool;
+    CatalogWriter writer(catalog, pool);
+    writer.replace(topic, names);
+    writer.finish();
+
+    bool exported = catalog.exportTextList(topic, TopicRegistry::listPath(topic));
+    LOG_INFO("Imported " << catalog.names(topic).size() << " images into topic " << topic << " in "
+             << clock.getElapsedTime().asMilliseconds() << " ms");
+    return exported;
+}
+
+void addImageNameToTopic(Catalog& catalog, int fileIndex, const std::string& imageName) {
+    CatalogEntry entry;
+    entry.name = imageName;
+    entry.topic = fileIndex;
+    if (!readImageMetadata(imageName, entry)) {
+        LOG_WARNING("Image does not exist, not adding to catalog: " << imageName);
         return;
     }
 
-    std::ofstream outFile(filePath, std::ios::trunc);
-    if (!outFile) {
-        std::cerr << "Failed to open file for writing: " << filePath << std::endl;
+    if (catalog.contains(fileIndex, imageName)) {
+        LOG_INFO("Image name '" << imageName << "' already exists in topic " << fileIndex);
         return;
     }
 
-    for (const auto& l : lines) {
-        outFile << l << std::endl;
+    if (!catalog.add(entry)) {
+        LOG_ERROR("Failed to add image name to catalog: " << catalog.path());
+    } else {
+        LOG_DEBUG("Added image name '" << imageName << "' to topic " << fileIndex);
     }
+}
 
-    std::cout << "Image name '" << imageName << "' has been deleted from file: " << filePath << std::endl;
-}
\ No newline at end of file
+void deleteImageNameFromTopic(Catalog& catalog, int fileIndex, const std::string& imageName) {
+    if (!catalog.contains(fileIndex, imageName)) {
+        LOG_INFO("Image name '" << imageName << "' not found in topic " << fileIndex);
+        return;
+    }
+
+    if (!catalog.remove(fileIndex, imageName)) {
+        LOG_ERROR("Failed to delete image name from catalog: " << catalog.path());
+        return;
+    }
+
+    LOG_INFO("Image name '" << imageName << "' has been deleted from topic " << fileIndex);
+}
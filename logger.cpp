@@ -0,0 +1,110 @@
+#include "logger.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+const std::size_t Logger::Capacity;
+const std::size_t Logger::MaxMessage;
+
+static_assert((Logger::Capacity & (Logger::Capacity - 1)) == 0, "log capacity must be a power of two");
+
+Logger& Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger()
+    : records(new Record[Capacity]), head(0), tail(0), threshold(0), dropped(0), written(0), flushing(false), stopping(false) {
+    for (std::size_t i = 0; i < Capacity; ++i) {
+        records[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    thread = std::thread(&Logger::run, this);
+}
+
+Logger::~Logger() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    if (thread.joinable()) thread.join();
+}
+
+// Bounded multi-producer queue: a producer claims a position with one CAS, fills
+// the slot and publishes it through the slot's sequence number
+void Logger::write(LogLevel level, const std::string& message) {
+    std::size_t position = head.load(std::memory_order_relaxed);
+    Record* record;
+    for (;;) {
+        record = &records[position & (Capacity - 1)];
+        std::size_t sequence = record->sequence.load(std::memory_order_acquire);
+        if (sequence == position) {
+            if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+        } else if (sequence < position) {
+            dropped.fetch_add(1, std::memory_order_relaxed); // full, the drain thread is behind
+            return;
+        } else {
+            position = head.load(std::memory_order_relaxed);
+        }
+    }
+
+    record->level = level;
+    record->length = std::min(message.size(), MaxMessage);
+    std::memcpy(record->text, message.data(), record->length);
+    record->sequence.store(position + 1, std::memory_order_release);
+
+    // Wake the drain thread early in a burst instead of waiting out its poll
+    if ((position & (Capacity / 4 - 1)) == 0) wake.notify_one();
+}
+
+void Logger::flush() {
+    std::size_t target = head.load(std::memory_order_acquire);
+    std::unique_lock<std::mutex> lock(mutex);
+    flushing = true;
+    wake.notify_one();
+    drained.wait(lock, [this, target] { return written >= target || stopping; });
+    flushing = false;
+}
+
+void Logger::run() {
+    for (;;) {
+        bool any = drain();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if (stopping && !any) break;
+        drained.notify_all();
+        // Writers only signal every quarter ring, so poll as well
+        if (!any && !flushing) wake.wait_for(lock, std::chrono::milliseconds(10));
+    }
+    drained.notify_all();
+
+    if (dropped > 0) std::cerr << dropped << " log records dropped, the log could not keep up" << std::endl;
+}
+
+// Writes every published record, batching the lines per stream
+bool Logger::drain() {
+    std::string out;
+    std::string err;
+    std::size_t count = 0;
+
+    for (;;) {
+        Record& record = records[tail & (Capacity - 1)];
+        if (record.sequence.load(std::memory_order_acquire) != tail + 1) break;
+
+        std::string& target = record.level >= LogLevel::Warning ? err : out;
+        target.append(record.text, record.length);
+        target += '\n';
+
+        record.sequence.store(tail + Capacity, std::memory_order_release);
+        ++tail;
+        ++count;
+    }
+
+    if (!out.empty()) std::cout << out << std::flush;
+    if (!err.empty()) std::cerr << err << std::flush;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    written = tail;
+    return count > 0;
+}
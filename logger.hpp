@@ -0,0 +1,90 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+enum class LogLevel { Debug, Info, Warning, Error, Off };
+
+// Statements below this level are compiled out, formatting included.
+// Release builds (NDEBUG) drop Debug; define it as 0-4 to override.
+#ifndef CODEQUEST_LOG_LEVEL
+#ifdef NDEBUG
+#define CODEQUEST_LOG_LEVEL 1
+#else
+#define CODEQUEST_LOG_LEVEL 0
+#endif
+#endif
+
+// Leveled log shared by the app and its tools. Any thread formats a record and
+// pushes it into a bounded lock-free ring; a background thread drains the ring
+// to stdout (Debug, Info) or stderr (Warning, Error) with one flush per batch.
+// Nobody waits on the console and lines never interleave. A full ring drops
+// records and counts them instead of blocking the caller.
+class Logger {
+public:
+    static const std::size_t Capacity = 4096;  // records, a power of two
+    static const std::size_t MaxMessage = 240; // longer messages are cut
+
+    static Logger& instance();
+
+    // Runtime threshold on top of CODEQUEST_LOG_LEVEL
+    void setLevel(LogLevel level) { threshold = static_cast<int>(level); }
+    LogLevel level() const { return static_cast<LogLevel>(threshold.load()); }
+    bool accepts(LogLevel level) const { return static_cast<int>(level) >= threshold.load(std::memory_order_relaxed); }
+
+    void write(LogLevel level, const std::string& message);
+
+    // Blocks until everything logged so far is written out
+    void flush();
+    std::size_t droppedCount() const { return dropped; }
+
+private:
+    struct Record {
+        std::atomic<std::size_t> sequence; // ring position this slot is ready for
+        LogLevel level;
+        std::size_t length;
+        char text[MaxMessage];
+    };
+
+    Logger();
+    ~Logger();
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    void run();
+    bool drain();
+
+    std::unique_ptr<Record[]> records;
+    std::atomic<std::size_t> head;  // next position producers claim
+    std::size_t tail;               // next position the drain thread reads
+    std::atomic<int> threshold;
+    std::atomic<std::size_t> dropped;
+
+    std::mutex mutex; // for flush and shutdown, never taken by write
+    std::condition_variable wake;
+    std::condition_variable drained;
+    std::size_t written;
+    bool flushing;
+    bool stopping;
+    std::thread thread;
+};
+
+#define CODEQUEST_LOG(level, message)                                                        \
+    do {                                                                                     \
+        if (static_cast<int>(level) >= CODEQUEST_LOG_LEVEL && Logger::instance().accepts(level)) { \
+            std::ostringstream logStream;                                                    \
+            logStream << message;                                                            \
+            Logger::instance().write(level, logStream.str());                               \
+        }                                                                                    \
+    } while (false)
+
+// Stream syntax: LOG_INFO("Loaded " << count << " images");
+#define LOG_DEBUG(message) CODEQUEST_LOG(LogLevel::Debug, message)
+#define LOG_INFO(message) CODEQUEST_LOG(LogLevel::Info, message)
+#define LOG_WARNING(message) CODEQUEST_LOG(LogLevel::Warning, message)
+#define LOG_ERROR(message) CODEQUEST_LOG(LogLevel::Error, message)
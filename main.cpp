@@ -1,16 +1,107 @@
 #include <SFML/Graphics.hpp>
 #include <SFML/Window.hpp>
 #include <SFML/System.hpp>
-#include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
 #include <fstream>
+#include <iostream>
 #include <sstream>
 #include <memory>
 #include <vector>
 #include <string>
 #include <functional>
+#include <unordered_map>
 #include "ImageFunctions.hpp"
+#include "assetArchive.hpp"
+#include "prefetcher.hpp"
+#include "presenterView.hpp"
+#include "threadPool.hpp"
+#include "hotReload.hpp"
+#include "catalogWriter.hpp"
+#include "searchIndex.hpp"
+#include "sessionSnapshot.hpp"
+#include "slideTransition.hpp"
+#include "thumbnailAtlas.hpp"
+#include "tiledSlide.hpp"
+#include "topicRegistry.hpp"
+#include "profiler.hpp"
+#include "resample.hpp"
+#include "logger.hpp"
+
+namespace {
+
+void printUsage() {
+    std::cerr << "usage: cpppit [--continuous] [--fps N] [--profile] [--trace FILE] [--import TOPIC FILE] [--fresh] [--presenter]" << std::endl;
+}
+
+// Whole decimal numbers up to max only, std::stoi accepts "3x" and throws on "x"
+bool parseNumber(const char* text, unsigned long max, unsigned long& value) {
+    char* end = nullptr;
+    errno = 0;
+    value = std::strtoul(text, &end, 10);
+    return end != text && *end == '\0' && errno == 0 && text[0] != '-' && value <= max;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    // --continuous redraws every frame like before, --fps N caps the frame rate (0 = uncapped),
+    // --profile records timing zones and writes them as a Chrome trace on exit (or to --trace FILE),
+    // --import TOPIC FILE replaces a topic's slides with the names listed in FILE and exits,
+    // --fresh ignores the saved session and starts from the intro,
+    // --presenter opens the presenter window next to the slides (F5 toggles it)
+    bool eventDriven = true;
+    unsigned frameCap = 60;
+    bool profiling = false;
+    std::string traceOutput = "profile.json";
+    int importTopic = -1;
+    std::string importList;
+    bool fresh = false;
+    bool presenting = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--continuous") {
+            eventDriven = false;
+        } else if (arg == "--fps" && i + 1 < argc) {
+            unsigned long fps = 0;
+            if (!parseNumber(argv[++i], 1000, fps)) {
+                std::cerr << "--fps needs a frame rate from 0 to 1000, got: " << argv[i] << std::endl;
+                printUsage();
+                return 1;
+            }
+            frameCap = static_cast<unsigned>(fps);
+        } else if (arg == "--profile") {
+            profiling = true;
+        } else if (arg == "--trace" && i + 1 < argc) {
+            profiling = true;
+            traceOutput = argv[++i];
+        } else if (arg == "--import" && i + 2 < argc) {
+            unsigned long topic = 0;
+            if (!parseNumber(argv[++i], 0xFFFF, topic)) {
+                std::cerr << "--import needs a topic number, got: " << argv[i] << std::endl;
+                printUsage();
+                return 1;
+            }
+            importTopic = static_cast<int>(topic);
+            importList = argv[++i];
+        } else if (arg == "--fresh") {
+            fresh = true;
+        } else if (arg == "--presenter") {
+            presenting = true;
+        }
+    }
+
+    if (importTopic >= 0) {
+        return importTopicList(importTopic, importList) ? 0 : 1;
+    }
+
+    sf::Clock launchClock;
+    Profiler& profiler = Profiler::instance();
+    profiler.setEnabled(profiling);
+    profiler.setThreadName("main");
 
-int main() {
     sf::RenderWindow window(sf::VideoMode(1280, 720), "CodeQuest");
 
     sf::Image icon;
@@ -18,6 +109,29 @@ int main() {
         window.setIcon(icon.getSize().x, icon.getSize().y, icon.getPixelsPtr());
     }
 
+    ThreadPool decodePool;
+    TextureCache textureCache(TextureCache::DefaultByteBudget, &decodePool);
+    textureCache.setMaxTextureSize(sf::Texture::getMaximumSize());
+    textureCache.setDisplaySize(slideAreaPixels(window));
+
+    // A restart opens on the slide it was closed on: its pixels come straight from
+    // the session file, drawn before topics, catalog and fonts are even looked at
+    const std::string sessionPath = "session.bin";
+    SessionSnapshot session;
+    bool restored = !fresh && session.open(sessionPath);
+    ImageHandle firstSlide;
+    if (restored) {
+        if (const SessionImage* saved = session.find(session.state().imageName)) {
+            firstSlide = textureCache.acquire(saved->imageName);
+            if (textureCache.adopt(firstSlide, saved->pixels, saved->size, saved->sourceSize)) {
+                window.clear();
+                window.draw(makeSlideSprite(*textureCache.get(firstSlide), textureCache.sourceSize(firstSlide), sf::Vector2u(window.getView().getSize())));
+                window.display();
+                LOG_INFO("First slide shown " << launchClock.getElapsedTime().asMilliseconds() << " ms after launch");
+            }
+        }
+    }
+
     sf::Color defaultButtonColor = sf::Color::White;
     sf::Color activeButtonColor = sf::Color::Yellow;
     sf::Color inactiveButtonColor = sf::Color(128, 128, 128);
@@ -34,38 +148,97 @@ int main() {
 
     sf::Font font;
     if (!font.loadFromFile("fonts/Montserrat Light.otf")) {
-        std::cerr << "Could not load font" << std::endl;
+        LOG_ERROR("Could not load font");
         return -1;
     }
 
 
-    std::vector<std::vector<std::unique_ptr<sf::Texture>>> textures(12);
-    std::vector<std::vector<sf::Sprite>> images(12);
+    // Topics come from the text lists, texts/topics.txt and the catalog, however many there are
+    TopicRegistry topics;
+    topics.discover();
+
+    Catalog catalog;
+    bool catalogEdited = false;
+    bool hasCatalog = openCatalog(catalog, "texts/catalog.bin", topics);
+    if (hasCatalog) {
+        topics.include(catalog);
+    }
+
+    // Pre-decoded pixels written by the packer tool, PNGs are the fallback
+    AssetArchive assetArchive;
+    assetArchive.open("images/assets.pak");
+
+    if (assetArchive.isOpen()) {
+        textureCache.setArchive(&assetArchive);
+    }
+    std::vector<std::vector<ImageHandle>> images(std::max<size_t>(topics.size(), 1));
+
+    // Edits from the input boxes are hashed on the pool and committed between frames
+    CatalogWriter catalogWriter(catalog, decodePool);
+
+    // The sidebar shows this many topics at a time and scrolls through the rest
+    const size_t sidebarRows = 5;
 
-    Button myButton(sf::Vector2f(700, 645), sf::Vector2f(375, 50), "add image (e.g. image.png)", font);
-    InputBox myInputBox({715, 575}, {350, 50}, font, [&](const std::string& inputText) {
-        addImageNameToTopic(0, inputText);
-        reloadImages(0, textures, images, window); 
-        std::cout << "Submitted: " << inputText << std::endl;
+    // Every control lives in one retained layer: a draw call per batch and one hit test per click
+    WidgetLayer widgets(font);
+
+    Button myButton(widgets, sf::Vector2f(700, 645), sf::Vector2f(375, 50), "add image (e.g. image.png)");
+    InputBox myInputBox(widgets, {715, 575}, {350, 50}, [&](const std::string& inputText) {
+        catalogWriter.add(0, inputText);
+        catalogWriter.submit();
+        LOG_DEBUG("Submitted: " << inputText);
     });
 
-    Button deleteButton(sf::Vector2f(300, 645), sf::Vector2f(375, 50), "delete image (e.g. image.png)", font);
-    InputBox deleteInputBox({315, 575}, {350, 50}, font, [&](const std::string& inputText) {
-        deleteImageNameFromTopic(0, inputText);
-        reloadImages(0, textures, images, window); 
-        std::cout << "Submitted: " << inputText << std::endl;
+    Button deleteButton(widgets, sf::Vector2f(300, 645), sf::Vector2f(375, 50), "delete image (e.g. image.png)");
+    InputBox deleteInputBox(widgets, {315, 575}, {350, 50}, [&](const std::string& inputText) {
+        catalogWriter.remove(0, inputText);
+        catalogWriter.submit();
+        LOG_DEBUG("Submitted: " << inputText);
     });
 
 
+    // Start decoding in the background so the intro is not dead time
+    if (hasCatalog) {
+        loadImagesFromCatalog(catalog, textureCache, images);
+    } else {
+        loadImagesFromTextFilesRecursively(0, textureCache, images);
+    }
+
+    // The other recently viewed slides are resident from the start as well;
+    // the topics hold their own references to the first one now
+    SessionState lastSession = session.state();
+    for (const std::string& name : session.imageNames()) {
+        const SessionImage* saved = session.find(name);
+        if (saved) textureCache.adopt(textureCache.find(name), saved->pixels, saved->size, saved->sourceSize);
+    }
+    textureCache.release(firstSlide);
+    session.close();
+    // Only each topic's first slide, the rest are prefetched around the one shown
+    for (size_t i = 0; i < images.size() && i < sidebarRows; ++i) {
+        if (!images[i].empty()) textureCache.request(images[i][0]);
+    }
+
     sf::Text loadingText("", font, 50);
     loadingText.setPosition(360 - loadingText.getLocalBounds().width / 2, 360 - loadingText.getLocalBounds().height / 2);
 
+    sf::Text loadingProgressText("", font, 20);
+    loadingProgressText.setFillColor(sf::Color(128, 128, 128));
+    loadingProgressText.setPosition(loadingText.getPosition().x, loadingText.getPosition().y + 80);
+
+    bool holdingText = false;
+    sf::Time holdStart = sf::Time::Zero;
+
+    // No intro when picking up where the last session left off
+    if (restored) currentTextIndex = textsSize;
+
     while (window.isOpen() && currentTextIndex < textsSize) { 
         sf::Time elapsedTime = clock.getElapsedTime();
         sf::Event event;
         while (window.pollEvent(event)) {
             if (event.type == sf::Event::Closed)
                 window.close();
+            if (event.type == sf::Event::Resized)
+                textureCache.setDisplaySize(slideAreaPixels(window));
         }
 
         if (elapsedTime - lastUpdate >= sf::seconds(typewriterSpeed) && displayedText.length() < texts[currentTextIndex].length()) {
@@ -74,244 +247,676 @@ int main() {
             lastUpdate = elapsedTime;
         }
 
+        textureCache.uploadPending(sf::milliseconds(8));
+        LoadProgress progress = textureCache.progress();
+        loadingProgressText.setString("Loading " + std::to_string(progress.finished()) + "/" + std::to_string(progress.requested));
+
         window.clear();
         window.draw(loadingText);
+        window.draw(loadingProgressText);
         window.display();
 
         if (displayedText.length() == texts[currentTextIndex].length()) {
-            // Pause for a moment before moving to the next text
-            sf::sleep(sf::seconds(2)); 
-            currentTextIndex++; 
-            displayedText = ""; 
+            // Hold the text for a moment before moving to the next one, without blocking the loading
+            if (!holdingText) {
+                holdingText = true;
+                holdStart = elapsedTime;
+            } else if (elapsedTime - holdStart >= sf::seconds(2)) {
+                holdingText = false;
+                currentTextIndex++; 
+                displayedText = ""; 
+            }
         }
     }
 
-    sf::Text title("CodeQuest", font, 30);
-    title.setPosition(window.getSize().x - title.getLocalBounds().width - 25, 25);
-    title.setStyle(sf::Text::Bold);
+    typedef WidgetLayer::WidgetId WidgetId;
+
+    WidgetId sidebar = widgets.add(sf::FloatRect(0, 0, 200, window.getSize().y), sf::Color(50, 50, 50));
+    widgets.setInteractive(sidebar, false);
 
-    sf::RectangleShape sidebar(sf::Vector2f(200, window.getSize().y));
-    sidebar.setFillColor(sf::Color(50, 50, 50));
+    WidgetId sidebarTitle = widgets.add(sf::FloatRect(25, 10, 150, 50), sf::Color::Transparent, "Lessons", 40,
+                                        sf::Color::White, WidgetLayer::Align::TopLeft);
+    widgets.setInteractive(sidebarTitle, false);
 
-    std::vector<sf::RectangleShape> buttons(5, sf::RectangleShape(sf::Vector2f(180, 70)));
-    for (int i = 0; i < 5; ++i) {
-        buttons[i].setPosition(10, 50 + i * 80 + 30);
-        buttons[i].setFillColor(sf::Color::White);
+    // Only the visible rows exist as widgets, scrolling rebinds them to other topics
+    std::vector<WidgetId> buttons;
+    for (size_t i = 0; i < sidebarRows; ++i) {
+        buttons.push_back(widgets.add(sf::FloatRect(10, 50 + i * 80 + 30, 180, 70), defaultButtonColor, "", 15, sf::Color::Black));
     }
 
-    std::vector<std::string> buttonNames = {
-        "Elementary Programming", "Functions", "Loops", "Arrays", "Object and Classes",
-        "Object Oriented Programming", "Pointers and Dynamic Memory Management",
-        "Templates, Vectors, and Stacks", "File Input and Output", "Operator Overloading",
-        "Recursion", "Exception Handling"
+    const sf::FloatRect scrollTrack(193, 80, 4, sidebarRows * 80 - 10);
+    WidgetId scrollThumb = widgets.add(scrollTrack, sf::Color(128, 128, 128));
+    widgets.setInteractive(scrollThumb, false);
+
+    WidgetId pageNumberText = widgets.add(sf::FloatRect(window.getSize().x - 220, 20, 200, 30), sf::Color::Transparent, "", 20,
+                                          sf::Color::White, WidgetLayer::Align::TopRight);
+    widgets.setInteractive(pageNumberText, false);
+
+    WidgetId nextButton = widgets.add(sf::FloatRect(10, 50 + 5 * 90, 180, 50), sf::Color::Green, "Next", 25);
+    WidgetId prevButton = widgets.add(sf::FloatRect(10, 50 + 5.75 * 90, 180, 50), sf::Color::Red, "Previous", 25);
+    WidgetId nextImageButton = widgets.add(sf::FloatRect(1200, 50 + 6.5 * 90, 50, 60), sf::Color::Green, ">", 25);
+    WidgetId prevImageButton = widgets.add(sf::FloatRect(1100, 50 + 6.5 * 90, 50, 60), sf::Color::Red, "<", 25);
+    WidgetId toggleVisibilityButton = widgets.add(sf::FloatRect(10, 50 + 6.5 * 90, 180, 50), sf::Color::Blue, "Toggle", 25);
+
+    // F3 shows frame times and cache state (and starts recording), F12 writes the trace so far
+    WidgetId profilerOverlay = widgets.add(sf::FloatRect(210, 10, 600, 28), sf::Color(0, 0, 0, 160), "", 14,
+                                           sf::Color::White, WidgetLayer::Align::TopLeft);
+    widgets.setLabelOffset(profilerOverlay, sf::Vector2f(6, 6));
+    widgets.setInteractive(profilerOverlay, false);
+    widgets.setVisible(profilerOverlay, false);
+    bool showProfiler = false;
+
+    // Topics can be added while running, see hotReload below
+    size_t firstVisibleTopic = 0;
+    size_t topicCount = images.size();
+    size_t lastFirstTopic = topicCount > sidebarRows ? topicCount - sidebarRows : 0;
+    auto scrollSidebar = [&](long rows) {
+        long first = static_cast<long>(firstVisibleTopic) + rows;
+        firstVisibleTopic = static_cast<size_t>(std::min(std::max(first, 0L), static_cast<long>(lastFirstTopic)));
     };
 
-    sf::Text pageNumberText;
-    pageNumberText.setFont(font);
-    pageNumberText.setCharacterSize(20);
-    pageNumberText.setFillColor(sf::Color::White);
+    // Lists and slides copied in while running are picked up without a restart (Linux only)
+    HotReload hotReload(topics, textureCache, decodePool, hasCatalog ? &catalogWriter : nullptr);
+    hotReload.start();
 
-    sf::Text sidebarTitle("Lessons", font, 40);
-    sidebarTitle.setPosition(25, 10);
-    sidebarTitle.setFillColor(sf::Color::White);
+    size_t currentButtonIndex = 0;
+    size_t currentImageIndex = 0;
 
-    sf::Text nextButtonText("Next", font, 25);
-    sf::Text prevButtonText("Previous", font, 25);
-    sf::Text toggleButtonText("Toggle", font, 25);
+    // Opens a topic on the named slide, or on page if the name is not in it,
+    // and scrolls the sidebar until the topic is on screen
+    auto goToSlide = [&](size_t topic, const std::string& imageName, size_t page) {
+        if (topic >= topicCount) return;
+
+        currentButtonIndex = topic;
+        currentImageIndex = std::min(page, images[topic].empty() ? 0 : images[topic].size() - 1);
+        ImageHandle slide = textureCache.find(imageName);
+        for (size_t j = 0; slide.isValid() && j < images[topic].size(); ++j) {
+            if (images[topic][j].id == slide.id) {
+                currentImageIndex = j;
+                break;
+            }
+        }
 
-    sf::RectangleShape nextButton(sf::Vector2f(180, 50));
-    nextButton.setPosition(10, 50 + 5 * 90);
-    nextButton.setFillColor(sf::Color::Green);
+        if (topic < firstVisibleTopic) {
+            scrollSidebar(static_cast<long>(topic) - static_cast<long>(firstVisibleTopic));
+        } else if (topic >= firstVisibleTopic + sidebarRows) {
+            scrollSidebar(static_cast<long>(topic + 1 - sidebarRows) - static_cast<long>(firstVisibleTopic));
+        }
+    };
 
-    sf::RectangleShape prevButton(sf::Vector2f(180, 50));
-    prevButton.setPosition(10, 50 + 5.75 * 90);
-    prevButton.setFillColor(sf::Color::Red);
+    if (restored) {
+        size_t topic = lastSession.topic;
+        for (size_t i = 0; i < topicCount; ++i) {
+            if (topics.name(i) == lastSession.topicName) {
+                topic = i;
+                break;
+            }
+        }
+        scrollSidebar(static_cast<long>(lastSession.firstVisibleTopic));
+        goToSlide(topic, lastSession.imageName, lastSession.image);
+        areButtonsVisible = lastSession.buttonsVisible;
+    }
 
-    sf::Text nextImageButtonText(">", font, 25);
-    sf::Text prevImageButtonText("<", font, 25);
+    // Most recent first; their pixels go into the session on exit
+    std::vector<std::string> recentSlides;
+    auto rememberSlide = [&]() {
+        if (currentImageIndex >= images[currentButtonIndex].size()) return;
+        std::string name = textureCache.imageName(images[currentButtonIndex][currentImageIndex]);
+        recentSlides.erase(std::remove(recentSlides.begin(), recentSlides.end(), name), recentSlides.end());
+        recentSlides.insert(recentSlides.begin(), name);
+        if (recentSlides.size() > SessionSnapshot::MaxImages) recentSlides.pop_back();
+    };
 
-    sf::RectangleShape nextImageButton(sf::Vector2f(50, 60));
-    nextImageButton.setPosition(1200, 50 + 6.5 * 90);
-    nextImageButton.setFillColor(sf::Color::Green);
+    Prefetcher prefetcher(textureCache);
+    prefetcher.onNavigate(images, currentButtonIndex, currentImageIndex);
+    size_t shownButtonIndex = currentButtonIndex;
+    size_t shownImageIndex = currentImageIndex;
+
+    // Type-ahead over topic titles, slide names and texts/captions.txt; kept in
+    // step with the catalog and hot reload topic by topic. The captions double
+    // as the presenter's notes.
+    std::unordered_map<std::string, std::string> captions = SearchIndex::readCaptions("texts/captions.txt");
+    SearchIndex search;
+    search.setCaptions(captions);
+    auto syncSearch = [&](size_t topic) {
+        std::vector<std::string> names;
+        if (hasCatalog) {
+            names = catalog.names(static_cast<int>(topic));
+        } else {
+            for (ImageHandle handle : images[topic]) names.push_back(textureCache.imageName(handle));
+        }
+        search.syncTopic(static_cast<int>(topic), topics.name(topic), names);
+    };
+    for (size_t i = 0; i < topicCount; ++i) syncSearch(i);
+
+    std::vector<SearchIndex::Result> searchResults;
+    Button searchButton(widgets, sf::Vector2f(830, 10), sf::Vector2f(210, 40), "search (Ctrl+F)");
+    InputBox searchBox(widgets, {830, 55}, {430, 40});
+    searchBox.onChange = [&](const std::string& text) {
+        searchResults = search.query(text, InputBox::MaxSuggestions);
+        std::vector<std::string> labels;
+        for (const auto& result : searchResults) {
+            if (result.kind == SearchIndex::Kind::Topic) {
+                labels.push_back("Lesson: " + result.text);
+            } else if (result.kind == SearchIndex::Kind::Image) {
+                labels.push_back(result.text + "  (" + topics.name(result.topic) + ")");
+            } else {
+                labels.push_back(result.text + "  (" + result.imageName + ")");
+            }
+        }
+        searchBox.setSuggestions(labels);
+    };
+    // Jumps to the slide, shared slides are found under any of their names
+    searchBox.onChoose = [&](size_t index) {
+        if (index >= searchResults.size()) return;
+        const SearchIndex::Result& result = searchResults[index];
+        if (result.topic >= 0) goToSlide(static_cast<size_t>(result.topic), result.imageName, 0);
+        searchResults.clear();
+    };
 
-    sf::RectangleShape prevImageButton(sf::Vector2f(50, 60));
-    prevImageButton.setPosition(1100, 50 + 6.5 * 90);
-    prevImageButton.setFillColor(sf::Color::Red);
+    // The wheel over a slide zooms around the pointer, dragging pans, + - and 0
+    // on the keyboard. Past the detail of the cached texture the slide is
+    // drawn from tiles instead, so very large images stay sharp and bounded.
+    TiledSlide tiledSlide(decodePool);
+    float zoom = 1.0f;
+    float targetZoom = 1.0f;
+    sf::Vector2f zoomCenter(0.5f, 0.5f);   // point of the slide in the middle of the slide area, 0-1
+    sf::Vector2f anchorSlide(-1.0f, -1.0f); // point of the slide kept under anchorScreen while zooming
+    sf::Vector2f anchorScreen;
+    bool panning = false;
+    sf::Vector2f panFrom;
+    sf::Clock zoomClock;
+
+    auto slideArea = [&]() {
+        sf::Vector2f view = window.getView().getSize();
+        return sf::FloatRect(200, 0, view.x - 200, view.y);
+    };
+    auto currentSlide = [&]() {
+        return currentImageIndex < images[currentButtonIndex].size() ? images[currentButtonIndex][currentImageIndex] : ImageHandle();
+    };
+    auto fittedSize = [&](const sf::Vector2u& source) {
+        sf::FloatRect area = slideArea();
+        return fitSize(source, sf::Vector2u(static_cast<unsigned>(area.width), static_cast<unsigned>(area.height)));
+    };
+    // Up to twice the source's own pixels
+    auto maxZoom = [&](const sf::Vector2u& source) {
+        sf::Vector2u fitted = fittedSize(source);
+        return fitted.x == 0 ? 1.0f : std::max(2.0f, 2.0f * source.x / fitted.x);
+    };
+    // Where the whole slide goes at the current zoom. Follows the anchor, and
+    // keeps the slide covering the area on any axis it is larger than it.
+    auto placeSlide = [&](const sf::Vector2u& source) {
+        sf::FloatRect area = slideArea();
+        sf::Vector2u fitted = fittedSize(source);
+        sf::Vector2f size(fitted.x * zoom, fitted.y * zoom);
+        if (size.x <= 0 || size.y <= 0) return sf::FloatRect();
+
+        sf::Vector2f middle(area.left + area.width / 2, area.top + area.height / 2);
+        if (anchorSlide.x >= 0) {
+            zoomCenter = sf::Vector2f(anchorSlide.x + (middle.x - anchorScreen.x) / size.x, anchorSlide.y + (middle.y - anchorScreen.y) / size.y);
+        }
+        zoomCenter.x = size.x <= area.width ? 0.5f : std::min(std::max(zoomCenter.x, area.width / 2 / size.x), 1.0f - area.width / 2 / size.x);
+        zoomCenter.y = size.y <= area.height ? 0.5f : std::min(std::max(zoomCenter.y, area.height / 2 / size.y), 1.0f - area.height / 2 / size.y);
+        return sf::FloatRect(middle.x - zoomCenter.x * size.x, middle.y - zoomCenter.y * size.y, size.x, size.y);
+    };
+    auto zoomAt = [&](const sf::Vector2f& point, float factor) {
+        sf::Vector2u source = textureCache.sourceSize(currentSlide());
+        sf::FloatRect rect = placeSlide(source);
+        if (rect.width <= 0) return;
+        anchorSlide = sf::Vector2f((point.x - rect.left) / rect.width, (point.y - rect.top) / rect.height);
+        anchorScreen = point;
+        if (zoom == targetZoom) zoomClock.restart();
+        targetZoom = std::min(std::max(targetZoom * factor, 1.0f), maxZoom(source));
+    };
+    auto resetZoom = [&]() {
+        zoom = targetZoom = 1.0f;
+        zoomCenter = sf::Vector2f(0.5f, 0.5f);
+        anchorSlide = sf::Vector2f(-1.0f, -1.0f);
+        panning = false;
+        tiledSlide.close();
+    };
 
-    sf::RectangleShape toggleVisibilityButton(sf::Vector2f(180, 50));
-    toggleVisibilityButton.setPosition(10, 50 + 6.5 * 90);
-    toggleVisibilityButton.setFillColor(sf::Color::Blue);
+    // Changing slide blends the frame on screen into the next one, each drawn
+    // once into the transition's buffers; next and previous in a topic push
+    SlideTransition transition;
+    transition.setArea(slideArea(), slideAreaPixels(window));
+
+    // G shows every slide of the topic as thumbnails from one atlas texture,
+    // which the presenter's strip shares; clicking one goes straight to it
+    // without decoding the slides in between
+    ThumbnailAtlas thumbnailAtlas(decodePool);
+    ThumbnailGrid thumbnailGrid(thumbnailAtlas);
+    bool showThumbnails = false;
+    std::vector<ImageHandle> thumbnailSlides;
+    auto syncThumbnails = [&]() {
+        const std::vector<ImageHandle>& slides = images[currentButtonIndex];
+        if (slides.size() == thumbnailSlides.size() &&
+            std::equal(slides.begin(), slides.end(), thumbnailSlides.begin(), [](ImageHandle a, ImageHandle b) { return a.id == b.id; })) {
+            return;
+        }
+        thumbnailSlides = slides;
+        std::vector<std::string> names;
+        for (ImageHandle handle : slides) names.push_back(textureCache.imageName(handle));
+        thumbnailAtlas.show(topics.name(currentButtonIndex), names);
+    };
 
-    float verticalAdjustment = 20.0f;
+    window.setFramerateLimit(frameCap);
+
+    // Layout is recomputed only when state changed and the scene is only redrawn
+    // when something is dirty; while idle the loop sleeps in waitEvent, or in
+    // naps while files are watched since those changes do not wake it. The naps
+    // stay short while the user is active and lengthen once they go idle.
+    bool layoutDirty = true;
+    bool needsRedraw = true;
+    sf::Clock sinceInput;
+
+    // The speaker's window, drawn from the same texture cache as this one
+    PresenterView presenter(textureCache, thumbnailAtlas, font);
+    presenter.onChoose = [&](size_t page) {
+        if (page < images[currentButtonIndex].size()) currentImageIndex = page;
+        layoutDirty = true;
+        needsRedraw = true;
+    };
+    if (presenting) presenter.open();
 
-    sf::FloatRect nextImageButtonBounds = nextImageButton.getGlobalBounds();
-    sf::FloatRect nextImageTextBounds = nextImageButtonText.getLocalBounds();
-    nextImageButtonText.setOrigin(nextImageTextBounds.width / 2.0f, nextImageTextBounds.height / 2.0f);
-    nextImageButtonText.setPosition(nextImageButtonBounds.left + nextImageButtonBounds.width / 2.0f, nextImageButtonBounds.top + nextImageButtonBounds.height / 2.0f - verticalAdjustment);
+    while (window.isOpen()) {
+        bool loading = !textureCache.progress().isIdle();
+        bool animating = zoom != targetZoom || transition.isActive();
+        bool tiling = tiledSlide.isBuilding() || tiledSlide.missingTiles() > 0;
+        bool thumbnailing = thumbnailAtlas.isBuilding();
+        bool thumbnailsWereShown = showThumbnails;
 
-    sf::FloatRect prevImageButtonBounds = prevImageButton.getGlobalBounds();
-    sf::FloatRect prevImageTextBounds = prevImageButtonText.getLocalBounds();
-    prevImageButtonText.setOrigin(prevImageTextBounds.width / 2.0f, prevImageTextBounds.height / 2.0f);
-    prevImageButtonText.setPosition(prevImageButtonBounds.left + prevImageButtonBounds.width / 2.0f, prevImageButtonBounds.top + prevImageButtonBounds.height / 2.0f - verticalAdjustment);
+        sf::Event event;
+        bool hasEvent;
+        bool writing = catalogWriter.isBusy();
+        if (eventDriven && !loading && !writing && !animating && !tiling && !thumbnailing && !needsRedraw && !hotReload.isActive() && !presenter.isOpen()) {
+            hasEvent = window.waitEvent(event);
+        } else {
+            hasEvent = window.pollEvent(event);
+        }
 
-    std::vector<sf::Text> buttonLabels;
-    for (const auto& name : buttonNames) {
-        std::string wrappedText = wrapper.wrapText(name, 90, font, 8, false);
-        sf::Text label(wrappedText, font, 15);
-        label.setFillColor(sf::Color::Black);
-        buttonLabels.push_back(label);
-    }
+        profiler.beginFrame();
+        sf::Clock frameWork;
 
-    loadImagesFromTextFilesRecursively(0, textures, images, window);
+        {
+            PROFILE_ZONE("events");
+            for (; hasEvent; hasEvent = window.pollEvent(event)) {
+                sinceInput.restart();
+                if (event.type != sf::Event::MouseMoved) {
+                    layoutDirty = true;
+                    needsRedraw = true;
+                }
 
-    size_t currentPage = 0;
-    size_t totalPages = (buttonNames.size() + 4) / 5;
-    size_t currentButtonIndex = 0;
-    size_t currentImageIndex = 0;
+                if (event.type == sf::Event::Closed) window.close();
+                if (event.type == sf::Event::Resized) {
+                    textureCache.setDisplaySize(slideAreaPixels(window));
+                    transition.setArea(slideArea(), slideAreaPixels(window));
+                }
 
-    while (window.isOpen()) {
-        sf::Event event;
-        while (window.pollEvent(event)) {
-            if (event.type == sf::Event::Closed) window.close();
-
-            if (event.type == sf::Event::MouseButtonPressed) {
-                for (size_t i = 0; i < buttons.size(); ++i) {
-                    if (buttons[i].getGlobalBounds().contains(window.mapPixelToCoords(sf::Mouse::getPosition(window)))) {
-                        size_t index = currentPage * 5 + i;
-                        if (index < buttonNames.size()) {
-                            currentButtonIndex = index;
-                            currentImageIndex = 0;
-                            break;
-                        }
+                if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F3) {
+                    showProfiler = !showProfiler;
+                    if (showProfiler) profiler.setEnabled(true);
+                }
+                if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F12 && profiler.isEnabled()) {
+                    profiler.writeChromeTrace(traceOutput);
+                }
+                if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F && event.key.control) {
+                    searchBox.isActive = !searchBox.isActive;
+                }
+                if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F5) {
+                    if (presenter.isOpen()) {
+                        presenter.close();
+                    } else {
+                        presenter.open();
                     }
                 }
 
-                if (myButton.shape.getGlobalBounds().contains(window.mapPixelToCoords(sf::Mouse::getPosition(window)))) {
-                    myInputBox.isActive = !myInputBox.isActive; 
+                if (event.type == sf::Event::MouseWheelScrolled) {
+                    sf::Vector2f point = window.mapPixelToCoords(sf::Vector2i(event.mouseWheelScroll.x, event.mouseWheelScroll.y));
+                    if (point.x < 200) {
+                        scrollSidebar(event.mouseWheelScroll.delta > 0 ? -1 : 1);
+                    } else if (showThumbnails) {
+                        thumbnailGrid.scroll(event.mouseWheelScroll.delta > 0 ? -1 : 1);
+                    } else {
+                        zoomAt(point, std::pow(1.25f, event.mouseWheelScroll.delta));
+                    }
                 }
 
-                if (deleteButton.shape.getGlobalBounds().contains(window.mapPixelToCoords(sf::Mouse::getPosition(window)))) {
-                    deleteInputBox.isActive = !deleteInputBox.isActive; 
+                bool typing = myInputBox.isActive || deleteInputBox.isActive || searchBox.isActive;
+                if (event.type == sf::Event::KeyPressed && !typing) {
+                    if (event.key.code == sf::Keyboard::G) showThumbnails = !showThumbnails;
+                    if (event.key.code == sf::Keyboard::Escape) showThumbnails = false;
+                }
+                if (event.type == sf::Event::KeyPressed && !typing && !showThumbnails) {
+                    sf::FloatRect area = slideArea();
+                    sf::Vector2f middle(area.left + area.width / 2, area.top + area.height / 2);
+                    if (event.key.code == sf::Keyboard::Add || event.key.code == sf::Keyboard::Equal) zoomAt(middle, 1.5f);
+                    if (event.key.code == sf::Keyboard::Subtract || event.key.code == sf::Keyboard::Hyphen) zoomAt(middle, 1.0f / 1.5f);
+                    if (event.key.code == sf::Keyboard::Num0) zoomAt(middle, 1.0f / targetZoom);
+                }
+
+                if (event.type == sf::Event::MouseMoved && panning) {
+                    sf::Vector2f point = window.mapPixelToCoords(sf::Vector2i(event.mouseMove.x, event.mouseMove.y));
+                    sf::FloatRect rect = placeSlide(textureCache.sourceSize(currentSlide()));
+                    if (rect.width > 0) {
+                        anchorSlide = sf::Vector2f(-1.0f, -1.0f);
+                        zoomCenter.x -= (point.x - panFrom.x) / rect.width;
+                        zoomCenter.y -= (point.y - panFrom.y) / rect.height;
+                        needsRedraw = true;
+                    }
+                    panFrom = point;
+                }
+                if (event.type == sf::Event::MouseButtonReleased && event.mouseButton.button == sf::Mouse::Left) {
+                    panning = false;
                 }
 
                 if (event.type == sf::Event::MouseButtonPressed) {
-                    if (toggleVisibilityButton.getGlobalBounds().contains(window.mapPixelToCoords(sf::Mouse::getPosition(window)))) {
+                    sf::Vector2f point = window.mapPixelToCoords(sf::Vector2i(event.mouseButton.x, event.mouseButton.y));
+                    WidgetId hit = widgets.hitTest(point);
+                    if (searchBox.handleClick(hit)) hit = WidgetLayer::None;
+
+                    if (hit == WidgetLayer::None && event.mouseButton.button == sf::Mouse::Left && point.x >= 200 && showThumbnails) {
+                        size_t index = thumbnailGrid.hitTest(point);
+                        if (index < images[currentButtonIndex].size()) {
+                            currentImageIndex = index;
+                            showThumbnails = false;
+                        }
+                    } else if (hit == WidgetLayer::None && event.mouseButton.button == sf::Mouse::Left && point.x >= 200 && zoom > 1.0f) {
+                        panning = true;
+                        panFrom = point;
+                    }
+
+                    for (size_t i = 0; i < buttons.size(); ++i) {
+                        if (hit == buttons[i]) {
+                            size_t index = firstVisibleTopic + i;
+                            if (index < topicCount) {
+                                currentButtonIndex = index;
+                                currentImageIndex = 0;
+                            }
+                        }
+                    }
+
+                    if (hit == myButton.id) {
+                        myInputBox.isActive = !myInputBox.isActive; 
+                    }
+
+                    if (hit == deleteButton.id) {
+                        deleteInputBox.isActive = !deleteInputBox.isActive; 
+                    }
+
+                    if (hit == searchButton.id) {
+                        searchBox.isActive = !searchBox.isActive;
+                    }
+
+                    if (hit == toggleVisibilityButton) {
                         areButtonsVisible = !areButtonsVisible; 
                     }
-                }
 
-                if (nextButton.getGlobalBounds().contains(window.mapPixelToCoords(sf::Mouse::getPosition(window)))) {
-                    if (currentPage < totalPages - 1) currentPage++;
-                }
-                if (prevButton.getGlobalBounds().contains(window.mapPixelToCoords(sf::Mouse::getPosition(window)))) {
-                    if (currentPage > 0) currentPage--;
-                }
+                    if (hit == nextButton) {
+                        scrollSidebar(static_cast<long>(sidebarRows));
+                    }
+                    if (hit == prevButton) {
+                        scrollSidebar(-static_cast<long>(sidebarRows));
+                    }
 
-                if (nextImageButton.getGlobalBounds().contains(window.mapPixelToCoords(sf::Mouse::getPosition(window)))) {
-                    if (currentImageIndex < images[currentButtonIndex].size() - 1) currentImageIndex++;
-                }
-                if (prevImageButton.getGlobalBounds().contains(window.mapPixelToCoords(sf::Mouse::getPosition(window)))) {
-                    if (currentImageIndex > 0) currentImageIndex--;
+                    if (hit == nextImageButton) {
+                        if (currentImageIndex + 1 < images[currentButtonIndex].size()) currentImageIndex++;
+                    }
+                    if (hit == prevImageButton) {
+                        if (currentImageIndex > 0) currentImageIndex--;
+                    }
                 }
+
+                myInputBox.handleInput(event);
+                deleteInputBox.handleInput(event);
+                searchBox.handleInput(event);
             }
+            presenter.update();
+        }
 
-            myInputBox.handleInput(event);
-            deleteInputBox.handleInput(event);
+        if (textureCache.uploadPending(sf::milliseconds(4)) > 0) {
+            needsRedraw = true;
+            presenter.texturesUploaded();
         }
 
-        for (size_t i = 0; i < buttons.size(); ++i) {
-            size_t globalIndex = currentPage * 5 + i;
-            buttons[i].setFillColor(defaultButtonColor);
+        std::vector<int> reloadedTopics = hotReload.update(images);
+        if (!reloadedTopics.empty()) {
+            topicCount = images.size();
+            lastFirstTopic = topicCount > sidebarRows ? topicCount - sidebarRows : 0;
+            for (int topic : reloadedTopics) syncSearch(static_cast<size_t>(topic));
+            layoutDirty = true;
+            needsRedraw = true;
+        }
 
-            if (globalIndex == currentButtonIndex) {
-                buttons[i].setFillColor(activeButtonColor);
-            }
+        std::vector<int> editedTopics = catalogWriter.update();
+        for (int topic : editedTopics) {
+            reloadTopic(catalog, topic, textureCache, images);
+            syncSearch(static_cast<size_t>(topic));
+            catalogEdited = true;
+            layoutDirty = true;
+            needsRedraw = true;
         }
 
-        nextButtonText.setPosition(
-            nextButton.getPosition().x + nextButton.getSize().x / 2 - nextButtonText.getLocalBounds().width / 2,
-            nextButton.getPosition().y + nextButton.getSize().y / 2 - nextButtonText.getLocalBounds().height / 2
-        );
-
-        prevButtonText.setPosition(
-            prevButton.getPosition().x + prevButton.getSize().x / 2 - prevButtonText.getLocalBounds().width / 2,
-            prevButton.getPosition().y + prevButton.getSize().y / 2 - prevButtonText.getLocalBounds().height / 2
-        );
-
-        toggleButtonText.setPosition(
-            toggleVisibilityButton.getPosition().x + toggleVisibilityButton.getSize().x / 2 - toggleButtonText.getLocalBounds().width / 2,
-            toggleVisibilityButton.getPosition().y + toggleVisibilityButton.getSize().y / 2 - toggleButtonText.getLocalBounds().height / 2
-        );
-
-        nextImageButtonText.setPosition(
-            nextImageButton.getPosition().x + nextImageButton.getSize().x / 2 - nextImageButtonText.getLocalBounds().width / 2,
-            nextImageButton.getPosition().y + nextImageButton.getSize().y / 2 - nextImageButtonText.getLocalBounds().height / 2
-        );
-
-        prevImageButtonText.setPosition(
-            prevImageButton.getPosition().x + prevImageButton.getSize().x / 2 - prevImageButtonText.getLocalBounds().width / 2,
-            prevImageButton.getPosition().y + prevImageButton.getSize().y / 2 - prevImageButtonText.getLocalBounds().height / 2
-        );
-
-        if (currentImageIndex == 0) {
-            prevImageButton.setFillColor(inactiveButtonColor);
-        } else {
-            prevImageButton.setFillColor(sf::Color::Red);
+        if (currentImageIndex >= images[currentButtonIndex].size() && currentImageIndex > 0) {
+            currentImageIndex = images[currentButtonIndex].empty() ? 0 : images[currentButtonIndex].size() - 1;
         }
 
-        if (currentImageIndex == images[currentButtonIndex].size() - 1) {
-            nextImageButton.setFillColor(inactiveButtonColor);
-        } else {
-            nextImageButton.setFillColor(sf::Color::Green);
+        if (currentButtonIndex != shownButtonIndex || currentImageIndex != shownImageIndex) {
+            prefetcher.onNavigate(images, currentButtonIndex, currentImageIndex);
+            rememberSlide();
+
+            // From the slide as it was on screen; a zoomed one, or leaving the thumbnails, simply cuts
+            ImageHandle outgoing = shownImageIndex < images[shownButtonIndex].size() ? images[shownButtonIndex][shownImageIndex] : ImageHandle();
+            if (zoom == 1.0f && !thumbnailsWereShown && textureCache.isResident(outgoing)) {
+                bool step = currentButtonIndex == shownButtonIndex && (currentImageIndex + 1 == shownImageIndex || shownImageIndex + 1 == currentImageIndex);
+                transition.start(makeSlideSprite(*textureCache.get(outgoing), textureCache.sourceSize(outgoing), sf::Vector2u(window.getView().getSize())),
+                                 step ? SlideTransition::Style::Push : SlideTransition::Style::Crossfade, currentImageIndex < shownImageIndex ? -1 : 1);
+            } else {
+                transition.skip();
+            }
+            resetZoom();
+            shownButtonIndex = currentButtonIndex;
+            shownImageIndex = currentImageIndex;
         }
 
-        if (!images[currentButtonIndex].empty()) {
-            std::string pageNumberString = std::to_string(currentImageIndex + 1) + "/" + std::to_string(images[currentButtonIndex].size());
-            pageNumberText.setString(pageNumberString);
+        // Zoom eases toward its target; once the slide would be magnified past its
+        // cached texture the tiles for the new view are streamed in
+        ImageHandle slide = currentSlide();
+        sf::Vector2u slideSource = textureCache.sourceSize(slide);
+        if (transition.isWaiting()) {
+            if (const sf::Texture* texture = textureCache.get(slide)) {
+                transition.setIncoming(makeSlideSprite(*texture, slideSource, sf::Vector2u(window.getView().getSize())));
+            }
+        }
+        if (transition.update()) needsRedraw = true;
+        if (zoom != targetZoom) {
+            zoom += (targetZoom - zoom) * std::min(1.0f, zoomClock.restart().asSeconds() * 12.0f);
+            if (std::abs(targetZoom - zoom) < 0.002f * targetZoom) {
+                zoom = targetZoom;
+                anchorSlide = sf::Vector2f(-1.0f, -1.0f);
+            }
+            needsRedraw = true;
+        }
+        sf::FloatRect slideRect = placeSlide(slideSource);
+        if (zoom > 1.0f && slideSource.x > fittedSize(slideSource).x) {
+            PROFILE_ZONE("tiles");
+            tiledSlide.open(textureCache.imageName(slide));
+            if (tiledSlide.update(slideRect, slideArea(), sf::milliseconds(4))) needsRedraw = true;
+        } else if (zoom <= 1.0f && !tiledSlide.imageName().empty()) {
+            tiledSlide.close(); // back to the fitted texture, the tiles stay on disk
+        }
 
-            // Position the text at the top right. Adjust the offset as needed to fit your window size and layout
-            pageNumberText.setPosition(window.getSize().x - pageNumberText.getLocalBounds().width - 20, 20);
+        if (showThumbnails || presenter.isOpen()) syncThumbnails();
+        if (thumbnailAtlas.update()) {
+            needsRedraw = true;
+            presenter.texturesUploaded();
         }
 
+        if (presenter.isOpen()) {
+            auto notes = captions.find(textureCache.imageName(slide));
+            presenter.show(images[currentButtonIndex], currentImageIndex, topics.name(currentButtonIndex),
+                           notes == captions.end() ? std::string() : notes->second);
+            presenter.draw();
+        }
 
-        window.clear();
-        window.draw(sidebar);
-        window.draw(sidebarTitle);
-
-        for (size_t i = 0; i < buttons.size() && i + currentPage * 5 < buttonNames.size(); ++i) {
-            window.draw(buttons[i]);
-            float x = buttons[i].getPosition().x + buttons[i].getSize().x / 2 - buttonLabels[i + currentPage * 5].getLocalBounds().width / 2;
-            float y = buttons[i].getPosition().y + buttons[i].getSize().y / 2 - buttonLabels[i + currentPage * 5].getLocalBounds().height / 2;
-            buttonLabels[i + currentPage * 5].setPosition(x, y);
-            window.draw(buttonLabels[i + currentPage * 5]);
+        if (!eventDriven) {
+            layoutDirty = true;
+            needsRedraw = true;
         }
 
-        window.draw(nextButton);
-        window.draw(prevButton);
-        window.draw(nextButtonText);
-        window.draw(prevButtonText);
+        if (!needsRedraw) {
+            // Still waiting on the decoder pool, the catalog or the file watcher, do not spin.
+            // The presenter window's events do not wake waitEvent on this one either.
+            if (loading || writing || tiling || thumbnailing || presenter.needsRedraw()) {
+                sf::sleep(sf::milliseconds(1));
+            } else if (presenter.isOpen()) {
+                sf::sleep(sf::milliseconds(5));
+            } else if (hotReload.isActive()) {
+                // 40 wakeups a second only while in use; idle, 5 a second still reloads a
+                // changed file within about half a second (250 ms settle plus one nap)
+                sf::sleep(sf::milliseconds(sinceInput.getElapsedTime() < sf::seconds(2) ? 25 : 200));
+            }
+            continue;
+        }
 
-        window.draw(images[currentButtonIndex][currentImageIndex]);
+        if (layoutDirty) {
+            PROFILE_ZONE("layout");
+            layoutDirty = false;
 
-        window.draw(pageNumberText);
-        window.draw(toggleVisibilityButton);
-        window.draw(toggleButtonText);
+            // Labels are wrapped only for the rows on screen; wrapText remembers them
+            for (size_t i = 0; i < buttons.size(); ++i) {
+                size_t globalIndex = firstVisibleTopic + i;
+                widgets.setVisible(buttons[i], globalIndex < topicCount);
+                if (globalIndex < topicCount) {
+                    widgets.setLabel(buttons[i], wrapper.wrapText(topics.name(globalIndex), 90, font, 8, false));
+                }
+                widgets.setFill(buttons[i], globalIndex == currentButtonIndex ? activeButtonColor : defaultButtonColor);
+            }
 
+            widgets.setVisible(scrollThumb, topicCount > sidebarRows);
+            if (topicCount > sidebarRows) {
+                float thumbHeight = std::max(20.0f, scrollTrack.height * sidebarRows / topicCount);
+                float thumbTop = scrollTrack.top + (scrollTrack.height - thumbHeight) * firstVisibleTopic / lastFirstTopic;
+                widgets.setBounds(scrollThumb, sf::FloatRect(scrollTrack.left, thumbTop, scrollTrack.width, thumbHeight));
+            }
+
+            if (currentImageIndex == 0) {
+                widgets.setFill(prevImageButton, inactiveButtonColor);
+            } else {
+                widgets.setFill(prevImageButton, sf::Color::Red);
+            }
+
+            if (currentImageIndex + 1 >= images[currentButtonIndex].size()) {
+                widgets.setFill(nextImageButton, inactiveButtonColor);
+            } else {
+                widgets.setFill(nextImageButton, sf::Color::Green);
+            }
+
+            if (!images[currentButtonIndex].empty()) {
+                std::string pageNumberString = std::to_string(currentImageIndex + 1) + "/" + std::to_string(images[currentButtonIndex].size());
+                widgets.setLabel(pageNumberText, pageNumberString);
+            }
 
-        if (areButtonsVisible) {
-            window.draw(nextImageButton);
-            window.draw(prevImageButton);
-            window.draw(nextImageButtonText);
-            window.draw(prevImageButtonText);
-            myInputBox.draw(window);
-            deleteButton.draw(window);
-            myButton.draw(window); 
-            deleteInputBox.draw(window);
+            widgets.setVisible(nextImageButton, areButtonsVisible);
+            widgets.setVisible(prevImageButton, areButtonsVisible);
+            myButton.setVisible(areButtonsVisible);
+            deleteButton.setVisible(areButtonsVisible);
+            myInputBox.setVisible(areButtonsVisible);
+            deleteInputBox.setVisible(areButtonsVisible);
+            searchButton.setVisible(areButtonsVisible);
+            searchBox.setVisible(areButtonsVisible);
         }
 
+        widgets.setVisible(profilerOverlay, showProfiler);
+        if (showProfiler) {
+            std::ostringstream overlay;
+            overlay.setf(std::ios::fixed);
+            overlay.precision(1);
+            overlay << "frame p50 " << profiler.frameTimePercentile(50) << " ms  p95 " << profiler.frameTimePercentile(95)
+                    << " ms  p99 " << profiler.frameTimePercentile(99) << " ms  transition p99 " << transition.frameTimePercentile(99) << " ms  |  "
+                    << textureCache.residentBytes() / (1024.0 * 1024.0) << " MB in " << textureCache.residentCount() << " textures  |  hit rate "
+                    << prefetcher.stats().hitRate() * 100.0f << "%";
+            widgets.setLabel(profilerOverlay, overlay.str());
+        }
 
-        //window.draw(title);
-        window.display();
+        {
+            PROFILE_ZONE("draw");
+            window.clear();
+
+            if (showThumbnails) {
+                thumbnailGrid.layout(slideArea(), currentImageIndex);
+                window.draw(thumbnailGrid);
+            } else if (transition.isActive()) {
+                window.draw(transition);
+            } else if (tiledSlide.isReady() && zoom > 1.0f && tiledSlide.imageName() == textureCache.imageName(slide)) {
+                window.draw(tiledSlide);
+            } else if (const sf::Texture* texture = textureCache.get(slide)) {
+                if (zoom > 1.0f && slideRect.width > 0) {
+                    // Scaled up until the tiles are there
+                    sf::Sprite sprite(*texture);
+                    sprite.setPosition(slideRect.left, slideRect.top);
+                    sprite.setScale(slideRect.width / texture->getSize().x, slideRect.height / texture->getSize().y);
+                    window.draw(sprite);
+                } else {
+                    window.draw(makeSlideSprite(*texture, slideSource, sf::Vector2u(window.getView().getSize())));
+                }
+            }
+
+            window.draw(widgets);
+        }
+        transition.recordFrame(frameWork.getElapsedTime());
+        profiler.endFrame();
+
+        {
+            PROFILE_ZONE("display");
+            window.display();
+        }
+        needsRedraw = false;
+    }
+
+    const PrefetchStats& prefetchStats = prefetcher.stats();
+    LOG_INFO("Prefetch hits: " << prefetchStats.hits << ", misses: " << prefetchStats.misses
+             << ", cancelled: " << prefetchStats.cancelled);
+    if (transition.frameCount() > 0) {
+        LOG_INFO("Transition frames: " << transition.frameCount() << ", p50 " << transition.frameTimePercentile(50)
+                 << " ms, p99 " << transition.frameTimePercentile(99) << " ms");
+    }
+
+    // Keep the plain text lists in step with the catalog for editing by hand
+    if (!catalogWriter.finish().empty()) catalogEdited = true;
+    if (catalogEdited) {
+        exportCatalog(catalog);
+    }
+
+    // Saved last so the next start opens on the same slide, with the slides
+    // viewed most recently already on the GPU
+    rememberSlide();
+    SessionState sessionState;
+    sessionState.topic = static_cast<std::uint32_t>(currentButtonIndex);
+    sessionState.image = static_cast<std::uint32_t>(currentImageIndex);
+    sessionState.firstVisibleTopic = static_cast<std::uint32_t>(firstVisibleTopic);
+    sessionState.buttonsVisible = areButtonsVisible;
+    sessionState.topicName = topics.name(currentButtonIndex);
+    if (currentImageIndex < images[currentButtonIndex].size()) {
+        sessionState.imageName = textureCache.imageName(images[currentButtonIndex][currentImageIndex]);
+    }
+
+    std::vector<sf::Image> recentPixels(recentSlides.size());
+    std::vector<SessionImage> recentImages;
+    for (size_t i = 0; i < recentSlides.size(); ++i) {
+        ImageHandle slide = textureCache.find(recentSlides[i]);
+        if (!textureCache.copyPixels(slide, recentPixels[i])) continue;
+        SessionImage image;
+        image.imageName = recentSlides[i];
+        image.pixels = recentPixels[i].getPixelsPtr();
+        image.size = recentPixels[i].getSize();
+        image.sourceSize = textureCache.sourceSize(slide);
+        recentImages.push_back(image);
+    }
+    SessionSnapshot::write(sessionPath, sessionState, recentImages);
+
+    if (profiler.isEnabled()) {
+        profiler.writeChromeTrace(traceOutput);
     }
 
     return 0;
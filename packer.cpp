@@ -0,0 +1,238 @@
+#include <SFML/Graphics.hpp>
+#include "assetArchive.hpp"
+#include "catalog.hpp"
+#include "imageDecoder.hpp"
+#include "ImageFunctions.hpp"
+#include "logger.hpp"
+#include "threadPool.hpp"
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifdef CODEQUEST_WITH_LZ4
+#include <lz4.h>
+#endif
+
+// Offline tool: decodes every image referenced by the catalog once and writes
+// them as raw RGBA blocks to images/assets.pak for AssetArchive to map.
+//
+// usage: packer [--lz4] [output]
+
+namespace {
+
+struct PackJob {
+    std::string name;
+    std::vector<std::string> aliases; // names with the same content, stored once
+    std::vector<sf::Uint8> pixels;
+    sf::Vector2u size;
+    bool decoded;
+    bool done;
+};
+
+// Tracks the position itself, ftell is a 32-bit long on Windows and archives may be larger
+bool writeBytes(std::FILE* out, std::uint64_t& position, const void* data, std::size_t size) {
+    if (std::fwrite(data, 1, size, out) != size) return false;
+    position += size;
+    return true;
+}
+
+bool writePadding(std::FILE* out, std::uint64_t& position, std::size_t alignment) {
+    std::size_t padding = static_cast<std::size_t>((alignment - position % alignment) % alignment);
+    static const char zeros[PackAlignment] = {};
+    return writeBytes(out, position, zeros, padding);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool compress = false;
+    std::string outputPath = "images/assets.pak";
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--lz4") == 0) {
+            compress = true;
+        } else {
+            outputPath = argv[i];
+        }
+    }
+
+#ifndef CODEQUEST_WITH_LZ4
+    if (compress) {
+        LOG_WARNING("Built without CODEQUEST_WITH_LZ4, storing blocks uncompressed");
+        compress = false;
+    }
+#endif
+
+    TopicRegistry topics;
+    topics.discover();
+
+    Catalog catalog;
+    if (!openCatalog(catalog, "texts/catalog.bin", topics)) {
+        LOG_ERROR("Could not open the catalog");
+        return 1;
+    }
+
+    // Identical files under different names become table entries for one block.
+    // A hash is only trusted while both files still match the catalog, an image
+    // edited since would otherwise be served with another one's pixels.
+    std::vector<PackJob> jobs;
+    std::unordered_set<std::string> seen;
+    std::unordered_map<std::uint64_t, std::size_t> jobsByHash;
+    for (int topic = 0; topic < catalog.topicCount(); ++topic) {
+        for (const auto& name : catalog.names(topic)) {
+            if (!seen.insert(name).second) continue;
+
+            std::uint64_t hash = currentContentHash(*catalog.find(topic, name));
+            auto same = hash != 0 ? jobsByHash.find(hash) : jobsByHash.end();
+            if (same != jobsByHash.end()) {
+                jobs[same->second].aliases.push_back(name);
+                continue;
+            }
+            if (hash != 0) jobsByHash.emplace(hash, jobs.size());
+            jobs.push_back(PackJob{name, {}, {}, sf::Vector2u(), false, false});
+        }
+    }
+
+    std::string tempPath = outputPath + ".tmp";
+    std::FILE* out = std::fopen(tempPath.c_str(), "wb");
+    if (!out) {
+        LOG_ERROR("Failed to open file for writing: " << tempPath);
+        return 1;
+    }
+
+    PackHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, PackMagic, sizeof(PackMagic));
+    header.version = PackVersion;
+    std::uint64_t position = 0;
+    bool ok = writeBytes(out, position, &header, sizeof(header));
+
+    // Decode on all cores, write in catalog order as the results come in. The
+    // pool is declared last so its workers are joined before what they use goes.
+    std::mutex mutex;
+    std::condition_variable finished;
+    ThreadPool pool;
+
+    // Only a few images ahead of the writer are decoded, so memory stays
+    // bounded by the worker count rather than the size of the deck
+    const std::size_t ahead = 2 * static_cast<std::size_t>(pool.workerCount());
+    std::size_t submitted = 0;
+    auto submitUpTo = [&](std::size_t end) {
+        for (; submitted < end && submitted < jobs.size(); ++submitted) {
+            PackJob* target = &jobs[submitted];
+            pool.submit([target, &mutex, &finished] {
+                bool decoded = DecoderRegistry::instance().decodeImage(target->name, target->pixels, target->size);
+                std::lock_guard<std::mutex> lock(mutex);
+                target->decoded = decoded;
+                target->done = true;
+                finished.notify_all();
+            });
+        }
+    };
+
+    std::vector<PackTocEntry> toc;
+    std::vector<std::string> tocNames;
+    std::size_t rawBytes = 0;
+    std::size_t storedBytes = 0;
+
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+        submitUpTo(i + ahead);
+        PackJob& job = jobs[i];
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [&job] { return job.done; });
+        }
+        if (!job.decoded) {
+            LOG_ERROR("Could not load image: " << job.name);
+            continue;
+        }
+
+        struct stat info;
+        if (stat(("images/" + job.name).c_str(), &info) != 0) {
+            DecoderRegistry::instance().pool().release(std::move(job.pixels));
+            continue;
+        }
+
+        PackTocEntry entry;
+        std::memset(&entry, 0, sizeof(entry));
+        entry.width = job.size.x;
+        entry.height = job.size.y;
+        entry.sourceSize = static_cast<std::uint64_t>(info.st_size);
+        entry.sourceMtime = static_cast<std::int64_t>(info.st_mtime);
+        entry.nameLength = static_cast<std::uint32_t>(job.name.size());
+        entry.compression = PackRaw;
+
+        const sf::Uint8* block = job.pixels.data();
+        std::size_t blockSize = static_cast<std::size_t>(entry.width) * entry.height * 4;
+        rawBytes += blockSize;
+
+#ifdef CODEQUEST_WITH_LZ4
+        std::vector<char> compressed;
+        if (compress) {
+            compressed.resize(LZ4_compressBound(static_cast<int>(blockSize)));
+            int size = LZ4_compress_default(reinterpret_cast<const char*>(block), compressed.data(), static_cast<int>(blockSize), static_cast<int>(compressed.size()));
+            // Only worth it if it saves something, raw blocks upload without a copy
+            if (size > 0 && static_cast<std::size_t>(size) < blockSize) {
+                block = reinterpret_cast<const sf::Uint8*>(compressed.data());
+                blockSize = static_cast<std::size_t>(size);
+                entry.compression = PackLz4;
+            }
+        }
+#endif
+
+        ok = ok && writePadding(out, position, PackAlignment);
+        entry.offset = position;
+        entry.storedSize = blockSize;
+        ok = ok && writeBytes(out, position, block, blockSize);
+        storedBytes += blockSize;
+
+        toc.push_back(entry);
+        tocNames.push_back(job.name);
+
+        for (const auto& alias : job.aliases) {
+            if (stat(("images/" + alias).c_str(), &info) != 0) continue;
+            PackTocEntry shared = entry;
+            shared.sourceSize = static_cast<std::uint64_t>(info.st_size);
+            shared.sourceMtime = static_cast<std::int64_t>(info.st_mtime);
+            shared.nameLength = static_cast<std::uint32_t>(alias.size());
+            toc.push_back(shared);
+            tocNames.push_back(alias);
+        }
+        DecoderRegistry::instance().pool().release(std::move(job.pixels)); // reused by the next decode
+    }
+
+    ok = ok && writePadding(out, position, 8);
+    header.tocOffset = position;
+    header.entryCount = static_cast<std::uint32_t>(toc.size());
+    for (std::size_t i = 0; i < toc.size() && ok; ++i) {
+        ok = writeBytes(out, position, &toc[i], sizeof(toc[i])) &&
+             writeBytes(out, position, tocNames[i].data(), tocNames[i].size()) &&
+             writePadding(out, position, 8);
+    }
+
+    ok = ok && std::fseek(out, 0, SEEK_SET) == 0 && std::fwrite(&header, sizeof(header), 1, out) == 1;
+    ok = (std::fclose(out) == 0) && ok;
+    if (!ok) {
+        LOG_ERROR("Failed to write archive: " << tempPath);
+        std::remove(tempPath.c_str());
+        return 1;
+    }
+
+    // rename replaces the old archive atomically where it can, Windows needs it removed first
+    if (std::rename(tempPath.c_str(), outputPath.c_str()) != 0) {
+        std::remove(outputPath.c_str());
+        if (std::rename(tempPath.c_str(), outputPath.c_str()) != 0) {
+            LOG_ERROR("Failed to replace file: " << outputPath);
+            return 1;
+        }
+    }
+
+    LOG_INFO("Packed " << toc.size() << " images into " << outputPath << " ("
+             << rawBytes / 1024 << " KiB of pixels, " << storedBytes / 1024 << " KiB stored)");
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include "prefetcher.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+
+Prefetcher::Prefetcher(TextureCache& cache, std::size_t depth)
+    : cache(cache), depth(depth), hasPosition(false), lastTopic(0), lastIndex(0), direction(0) {}
+
+void Prefetcher::onNavigate(const std::vector<std::vector<ImageHandle>>& images, std::size_t topic, std::size_t index) {
+    PROFILE_ZONE("prefetch");
+    if (topic >= images.size()) return;
+    const std::vector<ImageHandle>& slides = images[topic];
+
+    if (hasPosition && topic == lastTopic) {
+        if (index > lastIndex) direction = 1;
+        else if (index < lastIndex) direction = -1;
+    } else {
+        direction = 0;
+    }
+    hasPosition = true;
+    lastTopic = topic;
+    lastIndex = index;
+
+    if (index < slides.size()) {
+        if (cache.isResident(slides[index])) counters.hits++;
+        else counters.misses++;
+    }
+
+    // Nearest first, the decoder pool works through requests in order
+    std::vector<ImageHandle> wanted;
+    if (index < slides.size()) warm(slides[index], wanted);
+
+    std::size_t ahead = depth + (direction > 0 ? depth : 0);
+    std::size_t behind = depth + (direction < 0 ? depth : 0);
+    for (std::size_t step = 1; step <= std::max(ahead, behind); ++step) {
+        if (step <= ahead && index + step < slides.size()) warm(slides[index + step], wanted);
+        if (step <= behind && index >= step && index - step < slides.size()) warm(slides[index - step], wanted);
+    }
+
+    if (topic + 1 < images.size() && !images[topic + 1].empty()) warm(images[topic + 1].front(), wanted);
+    if (topic > 0 && !images[topic - 1].empty()) warm(images[topic - 1].front(), wanted);
+
+    for (const auto& handle : warming) {
+        bool stillWanted = std::any_of(wanted.begin(), wanted.end(), [&](const ImageHandle& h) { return h.id == handle.id; });
+        if (!stillWanted && cache.isPending(handle)) {
+            cache.cancel(handle);
+            counters.cancelled++;
+        }
+    }
+    warming.swap(wanted);
+}
+
+void Prefetcher::warm(ImageHandle handle, std::vector<ImageHandle>& wanted) {
+    cache.request(handle);
+    wanted.push_back(handle);
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "textureCache.hpp"
+#include <cstddef>
+#include <vector>
+
+struct PrefetchStats {
+    std::size_t hits;      // slide was resident when navigated to
+    std::size_t misses;
+    std::size_t cancelled; // warmed slides dropped because the user went elsewhere
+
+    PrefetchStats() : hits(0), misses(0), cancelled(0) {}
+
+    float hitRate() const { return hits + misses == 0 ? 0.0f : static_cast<float>(hits) / (hits + misses); }
+};
+
+// Warms the slides around the one on screen so that switching with the
+// next/previous buttons finds them resident. More slides are warmed in the
+// direction the user is moving, and the first slide of the neighbouring topics
+// is warmed for sidebar clicks. Requests that fall out of the window when the
+// user jumps elsewhere are cancelled.
+class Prefetcher {
+public:
+    explicit Prefetcher(TextureCache& cache, std::size_t depth = 2);
+
+    // Call whenever the displayed slide changes
+    void onNavigate(const std::vector<std::vector<ImageHandle>>& images, std::size_t topic, std::size_t index);
+
+    const PrefetchStats& stats() const { return counters; }
+
+private:
+    void warm(ImageHandle handle, std::vector<ImageHandle>& wanted);
+
+    TextureCache& cache;
+    std::size_t depth;
+    bool hasPosition;
+    std::size_t lastTopic;
+    std::size_t lastIndex;
+    int direction;
+    std::vector<ImageHandle> warming;
+    PrefetchStats counters;
+};
@@ -0,0 +1,190 @@
+#include "presenterView.hpp"
+#include "ImageFunctions.hpp"
+#include "profiler.hpp"
+#include "resample.hpp"
+#include <algorithm>
+#include <cmath>
+
+const unsigned PresenterView::ThumbnailWidth;
+const unsigned PresenterView::ThumbnailHeight;
+const sf::Int32 PresenterView::MinFrameTime;
+
+namespace {
+
+const float Margin = 20.0f;
+const float Gap = 10.0f;
+const float HeaderHeight = 45.0f;
+
+} // namespace
+
+PresenterView::PresenterView(TextureCache& cache, const ThumbnailAtlas& atlas, const sf::Font& font)
+    : cache(cache), atlas(atlas), widgets(font), font(font), current(0), firstThumbnail(0), dirty(true), layoutDirty(true), waiting(false) {
+    titleLabel = widgets.add(sf::FloatRect(Margin, 12, 600, 24), sf::Color::Transparent, "", 20, sf::Color::White, WidgetLayer::Align::TopLeft);
+    nextLabel = widgets.add(sf::FloatRect(0, 12, 200, 24), sf::Color::Transparent, "Next", 20, sf::Color(160, 160, 160), WidgetLayer::Align::TopLeft);
+    notesLabel = widgets.add(sf::FloatRect(), sf::Color::Transparent, "", 18, sf::Color::White, WidgetLayer::Align::TopLeft);
+    widgets.setInteractive(titleLabel, false);
+    widgets.setInteractive(nextLabel, false);
+    widgets.setInteractive(notesLabel, false);
+}
+
+void PresenterView::open() {
+    if (window.isOpen()) return;
+    window.create(sf::VideoMode(1280, 720), "CodeQuest - Presenter");
+    window.setVerticalSyncEnabled(false); // paced by the audience window, see MinFrameTime
+    dirty = true;
+    layoutDirty = true;
+}
+
+void PresenterView::close() {
+    window.close();
+}
+
+void PresenterView::show(const std::vector<ImageHandle>& topicSlides, std::size_t page, const std::string& title, const std::string& notes) {
+    bool sameSlides = topicSlides.size() == slides.size() &&
+                      std::equal(topicSlides.begin(), topicSlides.end(), slides.begin(), [](ImageHandle a, ImageHandle b) { return a.id == b.id; });
+    if (sameSlides && page == current && title == titleText && notes == notesText) return;
+
+    if (!sameSlides) slides = topicSlides;
+    if (page != current || !sameSlides) scrollTo(page);
+    current = page;
+    titleText = title;
+    notesText = notes;
+    dirty = true;
+    layoutDirty = true;
+}
+
+void PresenterView::update() {
+    sf::Event event;
+    while (window.isOpen() && window.pollEvent(event)) {
+        if (event.type == sf::Event::Closed || (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Escape)) {
+            window.close();
+            return;
+        }
+        if (event.type == sf::Event::Resized) {
+            window.setView(sf::View(sf::FloatRect(0, 0, static_cast<float>(event.size.width), static_cast<float>(event.size.height))));
+            layoutDirty = true;
+        }
+        if (event.type == sf::Event::GainedFocus || event.type == sf::Event::Resized) dirty = true;
+
+        if (event.type == sf::Event::KeyPressed && onChoose && !slides.empty()) {
+            sf::Keyboard::Key key = event.key.code;
+            if ((key == sf::Keyboard::Right || key == sf::Keyboard::Space || key == sf::Keyboard::PageDown) && current + 1 < slides.size()) onChoose(current + 1);
+            if ((key == sf::Keyboard::Left || key == sf::Keyboard::PageUp) && current > 0) onChoose(current - 1);
+            if (key == sf::Keyboard::Home) onChoose(0);
+            if (key == sf::Keyboard::End) onChoose(slides.size() - 1);
+        }
+
+        // Scrubbing only moves the strip; the audience sees a slide once it is clicked
+        if (event.type == sf::Event::MouseWheelScrolled) {
+            long first = static_cast<long>(firstThumbnail) + (event.mouseWheelScroll.delta > 0 ? -1 : 1);
+            long last = static_cast<long>(slides.size()) - static_cast<long>(thumbnails.size());
+            firstThumbnail = static_cast<std::size_t>(std::max(0L, std::min(first, std::max(last, 0L))));
+            layoutDirty = true;
+            dirty = true;
+        }
+
+        if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left && onChoose) {
+            sf::Vector2f point = window.mapPixelToCoords(sf::Vector2i(event.mouseButton.x, event.mouseButton.y));
+            WidgetLayer::WidgetId hit = widgets.hitTest(point);
+            for (std::size_t i = 0; i < thumbnails.size(); ++i) {
+                if (hit == thumbnails[i] && firstThumbnail + i < slides.size()) onChoose(firstThumbnail + i);
+            }
+        }
+    }
+}
+
+void PresenterView::texturesUploaded() {
+    if (waiting) dirty = true;
+}
+
+// Keeps the page in the strip, scrolling as little as possible
+void PresenterView::scrollTo(std::size_t page) {
+    std::size_t visible = std::max<std::size_t>(thumbnails.size(), 1);
+    if (page < firstThumbnail) {
+        firstThumbnail = page;
+    } else if (page >= firstThumbnail + visible) {
+        firstThumbnail = page + 1 - visible;
+    }
+}
+
+void PresenterView::layout() {
+    layoutDirty = false;
+    sf::Vector2f size = window.getView().getSize();
+
+    // Current slide on the left, the next one and the notes beside it, the strip along the bottom
+    float stripTop = size.y - Margin - ThumbnailHeight;
+    float columnLeft = std::floor(size.x * 0.6f);
+    float columnWidth = std::max(size.x - columnLeft - Margin, 0.0f);
+    currentArea = sf::FloatRect(Margin, HeaderHeight, std::max(columnLeft - Margin - Gap, 0.0f), std::max(stripTop - HeaderHeight - Gap, 0.0f));
+    nextArea = sf::FloatRect(columnLeft, HeaderHeight, columnWidth, columnWidth * 9 / 16);
+
+    std::string position = slides.empty() ? "" : "  " + std::to_string(current + 1) + "/" + std::to_string(slides.size());
+    widgets.setLabel(titleLabel, titleText + position);
+    widgets.setBounds(nextLabel, sf::FloatRect(columnLeft, 12, columnWidth, 24));
+    widgets.setVisible(nextLabel, current + 1 < slides.size());
+
+    float notesTop = nextArea.top + nextArea.height + Gap;
+    widgets.setBounds(notesLabel, sf::FloatRect(columnLeft, notesTop, columnWidth, std::max(stripTop - Gap - notesTop, 0.0f)));
+    widgets.setLabel(notesLabel, TextWrapper<char, std::string>::wrapText(notesText, static_cast<unsigned>(columnWidth), font, 18));
+
+    std::size_t visible = static_cast<std::size_t>(std::max((size.x - 2 * Margin + Gap) / (ThumbnailWidth + Gap), 1.0f));
+    while (thumbnails.size() < visible) {
+        thumbnails.push_back(widgets.add(sf::FloatRect(), sf::Color(60, 60, 60)));
+    }
+    firstThumbnail = std::min(firstThumbnail, slides.size() > visible ? slides.size() - visible : 0);
+    for (std::size_t i = 0; i < thumbnails.size(); ++i) {
+        std::size_t page = firstThumbnail + i;
+        bool shown = i < visible && page < slides.size();
+        widgets.setVisible(thumbnails[i], shown);
+        widgets.setBounds(thumbnails[i], sf::FloatRect(Margin + i * (ThumbnailWidth + Gap), stripTop, ThumbnailWidth, ThumbnailHeight));
+        widgets.setFill(thumbnails[i], page == current ? sf::Color::Yellow : sf::Color(60, 60, 60));
+    }
+}
+
+void PresenterView::drawSlide(std::size_t page, const sf::FloatRect& area) {
+    if (page >= slides.size() || area.width < 1 || area.height < 1) return;
+
+    // Not resident yet: requested here, drawn once texturesUploaded says so
+    const sf::Texture* texture = cache.get(slides[page]);
+    if (!texture) {
+        waiting = true;
+        return;
+    }
+
+    sf::Vector2u textureSize = texture->getSize();
+    sf::Vector2u source = cache.sourceSize(slides[page]);
+    sf::Vector2u shown = fitSize(source.x > 0 ? source : textureSize, sf::Vector2u(static_cast<unsigned>(area.width), static_cast<unsigned>(area.height)));
+    if (textureSize.x == 0 || textureSize.y == 0) return;
+
+    sf::Sprite sprite(*texture);
+    sprite.setPosition(std::floor(area.left + (area.width - shown.x) / 2), std::floor(area.top + (area.height - shown.y) / 2));
+    sprite.setScale(static_cast<float>(shown.x) / textureSize.x, static_cast<float>(shown.y) / textureSize.y);
+    window.draw(sprite);
+}
+
+void PresenterView::draw() {
+    if (!window.isOpen() || !dirty || frameClock.getElapsedTime() < sf::milliseconds(MinFrameTime)) return;
+    PROFILE_ZONE("presenter");
+    if (layoutDirty) layout();
+
+    window.clear(sf::Color(30, 30, 30));
+    window.draw(widgets);
+
+    waiting = false;
+    drawSlide(current, currentArea);
+    drawSlide(current + 1, nextArea);
+
+    // Inset so the frame shows around each thumbnail, yellow around the current one
+    sf::VertexArray strip(sf::Triangles);
+    for (std::size_t i = 0; i < thumbnails.size(); ++i) {
+        if (!widgets.isVisible(thumbnails[i])) continue;
+        if (!atlas.has(firstThumbnail + i)) waiting = true;
+        sf::FloatRect frame = widgets.getBounds(thumbnails[i]);
+        atlas.appendQuad(strip, firstThumbnail + i, sf::FloatRect(frame.left + 3, frame.top + 3, frame.width - 6, frame.height - 6));
+    }
+    window.draw(strip, sf::RenderStates(&atlas.texture()));
+
+    window.display();
+    frameClock.restart();
+    dirty = false;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include "textureCache.hpp"
+#include "thumbnailAtlas.hpp"
+#include "widgets.hpp"
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Second window for the speaker: the slide the audience sees, the next one,
+// the slide's notes and a strip of thumbnails of the topic.
+//
+// It draws the audience window's TextureCache textures, scaled: SFML creates
+// every window's GL context sharing one set of resources, so no slide is
+// decoded or uploaded twice. The strip is drawn from the topic's
+// ThumbnailAtlas, so scrubbing through it decodes no slides at all. Both
+// windows run on the UI thread, where the cache lives; the presenter keeps its own layout and redraws only when
+// something it shows changed, at most every MinFrameTime, so scrubbing the
+// strip never takes more than every other frame from the audience window.
+class PresenterView {
+public:
+    static const unsigned ThumbnailWidth = 160;
+    static const unsigned ThumbnailHeight = 90;
+    static const sf::Int32 MinFrameTime = 33; // milliseconds
+
+    PresenterView(TextureCache& cache, const ThumbnailAtlas& atlas, const sf::Font& font);
+
+    void open();
+    void close();
+    bool isOpen() const { return window.isOpen(); }
+
+    // Slides of the topic on screen and the page the audience sees; cheap to
+    // call every frame, only a change is redrawn
+    void show(const std::vector<ImageHandle>& topicSlides, std::size_t page, const std::string& title, const std::string& notes);
+
+    // Called with a page of the topic when the presenter picks one, by
+    // clicking a thumbnail or with the arrow keys
+    std::function<void(std::size_t)> onChoose;
+
+    // Handles the window's events without blocking
+    void update();
+    // Redraws if a slide or thumbnail it waits for may have been uploaded
+    void texturesUploaded();
+
+    bool needsRedraw() const { return dirty && window.isOpen(); }
+    void draw();
+
+private:
+    void layout();
+    void scrollTo(std::size_t page);
+    void drawSlide(std::size_t page, const sf::FloatRect& area);
+
+    TextureCache& cache;
+    const ThumbnailAtlas& atlas; // of the same topic as slides
+    sf::RenderWindow window;
+    WidgetLayer widgets;
+    WidgetLayer::WidgetId titleLabel;
+    WidgetLayer::WidgetId nextLabel;
+    WidgetLayer::WidgetId notesLabel;
+    std::vector<WidgetLayer::WidgetId> thumbnails; // frames, one per visible thumbnail
+    const sf::Font& font;
+
+    std::vector<ImageHandle> slides;
+    std::size_t current;
+    std::size_t firstThumbnail;
+    std::string titleText;
+    std::string notesText;
+
+    sf::FloatRect currentArea;
+    sf::FloatRect nextArea;
+    bool dirty;
+    bool layoutDirty;
+    bool waiting; // a slide or thumbnail was missing at the last draw
+    sf::Clock frameClock;
+};
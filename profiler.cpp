@@ -0,0 +1,156 @@
+#include "profiler.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+namespace {
+
+std::string escapeJson(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) continue;
+        escaped += c;
+    }
+    return escaped;
+}
+
+} // namespace
+
+const std::size_t Profiler::ZonesPerThread;
+const std::size_t Profiler::FrameHistory;
+
+Profiler& Profiler::instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler()
+    : active(false), epoch(std::chrono::steady_clock::now()), frameStart(epoch), frameNext(0), frames(0) {
+    frameTimes.reserve(FrameHistory);
+}
+
+Profiler::ThreadBuffer& Profiler::threadBuffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer) {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        buffers.emplace_back(new ThreadBuffer());
+        buffer = buffers.back().get();
+        buffer->tid = static_cast<unsigned>(buffers.size());
+        buffer->name = "thread " + std::to_string(buffer->tid);
+    }
+    return *buffer;
+}
+
+long long Profiler::micros(std::chrono::steady_clock::time_point time) const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(time - epoch).count();
+}
+
+void Profiler::setThreadName(const std::string& name) {
+    ThreadBuffer& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.name = name;
+}
+
+void Profiler::record(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+    ThreadBuffer& buffer = threadBuffer();
+    long long begin = micros(start);
+
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    // Threads that only named themselves, e.g. pool workers with profiling off, never get a ring
+    if (buffer.zones.empty()) {
+        if (!isEnabled()) return;
+        buffer.zones.resize(ZonesPerThread);
+    }
+    Zone& zone = buffer.zones[buffer.next];
+    zone.name = name;
+    zone.start = begin;
+    zone.duration = micros(end) - begin;
+
+    if (++buffer.next == buffer.zones.size()) {
+        buffer.next = 0;
+        buffer.wrapped = true;
+    }
+}
+
+void Profiler::beginFrame() {
+    std::lock_guard<std::mutex> lock(framesMutex);
+    frameStart = std::chrono::steady_clock::now();
+}
+
+void Profiler::endFrame() {
+    if (!isEnabled()) return;
+    auto now = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(framesMutex);
+    float milliseconds = std::chrono::duration<float, std::milli>(now - frameStart).count();
+
+    if (frameTimes.size() < FrameHistory) {
+        frameTimes.push_back(milliseconds);
+    } else {
+        frameTimes[frameNext] = milliseconds;
+    }
+    frameNext = (frameNext + 1) % FrameHistory;
+    ++frames;
+}
+
+float Profiler::frameTimePercentile(float percentile) const {
+    std::vector<float> sorted;
+    {
+        std::lock_guard<std::mutex> lock(framesMutex);
+        sorted = frameTimes;
+    }
+    if (sorted.empty()) return 0.0f;
+
+    // Nearest rank
+    std::size_t rank = static_cast<std::size_t>(std::ceil(percentile / 100.0f * sorted.size()));
+    rank = std::min(std::max<std::size_t>(rank, 1), sorted.size()) - 1;
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+std::size_t Profiler::frameCount() const {
+    std::lock_guard<std::mutex> lock(framesMutex);
+    return frames;
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) const {
+    std::ofstream file(path);
+    if (!file) {
+        LOG_ERROR("Could not write trace: " << path);
+        return false;
+    }
+
+    file << "{\"traceEvents\":[";
+    bool first = true;
+    std::size_t written = 0;
+
+    std::lock_guard<std::mutex> buffersLock(buffersMutex);
+    for (const auto& buffer : buffers) {
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+
+        file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+             << ",\"args\":{\"name\":\"" << escapeJson(buffer->name) << "\"}}";
+        first = false;
+
+        // Oldest first once the ring has wrapped
+        std::size_t count = buffer->wrapped ? buffer->zones.size() : buffer->next;
+        std::size_t begin = buffer->wrapped ? buffer->next : 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            const Zone& zone = buffer->zones[(begin + i) % buffer->zones.size()];
+            file << ",\n{\"name\":\"" << zone.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+                 << ",\"ts\":" << zone.start << ",\"dur\":" << zone.duration << "}";
+        }
+        written += count;
+    }
+
+    file << "\n]}\n";
+    if (!file) {
+        LOG_ERROR("Could not write trace: " << path);
+        return false;
+    }
+
+    LOG_INFO("Wrote " << written << " profile zones to " << path);
+    return true;
+}
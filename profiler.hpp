@@ -0,0 +1,104 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// In-process recorder for timed zones and frame times.
+//
+// Each thread writes zones into its own ring buffer, so recording costs two
+// clock reads and an uncontended lock; when a ring is full the oldest zones
+// are overwritten. Nothing is recorded until setEnabled(true). Define
+// CODEQUEST_NO_PROFILER to compile PROFILE_ZONE out entirely.
+class Profiler {
+public:
+    static Profiler& instance();
+
+    void setEnabled(bool enabled) { active.store(enabled, std::memory_order_relaxed); }
+    bool isEnabled() const { return active.load(std::memory_order_relaxed); }
+
+    // Name shown for the calling thread in the trace
+    void setThreadName(const std::string& name);
+
+    // Zone names must outlive the profiler, string literals in practice
+    void record(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+
+    // Frame time is the work between these two, so time spent idle in
+    // waitEvent or sleeping for the frame cap does not count
+    void beginFrame();
+    void endFrame();
+    // Frame time in milliseconds at percentile 0..100 over the recent frames
+    float frameTimePercentile(float percentile) const;
+    std::size_t frameCount() const;
+
+    // Writes every recorded zone as Chrome trace JSON (chrome://tracing, Perfetto)
+    bool writeChromeTrace(const std::string& path) const;
+
+private:
+    struct Zone {
+        const char* name;
+        long long start; // microseconds since the profiler was created
+        long long duration;
+    };
+
+    struct ThreadBuffer {
+        std::mutex mutex;
+        std::vector<Zone> zones; // ZonesPerThread, allocated by the first record
+        std::size_t next;
+        bool wrapped;
+        unsigned tid;
+        std::string name;
+
+        ThreadBuffer() : next(0), wrapped(false), tid(0) {}
+    };
+
+    static const std::size_t ZonesPerThread = 1 << 16;
+    static const std::size_t FrameHistory = 600;
+
+    Profiler();
+    ThreadBuffer& threadBuffer();
+    long long micros(std::chrono::steady_clock::time_point time) const;
+
+    std::atomic<bool> active;
+    std::chrono::steady_clock::time_point epoch;
+
+    mutable std::mutex buffersMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+    mutable std::mutex framesMutex;
+    std::chrono::steady_clock::time_point frameStart;
+    std::vector<float> frameTimes; // ring of the last FrameHistory frames, in milliseconds
+    std::size_t frameNext;
+    std::size_t frames;
+};
+
+// Times the enclosing scope as a zone
+class ProfileZone {
+public:
+    explicit ProfileZone(const char* name) : name(Profiler::instance().isEnabled() ? name : nullptr) {
+        if (this->name) start = std::chrono::steady_clock::now();
+    }
+
+    ~ProfileZone() {
+        if (name) Profiler::instance().record(name, start, std::chrono::steady_clock::now());
+    }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    const char* name;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef CODEQUEST_NO_PROFILER
+#define PROFILE_ZONE(name) ((void)0)
+#else
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#endif
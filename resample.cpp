@@ -0,0 +1,221 @@
+#include "resample.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CODEQUEST_RESAMPLE_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Source pixels covered by one output pixel along one axis, with their weights
+struct Span {
+    unsigned first;
+    unsigned count;
+    unsigned weightOffset;
+};
+
+struct Filter {
+    std::vector<Span> spans;
+    std::vector<float> weights;
+};
+
+Filter buildFilter(unsigned srcSize, unsigned dstSize) {
+    Filter filter;
+    filter.spans.resize(dstSize);
+    double scale = static_cast<double>(srcSize) / dstSize;
+
+    for (unsigned i = 0; i < dstSize; ++i) {
+        double begin = i * scale;
+        double end = std::min<double>((i + 1) * scale, srcSize);
+        unsigned first = static_cast<unsigned>(begin);
+        unsigned last = std::min<unsigned>(static_cast<unsigned>(std::ceil(end)), srcSize);
+
+        Span& span = filter.spans[i];
+        span.first = first;
+        span.count = last - first;
+        span.weightOffset = static_cast<unsigned>(filter.weights.size());
+
+        for (unsigned s = first; s < last; ++s) {
+            double overlap = std::min<double>(s + 1, end) - std::max<double>(s, begin);
+            filter.weights.push_back(static_cast<float>(overlap / (end - begin)));
+        }
+    }
+    return filter;
+}
+
+inline sf::Uint8 toByte(float value) {
+    return static_cast<sf::Uint8>(std::min(255.0f, std::max(0.0f, std::nearbyint(value))));
+}
+
+// Vertical pass: blends the rows of one output row into a float row of srcWidth * 4 values
+void blendRowsScalar(const sf::Uint8* src, std::size_t stride, const Span& span, const float* weights, float* out, std::size_t count) {
+    std::fill(out, out + count, 0.0f);
+    for (unsigned k = 0; k < span.count; ++k) {
+        const sf::Uint8* row = src + (span.first + k) * stride;
+        float w = weights[k];
+        for (std::size_t i = 0; i < count; ++i) {
+            out[i] += w * row[i];
+        }
+    }
+}
+
+// Horizontal pass: blends columns of the float row into RGBA8 output pixels
+void blendColumnsScalar(const float* row, const Filter& filter, sf::Uint8* out, unsigned dstWidth) {
+    for (unsigned x = 0; x < dstWidth; ++x) {
+        const Span& span = filter.spans[x];
+        const float* weights = &filter.weights[span.weightOffset];
+        float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        for (unsigned k = 0; k < span.count; ++k) {
+            const float* pixel = row + (span.first + k) * 4;
+            for (int c = 0; c < 4; ++c) {
+                sum[c] += weights[k] * pixel[c];
+            }
+        }
+        for (int c = 0; c < 4; ++c) {
+            out[x * 4 + c] = toByte(sum[c]);
+        }
+    }
+}
+
+#ifdef CODEQUEST_RESAMPLE_X86
+
+__attribute__((target("sse2")))
+void blendRowsSse2(const sf::Uint8* src, std::size_t stride, const Span& span, const float* weights, float* out, std::size_t count) {
+    std::fill(out, out + count, 0.0f);
+    const __m128i zero = _mm_setzero_si128();
+    for (unsigned k = 0; k < span.count; ++k) {
+        const sf::Uint8* row = src + (span.first + k) * stride;
+        __m128 w = _mm_set1_ps(weights[k]);
+        std::size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+            __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+            __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+            __m128 v0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero));
+            __m128 v1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero));
+            __m128 v2 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero));
+            __m128 v3 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero));
+            _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(w, v0)));
+            _mm_storeu_ps(out + i + 4, _mm_add_ps(_mm_loadu_ps(out + i + 4), _mm_mul_ps(w, v1)));
+            _mm_storeu_ps(out + i + 8, _mm_add_ps(_mm_loadu_ps(out + i + 8), _mm_mul_ps(w, v2)));
+            _mm_storeu_ps(out + i + 12, _mm_add_ps(_mm_loadu_ps(out + i + 12), _mm_mul_ps(w, v3)));
+        }
+        for (; i < count; ++i) {
+            out[i] += weights[k] * row[i];
+        }
+    }
+}
+
+// One RGBA pixel is exactly one __m128, shared by the SSE2 and AVX2 paths
+__attribute__((target("sse2")))
+void blendColumnsSse2(const float* row, const Filter& filter, sf::Uint8* out, unsigned dstWidth) {
+    for (unsigned x = 0; x < dstWidth; ++x) {
+        const Span& span = filter.spans[x];
+        const float* weights = &filter.weights[span.weightOffset];
+        __m128 sum = _mm_setzero_ps();
+        for (unsigned k = 0; k < span.count; ++k) {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(row + (span.first + k) * 4)));
+        }
+        __m128i ints = _mm_cvtps_epi32(sum); // rounds to nearest even like nearbyint
+        ints = _mm_packs_epi32(ints, ints);
+        ints = _mm_packus_epi16(ints, ints);
+        int pixel = _mm_cvtsi128_si32(ints);
+        std::copy(reinterpret_cast<const sf::Uint8*>(&pixel), reinterpret_cast<const sf::Uint8*>(&pixel) + 4, out + x * 4);
+    }
+}
+
+__attribute__((target("avx2")))
+void blendRowsAvx2(const sf::Uint8* src, std::size_t stride, const Span& span, const float* weights, float* out, std::size_t count) {
+    std::fill(out, out + count, 0.0f);
+    for (unsigned k = 0; k < span.count; ++k) {
+        const sf::Uint8* row = src + (span.first + k) * stride;
+        __m256 w = _mm256_set1_ps(weights[k]);
+        std::size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m256 v0 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + i))));
+            __m256 v1 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + i + 8))));
+            _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(w, v0)));
+            _mm256_storeu_ps(out + i + 8, _mm256_add_ps(_mm256_loadu_ps(out + i + 8), _mm256_mul_ps(w, v1)));
+        }
+        for (; i < count; ++i) {
+            out[i] += weights[k] * row[i];
+        }
+    }
+}
+
+#endif
+
+} // namespace
+
+ResampleBackend bestResampleBackend() {
+#ifdef CODEQUEST_RESAMPLE_X86
+    static const ResampleBackend best = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return ResampleBackend::Avx2;
+        if (__builtin_cpu_supports("sse2")) return ResampleBackend::Sse2;
+        return ResampleBackend::Scalar;
+    }();
+    return best;
+#else
+    return ResampleBackend::Scalar;
+#endif
+}
+
+const char* resampleBackendName(ResampleBackend backend) {
+    switch (backend) {
+    case ResampleBackend::Sse2: return "sse2";
+    case ResampleBackend::Avx2: return "avx2";
+    default: return "scalar";
+    }
+}
+
+sf::Vector2u fitSize(const sf::Vector2u& image, const sf::Vector2u& area) {
+    if (image.x == 0 || image.y == 0 || (image.x <= area.x && image.y <= area.y)) return image;
+
+    double scale = std::min(static_cast<double>(area.x) / image.x, static_cast<double>(area.y) / image.y);
+    return sf::Vector2u(std::max(1u, static_cast<unsigned>(image.x * scale)),
+                        std::max(1u, static_cast<unsigned>(image.y * scale)));
+}
+
+void resampleArea(const sf::Uint8* src, unsigned srcWidth, unsigned srcHeight,
+                  sf::Uint8* dst, unsigned dstWidth, unsigned dstHeight,
+                  ResampleBackend backend) {
+    if (dstWidth == 0 || dstHeight == 0) return;
+    dstWidth = std::min(dstWidth, srcWidth);
+    dstHeight = std::min(dstHeight, srcHeight);
+
+#ifndef CODEQUEST_RESAMPLE_X86
+    backend = ResampleBackend::Scalar;
+#endif
+
+    Filter columns = buildFilter(srcWidth, dstWidth);
+    Filter rows = buildFilter(srcHeight, dstHeight);
+    std::size_t stride = static_cast<std::size_t>(srcWidth) * 4;
+    std::vector<float> blended(stride);
+
+    for (unsigned y = 0; y < dstHeight; ++y) {
+        const Span& span = rows.spans[y];
+        const float* weights = &rows.weights[span.weightOffset];
+        sf::Uint8* out = dst + static_cast<std::size_t>(y) * dstWidth * 4;
+
+        switch (backend) {
+#ifdef CODEQUEST_RESAMPLE_X86
+        case ResampleBackend::Avx2:
+            blendRowsAvx2(src, stride, span, weights, blended.data(), stride);
+            blendColumnsSse2(blended.data(), columns, out, dstWidth);
+            break;
+        case ResampleBackend::Sse2:
+            blendRowsSse2(src, stride, span, weights, blended.data(), stride);
+            blendColumnsSse2(blended.data(), columns, out, dstWidth);
+            break;
+#endif
+        default:
+            blendRowsScalar(src, stride, span, weights, blended.data(), stride);
+            blendColumnsScalar(blended.data(), columns, out, dstWidth);
+            break;
+        }
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <SFML/Config.hpp>
+#include <SFML/System.hpp>
+
+// Area-averaging (box filter) downscaler for RGBA8 pixels, used to shrink
+// slides that are larger than the area they are displayed in.
+enum class ResampleBackend {
+    Scalar,
+    Sse2,
+    Avx2
+};
+
+// Fastest backend the running CPU supports
+ResampleBackend bestResampleBackend();
+const char* resampleBackendName(ResampleBackend backend);
+
+// Largest size with the image's aspect ratio that fits in area. Never upscales.
+sf::Vector2u fitSize(const sf::Vector2u& image, const sf::Vector2u& area);
+
+// dst must hold dstWidth * dstHeight * 4 bytes. Only downscaling is supported:
+// dstWidth <= srcWidth and dstHeight <= srcHeight.
+void resampleArea(const sf::Uint8* src, unsigned srcWidth, unsigned srcHeight,
+                  sf::Uint8* dst, unsigned dstWidth, unsigned dstHeight,
+                  ResampleBackend backend = bestResampleBackend());
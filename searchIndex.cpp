@@ -0,0 +1,249 @@
+#include "searchIndex.hpp"
+#include <algorithm>
+#include <fstream>
+#include <unordered_set>
+
+namespace {
+
+// Set on the key of a trigram that starts a word, posted in addition to the plain one
+const std::uint32_t WordStart = 1u << 24;
+
+std::string fold(const std::string& text) {
+    std::string folded(text);
+    for (char& c : folded) {
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+    }
+    return folded;
+}
+
+// Non-ASCII bytes count as letters so UTF-8 words stay whole
+bool isWordCharacter(char c) {
+    unsigned char u = static_cast<unsigned char>(c);
+    return u >= 0x80 || (u >= '0' && u <= '9') || (u >= 'a' && u <= 'z');
+}
+
+bool startsWord(const std::string& folded, std::size_t position) {
+    return position == 0 || !isWordCharacter(folded[position - 1]);
+}
+
+std::uint32_t trigram(const std::string& folded, std::size_t position) {
+    return (static_cast<std::uint32_t>(static_cast<unsigned char>(folded[position])) << 16) |
+           (static_cast<std::uint32_t>(static_cast<unsigned char>(folded[position + 1])) << 8) |
+           static_cast<std::uint32_t>(static_cast<unsigned char>(folded[position + 2]));
+}
+
+// Best rank over every occurrence of the query in the text, -1 if it does not occur
+int rankMatch(const std::string& folded, const std::string& query) {
+    int best = -1;
+    for (std::size_t position = folded.find(query); position != std::string::npos; position = folded.find(query, position + 1)) {
+        int rank = position == 0 ? 0 : startsWord(folded, position) ? 1 : 2;
+        if (best < 0 || rank < best) best = rank;
+        if (best <= 1) break;
+    }
+    return best;
+}
+
+// Calls visit for every id in base that is also in all the other lists, in
+// ascending order, until visit returns false
+template<typename Visit>
+void intersect(const std::vector<std::uint32_t>& base, const std::vector<const std::vector<std::uint32_t>*>& others, Visit visit) {
+    std::vector<std::vector<std::uint32_t>::const_iterator> cursors;
+    for (const auto* list : others) cursors.push_back(list->begin());
+
+    for (std::uint32_t id : base) {
+        bool inAll = true;
+        for (std::size_t i = 0; i < others.size(); ++i) {
+            cursors[i] = std::lower_bound(cursors[i], others[i]->end(), id);
+            if (cursors[i] == others[i]->end()) return;
+            if (*cursors[i] != id) {
+                inAll = false;
+                break;
+            }
+        }
+        if (inAll && !visit(id)) return;
+    }
+}
+
+} // namespace
+
+const std::size_t SearchIndex::MinQueryLength;
+const std::uint32_t SearchIndex::None;
+const std::size_t SearchIndex::MaxCandidates;
+
+std::unordered_map<std::string, std::string> SearchIndex::readCaptions(const std::string& path) {
+    std::unordered_map<std::string, std::string> result;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        std::size_t tab = line.find('\t');
+        if (tab == std::string::npos || tab == 0 || tab + 1 == line.size()) continue;
+        result[line.substr(0, tab)] = line.substr(tab + 1);
+    }
+    return result;
+}
+
+void SearchIndex::syncTopic(int topic, const std::string& title, const std::vector<std::string>& imageNames) {
+    if (topic < 0) return;
+    if (topic >= static_cast<int>(topics.size())) topics.resize(topic + 1);
+
+    TopicEntries* t = &topics[topic];
+    if (t->title == None || entries[t->title].text != title) {
+        if (t->title != None) remove(t->title);
+        t->title = add(Kind::Topic, topic, std::string(), title);
+    }
+
+    std::unordered_set<std::string> wanted(imageNames.begin(), imageNames.end());
+    for (auto it = t->images.begin(); it != t->images.end();) {
+        if (wanted.count(it->first)) {
+            ++it;
+            continue;
+        }
+        remove(it->second);
+        auto caption = t->captions.find(it->first);
+        if (caption != t->captions.end()) {
+            remove(caption->second);
+            t->captions.erase(caption);
+        }
+        it = t->images.erase(it);
+    }
+
+    for (const auto& imageName : imageNames) {
+        if (t->images.count(imageName)) continue;
+        t->images.emplace(imageName, add(Kind::Image, topic, imageName, imageName));
+
+        auto caption = captions.find(imageName);
+        if (caption != captions.end()) {
+            t->captions.emplace(imageName, add(Kind::Caption, topic, imageName, caption->second));
+        }
+    }
+
+    rebuildIfSparse();
+}
+
+std::vector<SearchIndex::Result> SearchIndex::query(const std::string& text, std::size_t limit) const {
+    std::vector<Result> results;
+    std::string folded = fold(text);
+    if (folded.size() < MinQueryLength || limit == 0) return results;
+
+    // Posting lists of the query's trigrams, shortest first; a missing one means no match
+    std::vector<std::uint32_t> keys;
+    for (std::size_t i = 0; i + 2 < folded.size(); ++i) keys.push_back(trigram(folded, i));
+    std::uint32_t first = keys.front();
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    std::vector<const std::vector<std::uint32_t>*> lists;
+    for (std::uint32_t key : keys) {
+        auto found = postings.find(key);
+        if (found == postings.end()) return results;
+        lists.push_back(&found->second);
+    }
+    std::sort(lists.begin(), lists.end(), [](const std::vector<std::uint32_t>* a, const std::vector<std::uint32_t>* b) {
+        return a->size() < b->size();
+    });
+
+    std::vector<Hit> hits;
+    std::size_t prefixHits = 0;
+    auto check = [&](std::uint32_t id) {
+        const Entry& entry = entries[id];
+        if (!entry.live) return true;
+        int rank = rankMatch(entry.folded, folded);
+        if (rank < 0) return true;
+        hits.push_back(Hit{id, rank});
+        if (rank <= 1) prefixHits++;
+        return hits.size() < MaxCandidates;
+    };
+
+    // Entries where a word starts with the query are among those where a word
+    // starts with its first trigram; walking the shortest list, check those first
+    auto starts = postings.find(first | WordStart);
+    if (starts != postings.end()) {
+        std::vector<const std::vector<std::uint32_t>*> prefixLists(lists);
+        prefixLists.push_back(&starts->second);
+        std::sort(prefixLists.begin(), prefixLists.end(), [](const std::vector<std::uint32_t>* a, const std::vector<std::uint32_t>* b) {
+            return a->size() < b->size();
+        });
+        std::vector<const std::vector<std::uint32_t>*> others(prefixLists.begin() + 1, prefixLists.end());
+        intersect(*prefixLists.front(), others, check);
+    }
+
+    // Then matches anywhere, unless the word prefixes already fill the results
+    if (prefixHits < limit && hits.size() < MaxCandidates) {
+        std::unordered_set<std::uint32_t> seen;
+        for (const Hit& hit : hits) seen.insert(hit.id);
+        std::vector<const std::vector<std::uint32_t>*> others(lists.begin() + 1, lists.end());
+        intersect(*lists.front(), others, [&](std::uint32_t id) {
+            return seen.count(id) ? true : check(id);
+        });
+    }
+
+    std::size_t count = std::min(limit, hits.size());
+    std::partial_sort(hits.begin(), hits.begin() + count, hits.end(), [this](const Hit& a, const Hit& b) {
+        const Entry& x = entries[a.id];
+        const Entry& y = entries[b.id];
+        if (a.rank != b.rank) return a.rank < b.rank;
+        if (x.kind != y.kind) return x.kind < y.kind;
+        if (x.text.size() != y.text.size()) return x.text.size() < y.text.size();
+        return a.id < b.id;
+    });
+
+    for (std::size_t i = 0; i < count; ++i) {
+        const Entry& entry = entries[hits[i].id];
+        results.push_back(Result{entry.kind, entry.topic, entry.imageName, entry.text});
+    }
+    return results;
+}
+
+std::uint32_t SearchIndex::add(Kind kind, int topic, const std::string& imageName, const std::string& text) {
+    std::uint32_t id = static_cast<std::uint32_t>(entries.size());
+    entries.push_back(Entry{kind, topic, imageName, text, fold(text), true});
+    liveCount++;
+    post(id);
+    return id;
+}
+
+// Ids only grow between rebuilds, so appending keeps every list sorted
+void SearchIndex::post(std::uint32_t id) {
+    const std::string& folded = entries[id].folded;
+    for (std::size_t i = 0; i + 2 < folded.size(); ++i) {
+        std::uint32_t key = trigram(folded, i);
+        std::vector<std::uint32_t>& list = postings[key];
+        if (list.empty() || list.back() != id) list.push_back(id);
+        if (startsWord(folded, i)) {
+            std::vector<std::uint32_t>& starts = postings[key | WordStart];
+            if (starts.empty() || starts.back() != id) starts.push_back(id);
+        }
+    }
+}
+
+void SearchIndex::remove(std::uint32_t id) {
+    if (!entries[id].live) return;
+    entries[id].live = false;
+    liveCount--;
+}
+
+// Drops removed entries once they outnumber the live ones
+void SearchIndex::rebuildIfSparse() {
+    std::size_t dead = entries.size() - liveCount;
+    if (dead < 1024 || dead < liveCount) return;
+
+    std::vector<std::uint32_t> renumbered(entries.size(), None);
+    std::vector<Entry> live;
+    live.reserve(liveCount);
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        if (!entries[i].live) continue;
+        renumbered[i] = static_cast<std::uint32_t>(live.size());
+        live.push_back(std::move(entries[i]));
+    }
+    entries.swap(live);
+
+    for (TopicEntries& t : topics) {
+        if (t.title != None) t.title = renumbered[t.title];
+        for (auto& image : t.images) image.second = renumbered[image.second];
+        for (auto& caption : t.captions) caption.second = renumbered[caption.second];
+    }
+
+    postings.clear();
+    for (std::uint32_t id = 0; id < entries.size(); ++id) post(id);
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// In-memory trigram index over topic titles, image names and slide captions
+// for type-ahead search. Every entry is posted under each three-character
+// window of its lowercased text; a query intersects the posting lists of its
+// own trigrams and only checks the entries that survive. Entries are added and
+// removed as topics change, removed ones are skipped until a rebuild drops them.
+class SearchIndex {
+public:
+    enum class Kind { Topic, Image, Caption };
+
+    struct Result {
+        Kind kind;
+        int topic;
+        std::string imageName; // empty for a topic
+        std::string text;      // the text that matched
+    };
+
+    // Shorter queries have no trigram to look up
+    static const std::size_t MinQueryLength = 3;
+
+    SearchIndex() : liveCount(0) {}
+
+    // Captions by image name, one "image.png<TAB>caption" per line
+    static std::unordered_map<std::string, std::string> readCaptions(const std::string& path);
+    // Applies to images synced from now on
+    void setCaptions(std::unordered_map<std::string, std::string> imageCaptions) { captions.swap(imageCaptions); }
+
+    // Brings one topic's title and images in line, touching only what changed
+    void syncTopic(int topic, const std::string& title, const std::vector<std::string>& imageNames);
+
+    // Case-insensitive. Matches at the start of the text rank first, then at
+    // the start of a word, then anywhere; topics before slides and shorter
+    // texts first. Common queries are ranked among the first MaxCandidates hits.
+    std::vector<Result> query(const std::string& text, std::size_t limit = 8) const;
+
+    std::size_t size() const { return liveCount; }
+
+private:
+    static const std::uint32_t None = 0xFFFFFFFFu;
+    static const std::size_t MaxCandidates = 256;
+
+    struct Entry {
+        Kind kind;
+        int topic;
+        std::string imageName;
+        std::string text;
+        std::string folded; // lowercased text the trigrams come from
+        bool live;
+    };
+
+    struct TopicEntries {
+        std::uint32_t title;
+        std::unordered_map<std::string, std::uint32_t> images;   // entry ids by image name
+        std::unordered_map<std::string, std::uint32_t> captions; // entry ids by image name
+
+        TopicEntries() : title(None) {}
+    };
+
+    struct Hit {
+        std::uint32_t id;
+        int rank; // 0 text prefix, 1 word prefix, 2 anywhere
+    };
+
+    std::uint32_t add(Kind kind, int topic, const std::string& imageName, const std::string& text);
+    void remove(std::uint32_t id);
+    void post(std::uint32_t id);
+    void rebuildIfSparse();
+
+    std::vector<Entry> entries;
+    std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> postings; // ids ascending
+    std::vector<TopicEntries> topics;
+    std::unordered_map<std::string, std::string> captions;
+    std::size_t liveCount;
+};
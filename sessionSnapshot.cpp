@@ -0,0 +1,167 @@
+#include "sessionSnapshot.hpp"
+#include "logger.hpp"
+#include "profiler.hpp"
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+const std::size_t SessionSnapshot::MaxImages;
+
+namespace {
+
+std::size_t padded(std::size_t length) {
+    return (length + 7) & ~static_cast<std::size_t>(7);
+}
+
+bool writePadded(std::FILE* file, const std::string& text) {
+    static const char zeros[8] = {};
+    return std::fwrite(text.data(), 1, text.size(), file) == text.size() &&
+           std::fwrite(zeros, 1, padded(text.size()) - text.size(), file) == padded(text.size()) - text.size();
+}
+
+} // namespace
+
+bool SessionSnapshot::open(const std::string& path) {
+    PROFILE_ZONE("session open");
+    close();
+    if (!file.open(path)) return false;
+
+    SessionHeader header;
+    if (file.size() < sizeof(header)) {
+        close();
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, SessionMagic, sizeof(SessionMagic)) != 0 || header.version != SessionVersion) {
+        LOG_WARNING("Ignoring unreadable session: " << path);
+        close();
+        return false;
+    }
+
+    std::size_t position = sizeof(header);
+    if (position + padded(header.topicNameLength) + padded(header.imageNameLength) > file.size()) {
+        close();
+        return false;
+    }
+    saved.topicName.assign(reinterpret_cast<const char*>(file.data() + position), header.topicNameLength);
+    position += padded(header.topicNameLength);
+    saved.imageName.assign(reinterpret_cast<const char*>(file.data() + position), header.imageNameLength);
+    position += padded(header.imageNameLength);
+    saved.topic = header.topic;
+    saved.image = header.image;
+    saved.firstVisibleTopic = header.firstVisibleTopic;
+    saved.buttonsVisible = (header.flags & SessionButtonsVisible) != 0;
+
+    // A truncated file keeps the images that are whole
+    for (std::uint32_t i = 0; i < header.imageCount; ++i) {
+        SessionImageHeader imageHeader;
+        if (position + sizeof(imageHeader) > file.size()) break;
+        std::memcpy(&imageHeader, file.data() + position, sizeof(imageHeader));
+        position += sizeof(imageHeader);
+
+        std::size_t pixelBytes = static_cast<std::size_t>(imageHeader.width) * imageHeader.height * 4;
+        if (position + padded(imageHeader.nameLength) + pixelBytes > file.size()) break;
+
+        Entry entry;
+        entry.image.imageName.assign(reinterpret_cast<const char*>(file.data() + position), imageHeader.nameLength);
+        position += padded(imageHeader.nameLength);
+        entry.image.pixels = file.data() + position;
+        entry.image.size = sf::Vector2u(imageHeader.width, imageHeader.height);
+        entry.image.sourceSize = sf::Vector2u(imageHeader.sourceWidth, imageHeader.sourceHeight);
+        entry.sourceSize = imageHeader.sourceSize;
+        entry.sourceMtime = imageHeader.sourceMtime;
+        position += pixelBytes;
+
+        if (pixelBytes > 0) images[entry.image.imageName] = entry;
+    }
+
+    return true;
+}
+
+void SessionSnapshot::close() {
+    images.clear();
+    saved = SessionState();
+    file.close();
+}
+
+std::vector<std::string> SessionSnapshot::imageNames() const {
+    std::vector<std::string> names;
+    for (const auto& image : images) names.push_back(image.first);
+    return names;
+}
+
+const SessionImage* SessionSnapshot::find(const std::string& imageName) const {
+    auto found = images.find(imageName);
+    if (found == images.end()) return nullptr;
+
+    // The slide was replaced after the session was saved
+    struct stat info;
+    if (stat(("images/" + imageName).c_str(), &info) != 0 ||
+        static_cast<std::uint64_t>(info.st_size) != found->second.sourceSize ||
+        static_cast<std::int64_t>(info.st_mtime) != found->second.sourceMtime) {
+        return nullptr;
+    }
+    return &found->second.image;
+}
+
+bool SessionSnapshot::write(const std::string& path, const SessionState& state, const std::vector<SessionImage>& images) {
+    PROFILE_ZONE("session write");
+    std::string temporaryPath = path + ".tmp";
+    std::FILE* file = std::fopen(temporaryPath.c_str(), "wb");
+    if (!file) {
+        LOG_ERROR("Could not write session: " << temporaryPath);
+        return false;
+    }
+
+    std::vector<std::pair<SessionImageHeader, const SessionImage*>> written;
+    for (const SessionImage& image : images) {
+        struct stat info;
+        if (written.size() >= MaxImages || !image.pixels || stat(("images/" + image.imageName).c_str(), &info) != 0) continue;
+
+        SessionImageHeader imageHeader = {};
+        imageHeader.sourceSize = static_cast<std::uint64_t>(info.st_size);
+        imageHeader.sourceMtime = static_cast<std::int64_t>(info.st_mtime);
+        imageHeader.width = image.size.x;
+        imageHeader.height = image.size.y;
+        imageHeader.sourceWidth = image.sourceSize.x;
+        imageHeader.sourceHeight = image.sourceSize.y;
+        imageHeader.nameLength = static_cast<std::uint32_t>(image.imageName.size());
+        written.push_back(std::make_pair(imageHeader, &image));
+    }
+
+    SessionHeader header = {};
+    std::memcpy(header.magic, SessionMagic, sizeof(SessionMagic));
+    header.version = SessionVersion;
+    header.imageCount = static_cast<std::uint32_t>(written.size());
+    header.topic = state.topic;
+    header.image = state.image;
+    header.firstVisibleTopic = state.firstVisibleTopic;
+    header.flags = state.buttonsVisible ? SessionButtonsVisible : 0;
+    header.topicNameLength = static_cast<std::uint32_t>(state.topicName.size());
+    header.imageNameLength = static_cast<std::uint32_t>(state.imageName.size());
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 && writePadded(file, state.topicName) && writePadded(file, state.imageName);
+    for (const auto& image : written) {
+        if (!ok) break;
+        std::size_t pixelBytes = static_cast<std::size_t>(image.first.width) * image.first.height * 4;
+        ok = std::fwrite(&image.first, sizeof(image.first), 1, file) == 1 && writePadded(file, image.second->imageName) &&
+             std::fwrite(image.second->pixels, 1, pixelBytes, file) == pixelBytes;
+    }
+    ok = std::fclose(file) == 0 && ok;
+
+    if (!ok) {
+        LOG_ERROR("Could not write session: " << temporaryPath);
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+
+    // rename replaces the old session atomically where it can, Windows needs it removed first
+    if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        std::remove(path.c_str());
+        if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+            LOG_ERROR("Failed to replace file: " << path);
+            return false;
+        }
+    }
+    return true;
+}
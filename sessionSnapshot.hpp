@@ -0,0 +1,92 @@
+#pragma once
+#include <SFML/System.hpp>
+#include "mappedFile.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Where the user left off. Topics are looked up by name first since lists can
+// be added or removed between runs; the indices are the fallback.
+struct SessionState {
+    std::string topicName;
+    std::string imageName;     // slide on screen
+    std::uint32_t topic;
+    std::uint32_t image;
+    std::uint32_t firstVisibleTopic; // sidebar scroll
+    bool buttonsVisible;
+
+    SessionState() : topic(0), image(0), firstVisibleTopic(0), buttonsVisible(true) {}
+};
+
+// Texture pixels of a recently viewed slide, already fitted to the window
+struct SessionImage {
+    std::string imageName;
+    const sf::Uint8* pixels; // width * height RGBA
+    sf::Vector2u size;
+    sf::Vector2u sourceSize;
+};
+
+// On-disk layout of session.bin, written on exit:
+//   SessionHeader, the topic and image names, then per image a
+//   SessionImageHeader, its name padded to 8 bytes and its raw pixels.
+// Pixels are kept as they were on the GPU so the next start uploads them
+// straight from the mapping without decoding anything.
+struct SessionHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t imageCount;
+    std::uint32_t topic;
+    std::uint32_t image;
+    std::uint32_t firstVisibleTopic;
+    std::uint32_t flags;
+    std::uint32_t topicNameLength;
+    std::uint32_t imageNameLength;
+};
+
+struct SessionImageHeader {
+    std::uint64_t sourceSize;  // of images/<name>, to drop pixels of a changed file
+    std::int64_t sourceMtime;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t sourceWidth;
+    std::uint32_t sourceHeight;
+    std::uint32_t nameLength;
+    std::uint32_t reserved;
+};
+
+const char SessionMagic[8] = {'C', 'Q', 'S', 'E', 'S', 'S', '0', '1'};
+const std::uint32_t SessionVersion = 1;
+const std::uint32_t SessionButtonsVisible = 1;
+
+class SessionSnapshot {
+public:
+    // Slides whose pixels are kept, the one on screen first
+    static const std::size_t MaxImages = 6;
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return file.isOpen(); }
+
+    const SessionState& state() const { return saved; }
+    std::vector<std::string> imageNames() const;
+
+    // Pixels saved for an image, nullptr if there are none or the file changed since.
+    // Valid until close.
+    const SessionImage* find(const std::string& imageName) const;
+
+    // Writes next to path and renames over it, so a crash never leaves half a session
+    static bool write(const std::string& path, const SessionState& state, const std::vector<SessionImage>& images);
+
+private:
+    struct Entry {
+        SessionImage image;
+        std::uint64_t sourceSize;
+        std::int64_t sourceMtime;
+    };
+
+    MappedFile file;
+    SessionState saved;
+    std::unordered_map<std::string, Entry> images;
+};
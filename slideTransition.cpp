@@ -0,0 +1,173 @@
+#include "slideTransition.hpp"
+#include "logger.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <cmath>
+
+const sf::Int32 SlideTransition::DurationMs;
+const sf::Int32 SlideTransition::MaxWaitMs;
+const std::size_t SlideTransition::FrameHistory;
+
+namespace {
+
+// The outgoing buffer is the sprite's own texture, the incoming one a second
+// sampler with the same coordinates since both buffers are the same size
+const char* const BlendShader =
+    "uniform sampler2D outgoing;\n"
+    "uniform sampler2D incoming;\n"
+    "uniform float progress;\n"
+    "uniform float push;\n"
+    "uniform float direction;\n"
+    "void main() {\n"
+    "    vec2 uv = gl_TexCoord[0].xy;\n"
+    "    if (push > 0.5) {\n"
+    "        float x = uv.x + direction * progress;\n"
+    "        if (x >= 0.0 && x <= 1.0)\n"
+    "            gl_FragColor = texture2D(outgoing, vec2(x, uv.y));\n"
+    "        else\n"
+    "            gl_FragColor = texture2D(incoming, vec2(x - direction, uv.y));\n"
+    "    } else {\n"
+    "        gl_FragColor = mix(texture2D(outgoing, uv), texture2D(incoming, uv), progress);\n"
+    "    }\n"
+    "}\n";
+
+} // namespace
+
+SlideTransition::SlideTransition()
+    : hasShader(false), buffersReady(false), state(State::Idle), style(Style::Crossfade), direction(1), progress(0.0f),
+      ranThisFrame(false), frameNext(0), frames(0) {
+    if (sf::Shader::isAvailable() && shader.loadFromMemory(BlendShader, sf::Shader::Fragment)) {
+        hasShader = true;
+        shader.setUniform("outgoing", sf::Shader::CurrentTexture);
+    } else {
+        LOG_INFO("Slide transitions without shaders, drawn as two quads");
+    }
+}
+
+void SlideTransition::setArea(const sf::FloatRect& viewArea, const sf::Vector2u& size) {
+    area = viewArea;
+    if (size == pixels && buffersReady) return;
+
+    skip(); // the buffers are reallocated
+    pixels = size;
+    buffersReady = pixels.x > 0 && pixels.y > 0 && buffers[0].create(pixels.x, pixels.y) && buffers[1].create(pixels.x, pixels.y);
+    if (buffersReady) {
+        buffers[0].setSmooth(true);
+        buffers[1].setSmooth(true);
+        if (hasShader) shader.setUniform("incoming", buffers[1].getTexture());
+    }
+}
+
+void SlideTransition::start(const sf::Drawable& outgoing, Style transitionStyle, int towards) {
+    if (state != State::Idle || !buffersReady) {
+        skip();
+        return;
+    }
+    render(buffers[0], outgoing);
+    style = transitionStyle;
+    direction = towards < 0 ? -1 : 1;
+    progress = 0.0f;
+    state = State::Waiting;
+    ranThisFrame = true;
+    clock.restart();
+}
+
+void SlideTransition::setIncoming(const sf::Drawable& incoming) {
+    if (state != State::Waiting) return;
+    render(buffers[1], incoming);
+    state = State::Running;
+    ranThisFrame = true;
+    clock.restart();
+}
+
+void SlideTransition::skip() {
+    state = State::Idle;
+}
+
+bool SlideTransition::update() {
+    if (state == State::Waiting && clock.getElapsedTime() >= sf::milliseconds(MaxWaitMs)) {
+        skip(); // still decoding, show it as the window did before
+    }
+    if (state != State::Running) return isActive();
+
+    ranThisFrame = true;
+    float t = std::min(clock.getElapsedTime().asMilliseconds() / static_cast<float>(DurationMs), 1.0f);
+    progress = t * t * (3.0f - 2.0f * t); // ease in and out
+    if (t >= 1.0f) {
+        state = State::Idle;
+        return false;
+    }
+    if (hasShader) {
+        shader.setUniform("progress", progress);
+        shader.setUniform("push", style == Style::Push ? 1.0f : 0.0f);
+        shader.setUniform("direction", static_cast<float>(direction));
+    }
+    return true;
+}
+
+void SlideTransition::recordFrame(sf::Time work) {
+    if (!ranThisFrame) return;
+    ranThisFrame = false;
+
+    float milliseconds = work.asMicroseconds() / 1000.0f;
+    if (frameTimes.size() < FrameHistory) {
+        frameTimes.push_back(milliseconds);
+    } else {
+        frameTimes[frameNext] = milliseconds;
+    }
+    frameNext = (frameNext + 1) % FrameHistory;
+    ++frames;
+}
+
+float SlideTransition::frameTimePercentile(float percentile) const {
+    if (frameTimes.empty()) return 0.0f;
+
+    // Nearest rank
+    std::vector<float> sorted = frameTimes;
+    std::size_t rank = static_cast<std::size_t>(std::ceil(percentile / 100.0f * sorted.size()));
+    rank = std::min(std::max<std::size_t>(rank, 1), sorted.size()) - 1;
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+void SlideTransition::render(sf::RenderTexture& buffer, const sf::Drawable& slide) {
+    PROFILE_ZONE("render transition frame");
+    buffer.setView(sf::View(area));
+    buffer.clear();
+    buffer.draw(slide);
+    buffer.display();
+}
+
+void SlideTransition::draw(sf::RenderTarget& target, sf::RenderStates states) const {
+    if (!buffersReady || state == State::Idle) return;
+
+    sf::Sprite outgoing(buffers[0].getTexture());
+    outgoing.setPosition(area.left, area.top);
+    outgoing.setScale(area.width / pixels.x, area.height / pixels.y);
+    if (state == State::Waiting) {
+        target.draw(outgoing, states);
+        return;
+    }
+
+    if (hasShader) {
+        states.shader = &shader;
+        target.draw(outgoing, states);
+        return;
+    }
+
+    sf::Sprite incoming(buffers[1].getTexture());
+    incoming.setScale(outgoing.getScale());
+    if (style == Style::Push) {
+        // Slid across the sidebar, which is drawn over it
+        float offset = area.width * progress * direction;
+        outgoing.setPosition(area.left - offset, area.top);
+        incoming.setPosition(area.left - offset + area.width * direction, area.top);
+        target.draw(outgoing, states);
+        target.draw(incoming, states);
+    } else {
+        incoming.setPosition(area.left, area.top);
+        incoming.setColor(sf::Color(255, 255, 255, static_cast<sf::Uint8>(progress * 255)));
+        target.draw(outgoing, states);
+        target.draw(incoming, states);
+    }
+}
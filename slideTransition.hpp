@@ -0,0 +1,73 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstddef>
+#include <vector>
+
+// Animates a change of slide between two pre-rendered frames. Each slide is
+// drawn once into a render texture the size of the slide area, the outgoing
+// one when the slide changes and the incoming one as soon as its texture is
+// resident; every frame of the animation after that is a single quad blended
+// in a fragment shader, whatever the size of the slides. Without shader
+// support it falls back to two quads.
+class SlideTransition : public sf::Drawable {
+public:
+    enum class Style {
+        Crossfade,
+        Push // the incoming slide pushes the outgoing one out sideways
+    };
+
+    static const sf::Int32 DurationMs = 250;
+    // The outgoing slide stays up this long while the incoming one is decoded
+    static const sf::Int32 MaxWaitMs = 500;
+    static const std::size_t FrameHistory = 600;
+
+    SlideTransition();
+
+    // Where the slides are drawn, in view coordinates, and its size in pixels
+    void setArea(const sf::FloatRect& viewArea, const sf::Vector2u& pixels);
+
+    // Renders the slide leaving the screen, drawn as it would be in the window,
+    // and waits for the incoming one. direction is 1 towards the next slide and
+    // -1 towards the previous one. A start while a transition is still running
+    // ends it instead, so rapid clicks go straight to their target.
+    void start(const sf::Drawable& outgoing, Style style, int direction);
+    // Renders the incoming slide and starts the animation
+    void setIncoming(const sf::Drawable& incoming);
+    void skip();
+
+    bool isActive() const { return state != State::Idle; }
+    bool isWaiting() const { return state == State::Waiting; }
+
+    // Advances the animation; returns false once it is over
+    bool update();
+
+    // Work time of a frame (see Profiler::beginFrame); kept if a transition ran during it
+    void recordFrame(sf::Time work);
+    // In milliseconds at percentile 0..100 over the recent transition frames
+    float frameTimePercentile(float percentile) const;
+    std::size_t frameCount() const { return frames; }
+
+private:
+    enum class State { Idle, Waiting, Running };
+
+    void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
+    void render(sf::RenderTexture& buffer, const sf::Drawable& slide);
+
+    sf::RenderTexture buffers[2]; // outgoing, incoming
+    sf::Shader shader;
+    bool hasShader;
+    sf::FloatRect area;
+    sf::Vector2u pixels;
+    bool buffersReady;
+
+    State state;
+    Style style;
+    int direction;
+    float progress;
+    sf::Clock clock;
+
+    bool ranThisFrame;
+    std::vector<float> frameTimes; // ring of the last FrameHistory transition frames
+    std::size_t frameNext;
+    std::size_t frames;
+};
@@ -0,0 +1,519 @@
+#include "textureCache.hpp"
+#include "assetArchive.hpp"
+#include "imageDecoder.hpp"
+#include "logger.hpp"
+#include "profiler.hpp"
+#include "resample.hpp"
+#include "threadPool.hpp"
+#include <algorithm>
+#include <iterator>
+#include <sys/stat.h>
+
+const std::size_t ImageHandle::npos;
+const std::size_t TextureCache::DefaultByteBudget;
+
+namespace {
+
+// The original or one of its transcoded copies, whichever decodeImage would read
+bool hasImageFile(const std::string& imageName) {
+    struct stat info;
+    std::string path = "images/" + imageName;
+    if (stat(path.c_str(), &info) == 0) return true;
+    for (const char* extension : TranscodedExtensions) {
+        if (stat((path + extension).c_str(), &info) == 0) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+TextureCache::Decoded::~Decoded() {
+    DecoderRegistry::instance().pool().release(std::move(pixels));
+}
+
+TextureCache::TextureCache(std::size_t byteBudget, ThreadPool* decoder)
+    : budget(byteBudget), resident(0), shared(0), decoder(decoder), archive(nullptr), maxTextureSize(0), decodedQueue(std::make_shared<DecodedQueue>()),
+      requestedCount(0), uploadedCount(0), failedCount(0), cancelledCount(0) {}
+
+ImageHandle TextureCache::acquire(const std::string& imageName, std::uint64_t contentHash) {
+    auto found = idsByName.find(imageName);
+    if (found != idsByName.end()) {
+        entries[found->second].refs++;
+        return ImageHandle(found->second);
+    }
+
+    // Same bytes under another name: one decode, one texture
+    if (contentHash != 0) {
+        auto same = idsByHash.find(contentHash);
+        if (same != idsByHash.end()) {
+            Entry& entry = entries[same->second];
+            entry.refs++;
+            entry.aliases.push_back(imageName);
+            idsByName.emplace(imageName, same->second);
+            ++shared;
+            return ImageHandle(same->second);
+        }
+    }
+
+    std::size_t id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    } else {
+        id = entries.size();
+        entries.emplace_back();
+        entries[id].generation = 0;
+    }
+
+    Entry& entry = entries[id];
+    entry.imageName = imageName;
+    entry.aliases.clear();
+    entry.contentHash = contentHash;
+    entry.bytes = 0;
+    entry.refs = 1;
+    entry.state = State::Unloaded;
+    entry.stale = false;
+    entry.refreshing = false;
+    entry.sourceSize = sf::Vector2u();
+    entry.lruPosition = lru.end();
+
+    idsByName.emplace(imageName, id);
+    if (contentHash != 0) idsByHash.emplace(contentHash, id);
+    return ImageHandle(id);
+}
+
+void TextureCache::release(ImageHandle handle) {
+    if (!handle.isValid() || handle.id >= entries.size()) return;
+
+    Entry& entry = entries[handle.id];
+    if (entry.refs == 0 || --entry.refs > 0) return;
+
+    if (entry.state == State::Decoding) {
+        // The decode still completes, uploadPending drops it by generation
+        ++cancelledCount;
+    }
+    evict(handle.id); // cancels a refit in flight
+    idsByName.erase(entry.imageName);
+    for (const auto& alias : entry.aliases) {
+        idsByName.erase(alias);
+    }
+    auto byHash = idsByHash.find(entry.contentHash);
+    if (byHash != idsByHash.end() && byHash->second == handle.id) idsByHash.erase(byHash);
+    entry.imageName.clear();
+    entry.aliases.clear();
+    entry.contentHash = 0;
+    entry.state = State::Unloaded;
+    entry.generation++;
+    freeIds.push_back(handle.id);
+}
+
+const sf::Texture* TextureCache::get(ImageHandle handle) {
+    if (!handle.isValid() || handle.id >= entries.size()) return nullptr;
+
+    Entry& entry = entries[handle.id];
+    switch (entry.state) {
+    case State::Resident:
+        touch(handle.id);
+        if (entry.stale && !entry.refreshing) {
+            // Keep drawing the old texture until the refitted one is uploaded
+            entry.refreshing = true;
+            if (decoder) {
+                queueDecode(handle.id);
+            } else {
+                load(handle.id);
+            }
+        }
+        return entry.texture.get();
+    case State::Unloaded:
+        if (decoder) {
+            request(handle);
+            return nullptr;
+        }
+        return load(handle.id) ? entry.texture.get() : nullptr;
+    default:
+        return nullptr;
+    }
+}
+
+void TextureCache::request(ImageHandle handle) {
+    if (!handle.isValid() || handle.id >= entries.size()) return;
+
+    Entry& entry = entries[handle.id];
+    if (entry.state != State::Unloaded) return;
+    if (!decoder) {
+        load(handle.id);
+        return;
+    }
+
+    entry.state = State::Decoding;
+    queueDecode(handle.id);
+}
+
+void TextureCache::cancel(ImageHandle handle) {
+    if (!handle.isValid() || handle.id >= entries.size()) return;
+
+    Entry& entry = entries[handle.id];
+    if (entry.state != State::Decoding) return;
+
+    if (entry.cancelled) *entry.cancelled = true;
+    entry.cancelled.reset();
+    entry.state = State::Unloaded;
+    entry.generation++; // drops the result if the decode already started
+    ++cancelledCount;
+}
+
+bool TextureCache::reload(const std::string& imageName) {
+    auto found = idsByName.find(imageName);
+    if (found == idsByName.end()) return false;
+
+    std::size_t id = found->second;
+    Entry& entry = entries[id];
+
+    // The file no longer matches the hash it was shared by
+    auto byHash = idsByHash.find(entry.contentHash);
+    if (byHash != idsByHash.end() && byHash->second == id) idsByHash.erase(byHash);
+    entry.contentHash = 0;
+    if (imageName != entry.imageName) {
+        // Handles already given out keep the shared texture, a new acquire decodes the file itself
+        idsByName.erase(found);
+        entry.aliases.erase(std::find(entry.aliases.begin(), entry.aliases.end(), imageName));
+        LOG_WARNING("Changed image no longer matches " << entry.imageName << ", shown from its own file once its topic is reloaded: " << imageName);
+        return true;
+    }
+
+    switch (entry.state) {
+    case State::Resident:
+    case State::Decoding:
+        // A decode in flight may have read the old or a half-written file
+        if (entry.state == State::Decoding || entry.refreshing) {
+            if (entry.cancelled) *entry.cancelled = true;
+            entry.generation++;
+            ++cancelledCount;
+        }
+        if (entry.state == State::Resident) entry.refreshing = true;
+        if (decoder) {
+            queueDecode(id);
+        } else {
+            load(id);
+        }
+        break;
+    case State::Failed:
+        entry.state = State::Unloaded;
+        request(ImageHandle(id));
+        break;
+    case State::Unloaded:
+        break; // the next decode reads the new file anyway
+    }
+    return true;
+}
+
+void TextureCache::queueDecode(std::size_t id) {
+    promoteSurvivingAlias(id);
+    Entry& entry = entries[id];
+    ++requestedCount;
+
+    std::shared_ptr<DecodedQueue> queue = decodedQueue;
+    unsigned generation = entry.generation;
+
+    // Raw archive blocks that already fit need no decoding and go straight to the upload queue
+    const PackedImage* packed = archive ? archive->find(entry.imageName) : nullptr;
+    sf::Vector2u fitArea = decodeArea();
+    if (packed && packed->compression == PackRaw && fitSize(sf::Vector2u(packed->width, packed->height), fitArea) == sf::Vector2u(packed->width, packed->height)) {
+        Decoded decoded;
+        decoded.id = id;
+        decoded.generation = generation;
+        decoded.packed = packed;
+        decoded.size = sf::Vector2u(packed->width, packed->height);
+        decoded.sourceSize = decoded.size;
+        queue->decoded++;
+
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->items.push_back(std::move(decoded));
+        return;
+    }
+
+    std::string imageName = entry.imageName;
+    const AssetArchive* assetArchive = archive;
+    std::shared_ptr<std::atomic<bool>> cancelled = std::make_shared<std::atomic<bool>>(false);
+    entry.cancelled = cancelled;
+    decoder->submit([queue, id, generation, imageName, assetArchive, fitArea, cancelled] {
+        if (*cancelled) return;
+
+        Decoded decoded;
+        decoded.id = id;
+        decoded.generation = generation;
+        decode(imageName, assetArchive, fitArea, decoded);
+        queue->decoded++;
+
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->items.push_back(std::move(decoded));
+    });
+}
+
+std::size_t TextureCache::uploadPending(sf::Time budget) {
+    PROFILE_ZONE("upload pending");
+    sf::Clock clock;
+    std::size_t uploaded = 0;
+
+    while (uploaded == 0 || clock.getElapsedTime() < budget) {
+        Decoded decoded;
+        {
+            std::lock_guard<std::mutex> lock(decodedQueue->mutex);
+            if (decodedQueue->items.empty()) break;
+            decoded = std::move(decodedQueue->items.front());
+            decodedQueue->items.pop_front();
+        }
+
+        Entry& entry = entries[decoded.id];
+        if (entry.generation != decoded.generation) continue;
+        if (entry.state != State::Decoding && !(entry.state == State::Resident && entry.refreshing)) continue;
+
+        auto texture = upload(decoded);
+        if (!texture) {
+            LOG_ERROR("Could not load image: " << entry.imageName);
+            ++failedCount;
+            if (entry.state == State::Resident) {
+                entry.refreshing = false; // keep the texture we have
+                entry.stale = false;
+            } else {
+                entry.state = State::Failed;
+            }
+            continue;
+        }
+
+        install(decoded.id, std::move(texture), decoded.sourceSize);
+        ++uploadedCount;
+        ++uploaded;
+    }
+
+    return uploaded;
+}
+
+bool TextureCache::adopt(ImageHandle handle, const sf::Uint8* pixels, const sf::Vector2u& size, const sf::Vector2u& sourceSize) {
+    if (!handle.isValid() || handle.id >= entries.size() || entries[handle.id].state != State::Unloaded) return false;
+
+    auto texture = std::make_unique<sf::Texture>();
+    if (!pixels || !texture->create(size.x, size.y)) return false;
+    texture->update(pixels);
+    install(handle.id, std::move(texture), sourceSize);
+
+    // Saved for another window size, refit the next time it is drawn
+    Entry& entry = entries[handle.id];
+    sf::Vector2u wanted = (displaySize.x == 0 || displaySize.y == 0) ? sourceSize : fitSize(sourceSize, displaySize);
+    entry.stale = wanted != size;
+    return true;
+}
+
+bool TextureCache::copyPixels(ImageHandle handle, sf::Image& out) const {
+    if (!isResident(handle)) return false;
+    out = entries[handle.id].texture->copyToImage();
+    return true;
+}
+
+LoadProgress TextureCache::progress() const {
+    LoadProgress progress;
+    progress.requested = requestedCount;
+    progress.decoded = decodedQueue->decoded;
+    progress.uploaded = uploadedCount;
+    progress.failed = failedCount;
+    progress.cancelled = cancelledCount;
+    return progress;
+}
+
+bool TextureCache::isResident(ImageHandle handle) const {
+    return handle.isValid() && handle.id < entries.size() && entries[handle.id].state == State::Resident;
+}
+
+bool TextureCache::isPending(ImageHandle handle) const {
+    return handle.isValid() && handle.id < entries.size() && entries[handle.id].state == State::Decoding;
+}
+
+const std::string& TextureCache::imageName(ImageHandle handle) const {
+    static const std::string empty;
+    if (!handle.isValid() || handle.id >= entries.size()) return empty;
+    return entries[handle.id].imageName;
+}
+
+ImageHandle TextureCache::find(const std::string& imageName) const {
+    auto found = idsByName.find(imageName);
+    return found == idsByName.end() ? ImageHandle() : ImageHandle(found->second);
+}
+
+void TextureCache::setByteBudget(std::size_t bytes) {
+    budget = bytes;
+    evictToBudget(lru.empty() ? ImageHandle::npos : lru.front());
+}
+
+void TextureCache::setDisplaySize(const sf::Vector2u& pixels) {
+    if (pixels == displaySize) return;
+    displaySize = pixels;
+
+    // Refit lazily: a stale texture is regenerated the next time it is drawn
+    for (std::size_t id : lru) {
+        Entry& entry = entries[id];
+        sf::Vector2u wanted = (pixels.x == 0 || pixels.y == 0) ? entry.sourceSize : fitSize(entry.sourceSize, pixels);
+        entry.stale = wanted != entry.texture->getSize();
+    }
+}
+
+sf::Vector2u TextureCache::sourceSize(ImageHandle handle) const {
+    if (!handle.isValid() || handle.id >= entries.size()) return sf::Vector2u();
+    return entries[handle.id].sourceSize;
+}
+
+// The display size, but never more than one texture can hold; zooming past
+// that is drawn from tiles (see TiledSlide)
+sf::Vector2u TextureCache::decodeArea() const {
+    if (maxTextureSize == 0) return displaySize;
+    return sf::Vector2u(displaySize.x == 0 ? maxTextureSize : std::min(displaySize.x, maxTextureSize),
+                        displaySize.y == 0 ? maxTextureSize : std::min(displaySize.y, maxTextureSize));
+}
+
+// A shared entry decodes from the name it was first acquired by. Once that
+// file is gone, an alias with the same content that is still there takes over.
+void TextureCache::promoteSurvivingAlias(std::size_t id) {
+    Entry& entry = entries[id];
+    if (entry.aliases.empty() || (archive && archive->find(entry.imageName)) || hasImageFile(entry.imageName)) return;
+
+    for (auto& alias : entry.aliases) {
+        if (!hasImageFile(alias)) continue;
+        LOG_INFO("Image is gone, decoding its copy instead: " << entry.imageName << " -> " << alias);
+        std::swap(entry.imageName, alias);
+        return;
+    }
+}
+
+bool TextureCache::load(std::size_t id) {
+    promoteSurvivingAlias(id);
+    Entry& entry = entries[id];
+
+    Decoded decoded;
+    decoded.id = id;
+    decoded.generation = entry.generation;
+    decode(entry.imageName, archive, decodeArea(), decoded);
+
+    auto texture = upload(decoded);
+    if (!texture) {
+        LOG_ERROR("Could not load image: " << entry.imageName);
+        if (entry.state == State::Resident) {
+            entry.refreshing = false;
+            entry.stale = false;
+            return true;
+        }
+        entry.state = State::Failed;
+        return false;
+    }
+
+    install(id, std::move(texture), decoded.sourceSize);
+    return true;
+}
+
+// Runs on the decoder pool, so it may only touch its arguments
+void TextureCache::decode(const std::string& imageName, const AssetArchive* archive, const sf::Vector2u& fitArea, Decoded& decoded) {
+    PROFILE_ZONE("decode");
+    DecoderRegistry& decoders = DecoderRegistry::instance();
+    const PackedImage* packed = archive ? archive->find(imageName) : nullptr;
+    if (packed) {
+        decoded.size = sf::Vector2u(packed->width, packed->height);
+        if (packed->compression == PackRaw) {
+            decoded.packed = packed;
+        } else {
+            PROFILE_ZONE("unpack");
+            decoded.pixels = decoders.pool().acquire(packed->pixelBytes());
+            if (!AssetArchive::unpack(*packed, decoded.pixels.data())) {
+                LOG_WARNING("Corrupt archive block, falling back to decoding the file: " << imageName);
+                decoders.pool().release(std::move(decoded.pixels));
+                packed = nullptr;
+            }
+        }
+    }
+
+    if (!packed && !decoders.decodeImage(imageName, decoded.pixels, decoded.size)) return;
+    decoded.sourceSize = decoded.size;
+
+    // Shrink slides larger than the display area so VRAM is bounded by the window, not the source
+    sf::Vector2u fitted = fitSize(decoded.size, fitArea);
+    if (fitArea.x == 0 || fitArea.y == 0 || fitted == decoded.size) return;
+
+    PROFILE_ZONE("resample");
+    const sf::Uint8* source = decoded.packed ? decoded.packed->data : decoded.pixels.data();
+    std::vector<sf::Uint8> resampled = decoders.pool().acquire(static_cast<std::size_t>(fitted.x) * fitted.y * 4);
+    resampleArea(source, decoded.size.x, decoded.size.y, resampled.data(), fitted.x, fitted.y);
+
+    decoded.packed = nullptr;
+    decoded.pixels.swap(resampled);
+    decoders.pool().release(std::move(resampled));
+    decoded.size = fitted;
+}
+
+std::unique_ptr<sf::Texture> TextureCache::upload(const Decoded& decoded) {
+    PROFILE_ZONE("upload");
+    auto texture = std::make_unique<sf::Texture>();
+    const sf::Uint8* pixels = decoded.packed ? decoded.packed->data : decoded.pixels.data();
+    if ((!decoded.packed && decoded.pixels.empty()) || !texture->create(decoded.size.x, decoded.size.y)) return nullptr;
+    texture->update(pixels);
+    return texture;
+}
+
+void TextureCache::install(std::size_t id, std::unique_ptr<sf::Texture> texture, const sf::Vector2u& sourceSize) {
+    Entry& entry = entries[id];
+
+    if (entry.state == State::Resident) {
+        resident -= entry.bytes; // refitted texture replaces the old one in place
+    } else {
+        lru.push_front(id);
+        entry.lruPosition = lru.begin();
+    }
+
+    sf::Vector2u size = texture->getSize();
+    entry.bytes = static_cast<std::size_t>(size.x) * size.y * 4;
+    entry.texture = std::move(texture);
+    entry.sourceSize = sourceSize;
+    entry.state = State::Resident;
+    entry.stale = false;
+    entry.refreshing = false;
+    entry.cancelled.reset();
+    resident += entry.bytes;
+
+    evictToBudget(id);
+}
+
+void TextureCache::touch(std::size_t id) {
+    Entry& entry = entries[id];
+    if (entry.lruPosition != lru.begin()) {
+        lru.splice(lru.begin(), lru, entry.lruPosition);
+    }
+}
+
+void TextureCache::evict(std::size_t id) {
+    Entry& entry = entries[id];
+    if (entry.state != State::Resident) return;
+
+    if (entry.refreshing) {
+        // Otherwise the refit would be installed into an unloaded entry later
+        if (entry.cancelled) *entry.cancelled = true;
+        entry.generation++;
+        ++cancelledCount;
+    }
+    lru.erase(entry.lruPosition);
+    entry.lruPosition = lru.end();
+    entry.texture.reset();
+    entry.state = State::Unloaded;
+    entry.stale = false;
+    entry.refreshing = false;
+    entry.cancelled.reset();
+    resident -= entry.bytes;
+    entry.bytes = 0;
+}
+
+// The texture being displayed is never evicted, even if it alone is over budget
+void TextureCache::evictToBudget(std::size_t keep) {
+    while (resident > budget && !lru.empty()) {
+        std::size_t victim = lru.back();
+        if (victim == keep) {
+            if (lru.size() == 1) break;
+            victim = *std::prev(lru.end(), 2);
+        }
+        evict(victim);
+    }
+}
@@ -0,0 +1,202 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class AssetArchive;
+class ThreadPool;
+struct PackedImage;
+
+// Cheap reference to a slide image. It only names a cache entry; the pixels are
+// decoded the first time TextureCache::get is called for it.
+struct ImageHandle {
+    static const std::size_t npos = static_cast<std::size_t>(-1);
+
+    std::size_t id;
+
+    explicit ImageHandle(std::size_t id = npos) : id(id) {}
+
+    bool isValid() const { return id != npos; }
+};
+
+// Snapshot of the background loading counters
+struct LoadProgress {
+    std::size_t requested;
+    std::size_t decoded;
+    std::size_t uploaded;
+    std::size_t failed;
+    std::size_t cancelled;
+
+    std::size_t finished() const { return uploaded + failed + cancelled; }
+    bool isIdle() const { return finished() >= requested; }
+    float fraction() const { return requested == 0 ? 1.0f : static_cast<float>(finished()) / requested; }
+};
+
+// Decodes textures on first use and keeps at most byteBudget bytes of them
+// resident, evicting the least recently used ones first.
+//
+// Images are shared by name and, when the caller knows it, by content hash:
+// a diagram copied under several names is decoded and uploaded once, and every
+// name's handle refers to the same entry.
+//
+// With a decoder pool attached, images are decoded on the pool's workers and
+// only uploaded to the GPU on the UI thread inside uploadPending. Images found
+// in an attached asset archive skip decoding and are uploaded from the mapping.
+class TextureCache {
+public:
+    static const std::size_t DefaultByteBudget = 256u * 1024u * 1024u;
+
+    explicit TextureCache(std::size_t byteBudget = DefaultByteBudget, ThreadPool* decoder = nullptr);
+
+    // Registers an image (relative to images/) without decoding it. Each
+    // acquire takes a reference that must be given back with release. A
+    // non-zero contentHash (see CatalogEntry) shares the entry of any image
+    // already acquired with the same bytes.
+    ImageHandle acquire(const std::string& imageName, std::uint64_t contentHash = 0);
+
+    // Drops a reference; the last one frees the texture and the entry, under
+    // every name it was shared by
+    void release(ImageHandle handle);
+
+    // Returns the texture for the handle if it is resident. Otherwise the image
+    // is decoded, synchronously without a decoder pool, or queued on the pool in
+    // which case nullptr is returned until uploadPending has uploaded it.
+    const sf::Texture* get(ImageHandle handle);
+
+    // Uploads images present in the archive straight from its pixel blocks,
+    // falling back to decoding the file for everything else
+    void setArchive(const AssetArchive* assetArchive) { archive = assetArchive; }
+
+    // Images larger than this (in pixels) are downscaled to fit when decoded.
+    // Changing it refits resident textures the next time they are drawn.
+    // (0, 0) keeps native resolution, up to the largest texture the GPU supports.
+    void setDisplaySize(const sf::Vector2u& pixels);
+    const sf::Vector2u& getDisplaySize() const { return displaySize; }
+
+    // Largest texture side the GPU takes, sf::Texture::getMaximumSize(). Set by
+    // whoever owns the GL context so decoding never needs one; 0 for no limit.
+    void setMaxTextureSize(unsigned pixels) { maxTextureSize = pixels; }
+
+    // Size of the image before any downscaling, (0, 0) until it is first loaded
+    sf::Vector2u sourceSize(ImageHandle handle) const;
+
+    // Queues a background decode without waiting for it
+    void request(ImageHandle handle);
+
+    // Withdraws a queued decode; a decode that already started is discarded
+    void cancel(ImageHandle handle);
+
+    // Decodes an image again after its file changed on disk. A resident texture
+    // stays on screen until the new one is uploaded and a failed image is retried.
+    // The entry is no longer shared with images acquired later, its hash is stale.
+    // Returns false if the image is not in the cache.
+    bool reload(const std::string& imageName);
+
+    // Makes an image resident from pixels kept elsewhere (see SessionSnapshot),
+    // skipping the decode. Returns false if it is already resident or loading.
+    bool adopt(ImageHandle handle, const sf::Uint8* pixels, const sf::Vector2u& size, const sf::Vector2u& sourceSize);
+
+    // Reads a resident texture back from the GPU, as it is drawn
+    bool copyPixels(ImageHandle handle, sf::Image& out) const;
+
+    // Uploads decoded images to textures until the time budget is spent.
+    // At least one image is uploaded per call so loading always progresses.
+    // Returns the number of textures uploaded.
+    std::size_t uploadPending(sf::Time budget);
+
+    LoadProgress progress() const;
+    bool isResident(ImageHandle handle) const;
+    bool isPending(ImageHandle handle) const;
+    const std::string& imageName(ImageHandle handle) const;
+    // Handle an acquired image is known by, under its own name or a shared one;
+    // takes no reference
+    ImageHandle find(const std::string& imageName) const;
+
+    void setByteBudget(std::size_t bytes);
+    std::size_t byteBudget() const { return budget; }
+    std::size_t residentBytes() const { return resident; }
+    std::size_t residentCount() const { return lru.size(); }
+    // Acquires of a new name that were served by an entry with the same content
+    std::size_t sharedCount() const { return shared; }
+
+private:
+    enum class State { Unloaded, Decoding, Resident, Failed };
+
+    struct Entry {
+        std::string imageName; // the file that is decoded
+        std::vector<std::string> aliases; // other names with the same content
+        std::uint64_t contentHash; // 0 if unknown
+        std::unique_ptr<sf::Texture> texture;
+        std::size_t bytes;
+        std::size_t refs;
+        sf::Vector2u sourceSize;
+        bool stale;      // texture does not match the current display size
+        bool refreshing; // a refitted texture is being decoded
+        std::shared_ptr<std::atomic<bool>> cancelled; // shared with the queued decode task
+        unsigned generation; // bumped when the entry is freed or its decode superseded, stale decodes are dropped
+        State state;
+        std::list<std::size_t>::iterator lruPosition;
+    };
+
+    // Pixels ready for upload; exactly one source is set unless decoding failed
+    struct Decoded {
+        std::size_t id;
+        unsigned generation;
+        const PackedImage* packed;         // raw archive block, uploaded without a copy
+        std::vector<sf::Uint8> pixels;     // decoded, unpacked or downscaled, from the decoder pool
+        sf::Vector2u size;
+        sf::Vector2u sourceSize;
+
+        Decoded() : id(0), generation(0), packed(nullptr) {}
+        Decoded(Decoded&&) = default;
+        Decoded& operator=(Decoded&&) = default;
+        ~Decoded(); // gives the pixels back to the pool, uploaded or dropped
+    };
+
+    // Shared with in-flight decode tasks so they never outlive it
+    struct DecodedQueue {
+        std::mutex mutex;
+        std::deque<Decoded> items;
+        std::atomic<std::size_t> decoded;
+
+        DecodedQueue() : decoded(0) {}
+    };
+
+    sf::Vector2u decodeArea() const;
+    void promoteSurvivingAlias(std::size_t id);
+    bool load(std::size_t id);
+    void queueDecode(std::size_t id);
+    static void decode(const std::string& imageName, const AssetArchive* archive, const sf::Vector2u& fitArea, Decoded& decoded);
+    static std::unique_ptr<sf::Texture> upload(const Decoded& decoded);
+    void install(std::size_t id, std::unique_ptr<sf::Texture> texture, const sf::Vector2u& sourceSize);
+    void touch(std::size_t id);
+    void evict(std::size_t id);
+    void evictToBudget(std::size_t keep);
+
+    std::vector<Entry> entries;
+    std::unordered_map<std::string, std::size_t> idsByName;
+    std::unordered_map<std::uint64_t, std::size_t> idsByHash;
+    std::vector<std::size_t> freeIds;
+    std::list<std::size_t> lru; // front is the most recently used
+    std::size_t budget;
+    std::size_t resident;
+    std::size_t shared;
+
+    ThreadPool* decoder;
+    const AssetArchive* archive;
+    sf::Vector2u displaySize;
+    unsigned maxTextureSize;
+    std::shared_ptr<DecodedQueue> decodedQueue;
+    std::size_t requestedCount;
+    std::size_t uploadedCount;
+    std::size_t failedCount;
+    std::size_t cancelledCount;
+};
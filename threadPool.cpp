@@ -0,0 +1,66 @@
+#include "threadPool.hpp"
+#include "logger.hpp"
+#include "profiler.hpp"
+
+ThreadPool::ThreadPool(unsigned workerCount) : running(0), stopping(false) {
+    if (workerCount == 0) {
+        workerCount = std::thread::hardware_concurrency();
+        if (workerCount == 0) workerCount = 2;
+    }
+
+    for (unsigned i = 0; i < workerCount; ++i) {
+        workers.emplace_back(&ThreadPool::run, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        tasks.clear();
+    }
+    wake.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    wake.notify_one();
+}
+
+std::size_t ThreadPool::pending() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return tasks.size() + running;
+}
+
+void ThreadPool::run() {
+    Profiler::instance().setThreadName("pool worker");
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (stopping) return;
+
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            ++running;
+        }
+
+        try {
+            PROFILE_ZONE("task");
+            task();
+        } catch (const std::exception& e) {
+            LOG_ERROR("Exception caught in worker: " << e.what());
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        --running;
+    }
+}
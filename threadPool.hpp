@@ -0,0 +1,36 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads draining a FIFO of tasks. Used for work that
+// must stay off the UI thread, such as decoding images.
+class ThreadPool {
+public:
+    // 0 picks one worker per hardware thread
+    explicit ThreadPool(unsigned workerCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+
+    // Tasks queued or running
+    std::size_t pending() const;
+    unsigned workerCount() const { return static_cast<unsigned>(workers.size()); }
+
+private:
+    void run();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::size_t running;
+    bool stopping;
+};
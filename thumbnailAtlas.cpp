@@ -0,0 +1,392 @@
+#include "thumbnailAtlas.hpp"
+#include "imageDecoder.hpp"
+#include "logger.hpp"
+#include "mappedFile.hpp"
+#include "profiler.hpp"
+#include "resample.hpp"
+#include "threadPool.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+const unsigned ThumbnailAtlas::CellWidth;
+const unsigned ThumbnailAtlas::CellHeight;
+const unsigned ThumbnailAtlas::MaxWidth;
+const unsigned ThumbnailGrid::Gap;
+
+namespace {
+
+// Uploads while a build is running are batched this far apart
+const sf::Int32 UploadInterval = 100; // milliseconds
+
+bool makeDirectory(const std::string& path) {
+#ifdef _WIN32
+    return _mkdir(path.c_str()) == 0 || errno == EEXIST;
+#else
+    return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+std::uint64_t fnv1a64(const unsigned char* data, std::size_t size, std::uint64_t hash = 14695981039346656037ull) {
+    for (std::size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::uint64_t hashName(const std::string& name) {
+    return fnv1a64(reinterpret_cast<const unsigned char*>(name.data()), name.size());
+}
+
+std::uint64_t hashFile(const std::string& path) {
+    MappedFile file;
+    return file.open(path) ? fnv1a64(file.data(), file.size()) : 0;
+}
+
+ThumbnailEntry missingEntry(const std::string& name) {
+    ThumbnailEntry entry = {};
+    entry.nameHash = hashName(name);
+    entry.sourceMtime = -1;
+    return entry;
+}
+
+// Copies one thumbnail between atlases of different widths
+void copyCell(const sf::Uint8* from, unsigned fromColumns, std::size_t fromIndex, sf::Uint8* to, unsigned toColumns, std::size_t toIndex,
+              const sf::Vector2u& size) {
+    std::size_t fromStride = static_cast<std::size_t>(fromColumns) * ThumbnailAtlas::CellWidth * 4;
+    std::size_t toStride = static_cast<std::size_t>(toColumns) * ThumbnailAtlas::CellWidth * 4;
+    const sf::Uint8* source = from + fromIndex / fromColumns * ThumbnailAtlas::CellHeight * fromStride + fromIndex % fromColumns * ThumbnailAtlas::CellWidth * 4;
+    sf::Uint8* target = to + toIndex / toColumns * ThumbnailAtlas::CellHeight * toStride + toIndex % toColumns * ThumbnailAtlas::CellWidth * 4;
+    for (unsigned y = 0; y < size.y; ++y) {
+        std::memcpy(target + y * toStride, source + y * fromStride, size.x * 4);
+    }
+}
+
+void appendQuad(sf::VertexArray& vertices, const sf::FloatRect& rect, const sf::Color& color, const sf::FloatRect& texture = sf::FloatRect()) {
+    sf::Vector2f corners[4] = {
+        sf::Vector2f(rect.left, rect.top), sf::Vector2f(rect.left + rect.width, rect.top),
+        sf::Vector2f(rect.left + rect.width, rect.top + rect.height), sf::Vector2f(rect.left, rect.top + rect.height)};
+    sf::Vector2f coordinates[4] = {
+        sf::Vector2f(texture.left, texture.top), sf::Vector2f(texture.left + texture.width, texture.top),
+        sf::Vector2f(texture.left + texture.width, texture.top + texture.height), sf::Vector2f(texture.left, texture.top + texture.height)};
+    const int order[6] = {0, 1, 2, 0, 2, 3};
+    for (int i : order) {
+        vertices.append(sf::Vertex(corners[i], color, coordinates[i]));
+    }
+}
+
+// Two builds of the same topic, e.g. after switching away and back, must not share a file
+std::atomic<unsigned> buildCount(0);
+
+} // namespace
+
+ThumbnailAtlas::ThumbnailAtlas(ThreadPool& pool)
+    : pool(pool), columns(1), rows(1), maxRows(std::max(1u, sf::Texture::getMaximumSize() / CellHeight)) {}
+
+ThumbnailAtlas::~ThumbnailAtlas() {
+    if (building) building->cancelled = true;
+}
+
+std::string ThumbnailAtlas::cachePath(const std::string& topicName) {
+    std::uint64_t hash = hashName(topicName);
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+    return std::string("cache/thumbs/") + hex + ".thumbs";
+}
+
+void ThumbnailAtlas::show(const std::string& topicName, const std::vector<std::string>& imageNames) {
+    if (topicName == topic && imageNames == names) return;
+
+    // A build for the topic shown before stops after its current image and
+    // saves what it has, the next visit continues from there
+    if (building) building->cancelled = true;
+    building.reset();
+    topic = topicName;
+    names = imageNames;
+    sizes.assign(names.size(), sf::Vector2u());
+    if (names.empty()) return;
+
+    // As wide as needed up to MaxWidth, then as tall as the GPU allows; images past that have no thumbnail
+    columns = static_cast<unsigned>(std::min<std::size_t>(names.size(), MaxWidth / CellWidth));
+    rows = static_cast<unsigned>(std::min<std::size_t>((names.size() + columns - 1) / columns, maxRows));
+    sf::Vector2u atlasSize(columns * CellWidth, rows * CellHeight);
+    if (atlas.getSize() != atlasSize) {
+        if (!atlas.create(atlasSize.x, atlasSize.y)) {
+            LOG_WARNING("Could not create the thumbnail atlas, " << atlasSize.x << "x" << atlasSize.y);
+            return;
+        }
+        atlas.setSmooth(true);
+    }
+
+    auto build = std::make_shared<Build>();
+    building = build;
+    uploadClock.restart();
+    std::string path = cachePath(topic);
+    unsigned atlasColumns = columns;
+    unsigned atlasRows = rows;
+    pool.submit([build, imageNames, path, atlasColumns, atlasRows] {
+        ThumbnailAtlas::build(*build, imageNames, path, atlasColumns, atlasRows);
+        build->done = true;
+    });
+}
+
+bool ThumbnailAtlas::update() {
+    if (!building) return false;
+    bool done = building->done;
+    if (!done && uploadClock.getElapsedTime() < sf::milliseconds(UploadInterval)) return false;
+
+    uploadClock.restart();
+    bool uploaded = upload(*building);
+    if (done) building.reset();
+    return uploaded;
+}
+
+bool ThumbnailAtlas::upload(Build& build) {
+    PROFILE_ZONE("upload thumbnails");
+    std::lock_guard<std::mutex> lock(build.mutex);
+    if (build.firstDirty > build.lastDirty) return false;
+
+    // Whole rows of cells are contiguous in the atlas, so they go up in one update
+    std::size_t rowBytes = static_cast<std::size_t>(columns) * CellWidth * CellHeight * 4;
+    atlas.update(build.pixels.data() + build.firstDirty * rowBytes, columns * CellWidth, (build.lastDirty - build.firstDirty + 1) * CellHeight,
+                 0, build.firstDirty * CellHeight);
+    sizes = build.sizes;
+    build.firstDirty = 1;
+    build.lastDirty = 0;
+    return true;
+}
+
+void ThumbnailAtlas::build(Build& build, const std::vector<std::string>& imageNames, const std::string& path, unsigned columns, unsigned rows) {
+    PROFILE_ZONE("build thumbnails");
+    std::size_t stride = static_cast<std::size_t>(columns) * CellWidth * 4;
+    std::size_t atlasBytes = stride * rows * CellHeight;
+    std::size_t capacity = std::min<std::size_t>(imageNames.size(), static_cast<std::size_t>(columns) * rows);
+
+    std::vector<ThumbnailEntry> entries;
+    for (const auto& name : imageNames) entries.push_back(missingEntry(name));
+
+    // The atlas saved last time is looked up by name, and by content for
+    // renamed images, whatever its layout; what it has is shown first and then
+    // checked image by image
+    MappedFile previous;
+    ThumbnailHeader saved;
+    const ThumbnailEntry* previousEntries = nullptr;
+    const sf::Uint8* previousPixels = nullptr;
+    bool valid = previous.open(path) && previous.size() >= sizeof(saved);
+    if (valid) {
+        std::memcpy(&saved, previous.data(), sizeof(saved));
+        std::size_t entryBytes = static_cast<std::size_t>(saved.count) * sizeof(ThumbnailEntry);
+        std::size_t pixelBytes = static_cast<std::size_t>(saved.columns) * CellWidth * 4 * saved.rows * CellHeight;
+        valid = std::memcmp(saved.magic, ThumbnailMagic, sizeof(ThumbnailMagic)) == 0 && saved.version == ThumbnailVersion &&
+                saved.cellWidth == CellWidth && saved.cellHeight == CellHeight && saved.columns > 0 &&
+                previous.size() >= sizeof(saved) + entryBytes + pixelBytes;
+        previousEntries = reinterpret_cast<const ThumbnailEntry*>(previous.data() + sizeof(saved));
+        previousPixels = previous.data() + sizeof(saved) + entryBytes;
+    }
+
+    std::unordered_map<std::uint64_t, std::size_t> previousByName;
+    std::unordered_map<std::uint64_t, std::size_t> previousByContent;
+    if (valid) {
+        std::size_t previousCapacity = std::min<std::size_t>(saved.count, static_cast<std::size_t>(saved.columns) * saved.rows);
+        for (std::size_t i = 0; i < previousCapacity; ++i) {
+            const ThumbnailEntry& entry = previousEntries[i];
+            if (entry.sourceMtime == -1 || entry.width > CellWidth || entry.height > CellHeight) continue;
+            previousByName.emplace(entry.nameHash, i);
+            previousByContent.emplace(entry.contentHash, i);
+        }
+    }
+
+    // Unchanged slides in an unchanged layout need no new file
+    bool changed = !valid || saved.count != imageNames.size() || saved.columns != columns || saved.rows != rows;
+    {
+        std::lock_guard<std::mutex> lock(build.mutex);
+        build.pixels.assign(atlasBytes, 0);
+        build.sizes.assign(imageNames.size(), sf::Vector2u());
+        for (std::size_t i = 0; i < capacity; ++i) {
+            auto found = previousByName.find(entries[i].nameHash);
+            if (found == previousByName.end()) {
+                // Still never made where it was, e.g. the image is missing
+                if (!valid || i >= saved.count || previousEntries[i].nameHash != entries[i].nameHash) changed = true;
+                continue;
+            }
+            if (found->second != i) changed = true;
+            entries[i] = previousEntries[found->second];
+            build.sizes[i] = sf::Vector2u(entries[i].width, entries[i].height);
+            copyCell(previousPixels, saved.columns, found->second, build.pixels.data(), columns, i, build.sizes[i]);
+        }
+        if (!previousByName.empty()) {
+            build.firstDirty = 0;
+            build.lastDirty = rows - 1;
+        }
+    }
+
+    DecoderRegistry& decoders = DecoderRegistry::instance();
+    for (std::size_t i = 0; i < capacity && !build.cancelled; ++i) {
+        ThumbnailEntry& entry = entries[i];
+        std::string imagePath = "images/" + imageNames[i];
+        struct stat info;
+        if (stat(imagePath.c_str(), &info) != 0) continue; // keeps what it had, the image may be on its way
+
+        std::uint64_t sourceSize = static_cast<std::uint64_t>(info.st_size);
+        std::int64_t sourceMtime = static_cast<std::int64_t>(info.st_mtime);
+        if (entry.sourceMtime == sourceMtime && entry.sourceSize == sourceSize) continue;
+
+        changed = true;
+        std::uint64_t contentHash = hashFile(imagePath);
+        std::vector<sf::Uint8> thumbnail;
+        sf::Vector2u thumbnailSize;
+
+        // Touched but not changed, e.g. copied or checked out again, or renamed
+        auto same = previousByContent.find(contentHash);
+        bool reused = contentHash != 0 && same != previousByContent.end() && previousEntries[same->second].sourceSize == sourceSize;
+        if (reused) {
+            thumbnailSize = sf::Vector2u(previousEntries[same->second].width, previousEntries[same->second].height);
+        } else {
+            std::vector<sf::Uint8> pixels;
+            sf::Vector2u size;
+            if (decoders.decodeImage(imageNames[i], pixels, size)) {
+                thumbnailSize = fitSize(size, sf::Vector2u(CellWidth, CellHeight));
+                thumbnail.resize(static_cast<std::size_t>(thumbnailSize.x) * thumbnailSize.y * 4);
+                if (!thumbnail.empty()) resampleArea(pixels.data(), size.x, size.y, thumbnail.data(), thumbnailSize.x, thumbnailSize.y);
+            } else {
+                LOG_WARNING("No thumbnail for " << imageNames[i]);
+            }
+            decoders.pool().release(std::move(pixels));
+        }
+
+        entry.contentHash = contentHash;
+        entry.sourceSize = sourceSize;
+        entry.sourceMtime = sourceMtime;
+        entry.width = thumbnailSize.x;
+        entry.height = thumbnailSize.y;
+
+        unsigned row = static_cast<unsigned>(i / columns);
+        std::lock_guard<std::mutex> lock(build.mutex);
+        if (reused) {
+            copyCell(previousPixels, saved.columns, same->second, build.pixels.data(), columns, i, thumbnailSize);
+        } else {
+            std::size_t origin = row * CellHeight * stride + (i % columns) * CellWidth * 4;
+            for (unsigned y = 0; y < thumbnailSize.y; ++y) {
+                std::memcpy(&build.pixels[origin + y * stride], &thumbnail[static_cast<std::size_t>(y) * thumbnailSize.x * 4], thumbnailSize.x * 4);
+            }
+        }
+        build.sizes[i] = thumbnailSize;
+        if (build.firstDirty > build.lastDirty) {
+            build.firstDirty = build.lastDirty = row;
+        } else {
+            build.firstDirty = std::min(build.firstDirty, row);
+            build.lastDirty = std::max(build.lastDirty, row);
+        }
+    }
+    if (!changed) return;
+    previous.close(); // Windows cannot replace a mapped file
+
+    // Only this task writes pixels, so reading them here needs no lock
+    ThumbnailHeader header = {};
+    std::memcpy(header.magic, ThumbnailMagic, sizeof(ThumbnailMagic));
+    header.version = ThumbnailVersion;
+    header.count = static_cast<std::uint32_t>(imageNames.size());
+    header.cellWidth = CellWidth;
+    header.cellHeight = CellHeight;
+    header.columns = columns;
+    header.rows = rows;
+
+    makeDirectory("cache");
+    makeDirectory("cache/thumbs");
+    std::string temporaryPath = path + ".tmp" + std::to_string(++buildCount);
+    std::FILE* file = std::fopen(temporaryPath.c_str(), "wb");
+    if (!file) return;
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              std::fwrite(entries.data(), sizeof(ThumbnailEntry), entries.size(), file) == entries.size() &&
+              std::fwrite(build.pixels.data(), 1, build.pixels.size(), file) == build.pixels.size();
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) {
+        std::remove(temporaryPath.c_str());
+        return;
+    }
+    if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        std::remove(path.c_str());
+        if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) std::remove(temporaryPath.c_str());
+    }
+}
+
+void ThumbnailAtlas::appendQuad(sf::VertexArray& vertices, std::size_t index, const sf::FloatRect& area) const {
+    if (!has(index)) return;
+
+    sf::Vector2u size = sizes[index];
+    float scale = std::min(area.width / size.x, area.height / size.y);
+    sf::Vector2f shown(size.x * scale, size.y * scale);
+    sf::FloatRect rect(std::floor(area.left + (area.width - shown.x) / 2), std::floor(area.top + (area.height - shown.y) / 2), shown.x, shown.y);
+    sf::FloatRect texture(static_cast<float>(index % columns * CellWidth), static_cast<float>(index / columns * CellHeight),
+                          static_cast<float>(size.x), static_cast<float>(size.y));
+    ::appendQuad(vertices, rect, sf::Color::White, texture);
+}
+
+ThumbnailGrid::ThumbnailGrid(const ThumbnailAtlas& atlas)
+    : atlas(atlas), current(static_cast<std::size_t>(-1)), columns(1), visibleRows(1), firstRow(0), frames(sf::Triangles), thumbnails(sf::Triangles) {}
+
+void ThumbnailGrid::layout(const sf::FloatRect& gridArea, std::size_t highlighted) {
+    area = gridArea;
+    columns = std::max<std::size_t>(1, static_cast<std::size_t>(std::max(area.width - Gap, 0.0f) / (ThumbnailAtlas::CellWidth + Gap)));
+    visibleRows = std::max<std::size_t>(1, static_cast<std::size_t>(std::max(area.height - Gap, 0.0f) / (ThumbnailAtlas::CellHeight + Gap)));
+
+    if (highlighted != current) {
+        current = highlighted;
+        std::size_t row = current / columns;
+        if (row < firstRow) firstRow = row;
+        if (row >= firstRow + visibleRows) firstRow = row + 1 - visibleRows;
+    }
+    scroll(0);
+}
+
+void ThumbnailGrid::scroll(long rowCount) {
+    std::size_t totalRows = (atlas.size() + columns - 1) / columns;
+    long last = static_cast<long>(totalRows > visibleRows ? totalRows - visibleRows : 0);
+    firstRow = static_cast<std::size_t>(std::max(0L, std::min(static_cast<long>(firstRow) + rowCount, last)));
+    refresh();
+}
+
+sf::FloatRect ThumbnailGrid::cell(std::size_t index) const {
+    std::size_t row = index / columns - firstRow;
+    return sf::FloatRect(area.left + Gap + (index % columns) * (ThumbnailAtlas::CellWidth + Gap),
+                         area.top + Gap + row * (ThumbnailAtlas::CellHeight + Gap),
+                         static_cast<float>(ThumbnailAtlas::CellWidth), static_cast<float>(ThumbnailAtlas::CellHeight));
+}
+
+void ThumbnailGrid::refresh() {
+    frames.clear();
+    thumbnails.clear();
+    std::size_t end = std::min(atlas.size(), (firstRow + visibleRows) * columns);
+    for (std::size_t index = firstRow * columns; index < end; ++index) {
+        sf::FloatRect rect = cell(index);
+        sf::FloatRect frame(rect.left - 3, rect.top - 3, rect.width + 6, rect.height + 6);
+        appendQuad(frames, frame, index == current ? sf::Color::Yellow : sf::Color(60, 60, 60));
+        atlas.appendQuad(thumbnails, index, rect);
+    }
+}
+
+std::size_t ThumbnailGrid::hitTest(const sf::Vector2f& point) const {
+    std::size_t end = std::min(atlas.size(), (firstRow + visibleRows) * columns);
+    if (!area.contains(point) || point.x < area.left + Gap || point.y < area.top + Gap) return atlas.size();
+
+    std::size_t column = static_cast<std::size_t>((point.x - area.left - Gap) / (ThumbnailAtlas::CellWidth + Gap));
+    std::size_t row = static_cast<std::size_t>((point.y - area.top - Gap) / (ThumbnailAtlas::CellHeight + Gap));
+    std::size_t index = (firstRow + row) * columns + column;
+    if (column >= columns || row >= visibleRows || index >= end || !cell(index).contains(point)) return atlas.size();
+    return index;
+}
+
+void ThumbnailGrid::draw(sf::RenderTarget& target, sf::RenderStates states) const {
+    target.draw(frames, states);
+    states.texture = &atlas.texture();
+    target.draw(thumbnails, states);
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// On-disk layout of cache/thumbs/<hash of the topic name>.thumbs:
+//   ThumbnailHeader, one ThumbnailEntry per image in topic order, then the
+//   atlas's raw RGBA pixels, columns * CellWidth wide. Thumbnail i sits at
+//   the top left of cell (i % columns, i / columns).
+struct ThumbnailHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t count;
+    std::uint32_t cellWidth;
+    std::uint32_t cellHeight;
+    std::uint32_t columns;
+    std::uint32_t rows;
+};
+
+// A thumbnail is reused while its image keeps the same size and mtime, or,
+// once the mtime moved, the same content hash. Entries are found by name or
+// content wherever they sat, so slides added, removed or reordered only move
+// the cells of the others.
+struct ThumbnailEntry {
+    std::uint64_t nameHash;
+    std::uint64_t contentHash; // FNV-1a of images/<name>
+    std::uint64_t sourceSize;
+    std::int64_t sourceMtime;  // -1 for a thumbnail never made
+    std::uint32_t width;       // 0 if the image could not be decoded
+    std::uint32_t height;
+};
+
+const char ThumbnailMagic[8] = {'C', 'Q', 'T', 'H', 'U', 'M', '0', '1'};
+const std::uint32_t ThumbnailVersion = 1;
+
+// Small thumbnails of every slide of one topic, packed into a single texture.
+// The atlas is read from the cache directory and brought up to date in the
+// background, decoding only the images that are new or changed; the texture
+// fills in as they are done. Browsing a topic then costs one texture and one
+// draw call however many slides it has, and no slide is decoded to show it.
+class ThumbnailAtlas {
+public:
+    static const unsigned CellWidth = 128;
+    static const unsigned CellHeight = 72;
+    static const unsigned MaxWidth = 2048;
+
+    explicit ThumbnailAtlas(ThreadPool& pool);
+    ~ThumbnailAtlas();
+
+    ThumbnailAtlas(const ThumbnailAtlas&) = delete;
+    ThumbnailAtlas& operator=(const ThumbnailAtlas&) = delete;
+
+    static std::string cachePath(const std::string& topicName);
+
+    // Starts showing the thumbnails of these images of a topic, in this order
+    void show(const std::string& topicName, const std::vector<std::string>& imageNames);
+    const std::vector<std::string>& imageNames() const { return names; }
+
+    // Uploads thumbnails made since the last call. Returns true if any were.
+    bool update();
+    bool isBuilding() const { return building != nullptr; }
+
+    std::size_t size() const { return names.size(); }
+    bool has(std::size_t index) const { return index < sizes.size() && sizes[index].x > 0; }
+
+    // Two triangles showing the thumbnail fitted and centred in area, to be
+    // drawn with texture(); nothing if it has none (yet)
+    void appendQuad(sf::VertexArray& vertices, std::size_t index, const sf::FloatRect& area) const;
+    const sf::Texture& texture() const { return atlas; }
+
+private:
+    // Shared with the build task so it never outlives the atlas. The task
+    // writes cells into pixels and the UI thread uploads the rows between
+    // firstDirty and lastDirty, both under mutex.
+    struct Build {
+        std::atomic<bool> done;
+        std::atomic<bool> cancelled;
+        std::mutex mutex;
+        std::vector<sf::Uint8> pixels;
+        std::vector<sf::Vector2u> sizes;
+        unsigned firstDirty;
+        unsigned lastDirty; // rows, empty while firstDirty > lastDirty
+
+        Build() : done(false), cancelled(false), firstDirty(1), lastDirty(0) {}
+    };
+
+    static void build(Build& build, const std::vector<std::string>& imageNames, const std::string& path, unsigned columns, unsigned rows);
+    bool upload(Build& build);
+
+    ThreadPool& pool;
+    std::string topic;
+    std::vector<std::string> names;
+    std::vector<sf::Vector2u> sizes;
+    unsigned columns;
+    unsigned rows;
+    unsigned maxRows;
+    sf::Texture atlas;
+    std::shared_ptr<Build> building;
+    sf::Clock uploadClock;
+};
+
+// Thumbnails of a topic laid out in rows over an area, scrolled by whole rows.
+// Frames and thumbnails are each one vertex array, so the grid is two draw
+// calls whatever its size.
+class ThumbnailGrid : public sf::Drawable {
+public:
+    static const unsigned Gap = 10;
+
+    explicit ThumbnailGrid(const ThumbnailAtlas& atlas);
+
+    // The highlighted thumbnail is scrolled into view when it changes
+    void layout(const sf::FloatRect& area, std::size_t current);
+    void scroll(long rows);
+    // Rebuilds the vertices, e.g. after the atlas uploaded thumbnails
+    void refresh();
+
+    // Index of the thumbnail under the point, or size() of the atlas for none
+    std::size_t hitTest(const sf::Vector2f& point) const;
+
+private:
+    void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
+    sf::FloatRect cell(std::size_t index) const;
+
+    const ThumbnailAtlas& atlas;
+    sf::FloatRect area;
+    std::size_t current;
+    std::size_t columns;
+    std::size_t visibleRows;
+    std::size_t firstRow;
+    sf::VertexArray frames;
+    sf::VertexArray thumbnails;
+};
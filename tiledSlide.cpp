@@ -0,0 +1,336 @@
+#include "tiledSlide.hpp"
+#include "imageDecoder.hpp"
+#include "logger.hpp"
+#include "profiler.hpp"
+#include "resample.hpp"
+#include "threadPool.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+const unsigned TilePyramid::TileSize;
+
+namespace {
+
+bool makeDirectory(const std::string& path) {
+#ifdef _WIN32
+    return _mkdir(path.c_str()) == 0 || errno == EEXIST;
+#else
+    return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+// Every level halves the one before until it fits in a single tile
+std::vector<sf::Vector2u> levelSizesFor(sf::Vector2u size) {
+    std::vector<sf::Vector2u> sizes(1, size);
+    while (size.x > TilePyramid::TileSize || size.y > TilePyramid::TileSize) {
+        size = sf::Vector2u(std::max(1u, (size.x + 1) / 2), std::max(1u, (size.y + 1) / 2));
+        sizes.push_back(size);
+    }
+    return sizes;
+}
+
+unsigned tilesAcross(unsigned pixels) {
+    return (pixels + TilePyramid::TileSize - 1) / TilePyramid::TileSize;
+}
+
+// Two builds of the same image, e.g. after zooming out and in again, must not share a file
+std::atomic<unsigned> buildCount(0);
+
+} // namespace
+
+std::string TilePyramid::cachePath(const std::string& imageName) {
+    std::string flat = imageName;
+    std::replace(flat.begin(), flat.end(), '/', '_');
+    std::replace(flat.begin(), flat.end(), '\\', '_');
+    return "cache/tiles/" + flat + ".tiles";
+}
+
+bool TilePyramid::build(const std::string& imageName, const std::string& path) {
+    PROFILE_ZONE("build tiles");
+    DecoderRegistry& decoders = DecoderRegistry::instance();
+    struct stat info;
+    std::vector<sf::Uint8> image;
+    sf::Vector2u imageSize;
+    if (stat(("images/" + imageName).c_str(), &info) != 0 || !decoders.decodeImage(imageName, image, imageSize)) return false;
+
+    std::vector<sf::Vector2u> sizes = levelSizesFor(imageSize);
+
+    TileHeader header = {};
+    std::memcpy(header.magic, TileMagic, sizeof(TileMagic));
+    header.version = TileVersion;
+    header.tileSize = TileSize;
+    header.width = sizes[0].x;
+    header.height = sizes[0].y;
+    header.levels = static_cast<std::uint32_t>(sizes.size());
+    header.sourceSize = static_cast<std::uint64_t>(info.st_size);
+    header.sourceMtime = static_cast<std::int64_t>(info.st_mtime);
+
+    // Tiles are stored in the order they are cut, so the offsets are known up front
+    std::vector<std::uint64_t> offsets;
+    for (const sf::Vector2u& size : sizes) {
+        for (unsigned y = 0; y < tilesAcross(size.y); ++y) {
+            for (unsigned x = 0; x < tilesAcross(size.x); ++x) offsets.push_back(0);
+        }
+    }
+    std::uint64_t position = sizeof(header) + offsets.size() * sizeof(std::uint64_t);
+    std::size_t index = 0;
+    for (const sf::Vector2u& size : sizes) {
+        for (unsigned y = 0; y < tilesAcross(size.y); ++y) {
+            for (unsigned x = 0; x < tilesAcross(size.x); ++x) {
+                offsets[index++] = position;
+                position += static_cast<std::uint64_t>(std::min(TileSize, size.x - x * TileSize)) * std::min(TileSize, size.y - y * TileSize) * 4;
+            }
+        }
+    }
+
+    makeDirectory("cache");
+    makeDirectory("cache/tiles");
+    std::string temporaryPath = path + ".tmp" + std::to_string(++buildCount);
+    std::FILE* file = std::fopen(temporaryPath.c_str(), "wb");
+    if (!file) return false;
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              std::fwrite(offsets.data(), sizeof(std::uint64_t), offsets.size(), file) == offsets.size();
+
+    std::vector<sf::Uint8> level;
+    std::vector<sf::Uint8> tile;
+    for (std::size_t l = 0; l < sizes.size() && ok; ++l) {
+        const sf::Vector2u& size = sizes[l];
+        if (l > 0) {
+            PROFILE_ZONE("downsample");
+            const sf::Uint8* previous = l == 1 ? image.data() : level.data();
+            std::vector<sf::Uint8> next = decoders.pool().acquire(static_cast<std::size_t>(size.x) * size.y * 4);
+            resampleArea(previous, sizes[l - 1].x, sizes[l - 1].y, next.data(), size.x, size.y);
+            level.swap(next);
+            decoders.pool().release(std::move(next));
+            if (l == 1) decoders.pool().release(std::move(image)); // the full image is no longer needed
+        }
+        const sf::Uint8* pixels = l == 0 ? image.data() : level.data();
+
+        for (unsigned y = 0; y < tilesAcross(size.y) && ok; ++y) {
+            for (unsigned x = 0; x < tilesAcross(size.x) && ok; ++x) {
+                unsigned width = std::min(TileSize, size.x - x * TileSize);
+                unsigned height = std::min(TileSize, size.y - y * TileSize);
+                tile.resize(static_cast<std::size_t>(width) * height * 4);
+                for (unsigned row = 0; row < height; ++row) {
+                    std::memcpy(&tile[static_cast<std::size_t>(row) * width * 4],
+                                pixels + ((static_cast<std::size_t>(y) * TileSize + row) * size.x + static_cast<std::size_t>(x) * TileSize) * 4,
+                                static_cast<std::size_t>(width) * 4);
+                }
+                ok = std::fwrite(tile.data(), 1, tile.size(), file) == tile.size();
+            }
+        }
+    }
+    ok = std::fclose(file) == 0 && ok;
+    decoders.pool().release(std::move(image));
+    decoders.pool().release(std::move(level));
+
+    if (!ok) {
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+    if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        std::remove(path.c_str());
+        if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TilePyramid::open(const std::string& path, const std::string& imageName) {
+    close();
+    if (!file.open(path)) return false;
+
+    TileHeader header;
+    struct stat info;
+    if (file.size() < sizeof(header) || stat(("images/" + imageName).c_str(), &info) != 0) {
+        close();
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, TileMagic, sizeof(TileMagic)) != 0 || header.version != TileVersion || header.tileSize != TileSize ||
+        header.sourceSize != static_cast<std::uint64_t>(info.st_size) || header.sourceMtime != static_cast<std::int64_t>(info.st_mtime) ||
+        header.width == 0 || header.height == 0) {
+        close();
+        return false;
+    }
+
+    levelSizes = levelSizesFor(sf::Vector2u(header.width, header.height));
+    std::size_t tileTotal = 0;
+    for (const sf::Vector2u& size : levelSizes) {
+        firstTile.push_back(tileTotal);
+        tileTotal += static_cast<std::size_t>(tilesAcross(size.x)) * tilesAcross(size.y);
+    }
+    if (levelSizes.size() != header.levels || sizeof(header) + tileTotal * sizeof(std::uint64_t) > file.size()) {
+        close();
+        return false;
+    }
+    offsets = reinterpret_cast<const std::uint64_t*>(file.data() + sizeof(header));
+
+    // Every tile must lie inside the file, then tile() needs no checks
+    for (unsigned l = 0; l < levels(); ++l) {
+        sf::Vector2u count = tileCount(l);
+        for (unsigned y = 0; y < count.y; ++y) {
+            for (unsigned x = 0; x < count.x; ++x) {
+                sf::Vector2u size = tileSize(l, x, y);
+                std::uint64_t offset = offsets[firstTile[l] + static_cast<std::size_t>(y) * count.x + x];
+                if (offset + static_cast<std::uint64_t>(size.x) * size.y * 4 > file.size()) {
+                    LOG_WARNING("Truncated tile cache, rebuilding: " << path);
+                    close();
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void TilePyramid::close() {
+    levelSizes.clear();
+    firstTile.clear();
+    offsets = nullptr;
+    file.close();
+}
+
+sf::Vector2u TilePyramid::tileCount(unsigned level) const {
+    return sf::Vector2u(tilesAcross(levelSizes[level].x), tilesAcross(levelSizes[level].y));
+}
+
+sf::Vector2u TilePyramid::tileSize(unsigned level, unsigned x, unsigned y) const {
+    return sf::Vector2u(std::min(TileSize, levelSizes[level].x - x * TileSize), std::min(TileSize, levelSizes[level].y - y * TileSize));
+}
+
+const sf::Uint8* TilePyramid::tile(unsigned level, unsigned x, unsigned y) const {
+    return file.data() + offsets[firstTile[level] + static_cast<std::size_t>(y) * tileCount(level).x + x];
+}
+
+TiledSlide::TiledSlide(ThreadPool& pool) : pool(pool), missing(0) {}
+
+void TiledSlide::open(const std::string& imageName) {
+    if (imageName == name) return;
+    close();
+    name = imageName;
+
+    std::string path = TilePyramid::cachePath(imageName);
+    if (pyramid.open(path, imageName)) return;
+
+    auto build = std::make_shared<Build>();
+    building = build;
+    pool.submit([build, imageName, path] {
+        build->built = TilePyramid::build(imageName, path);
+        build->done = true;
+    });
+}
+
+void TiledSlide::close() {
+    name.clear();
+    pyramid.close();
+    building.reset(); // a build in flight still writes its file, the next open finds it
+    tiles.clear();
+    lru.clear();
+    visible.clear();
+    missing = 0;
+}
+
+bool TiledSlide::update(const sf::FloatRect& imageRect, const sf::FloatRect& area, sf::Time budget) {
+    if (building && building->done) {
+        bool built = building->built;
+        building.reset();
+        if (!built || !pyramid.open(TilePyramid::cachePath(name), name)) {
+            LOG_WARNING("Could not build zoom tiles, showing the scaled slide: " << name);
+        }
+    }
+
+    shownRect = imageRect;
+    visible.clear();
+    missing = 0;
+    if (!pyramid.isOpen() || imageRect.width <= 0 || imageRect.height <= 0) return false;
+
+    // The smallest level that still has a pixel for every screen pixel
+    float scale = imageRect.width / pyramid.size(0).x;
+    unsigned level = 0;
+    while (level + 1 < pyramid.levels() && scale * static_cast<float>(1u << (level + 1)) <= 1.0f) ++level;
+
+    // Top level first, it is drawn under everything else
+    unsigned top = pyramid.levels() - 1;
+    visible.push_back(TileKey{top, 0, 0});
+
+    sf::FloatRect shown;
+    if (level != top && imageRect.intersects(area, shown)) {
+        sf::Vector2u size = pyramid.size(level);
+        sf::Vector2u count = pyramid.tileCount(level);
+        float toLevelX = size.x / imageRect.width / TilePyramid::TileSize;
+        float toLevelY = size.y / imageRect.height / TilePyramid::TileSize;
+        unsigned x0 = static_cast<unsigned>(std::max(0.0f, (shown.left - imageRect.left) * toLevelX));
+        unsigned y0 = static_cast<unsigned>(std::max(0.0f, (shown.top - imageRect.top) * toLevelY));
+        unsigned x1 = std::min(count.x - 1, static_cast<unsigned>((shown.left + shown.width - imageRect.left) * toLevelX));
+        unsigned y1 = std::min(count.y - 1, static_cast<unsigned>((shown.top + shown.height - imageRect.top) * toLevelY));
+        for (unsigned y = y0; y <= y1; ++y) {
+            for (unsigned x = x0; x <= x1; ++x) visible.push_back(TileKey{level, x, y});
+        }
+    }
+
+    PROFILE_ZONE("upload tiles");
+    sf::Clock clock;
+    std::size_t uploaded = 0;
+    for (const TileKey& key : visible) {
+        auto found = tiles.find(key);
+        if (found != tiles.end()) {
+            lru.splice(lru.begin(), lru, found->second.lruPosition);
+        } else if (uploaded > 0 && clock.getElapsedTime() >= budget) {
+            ++missing;
+        } else if (upload(key)) {
+            ++uploaded;
+        }
+    }
+
+    // Keep what was on screen plus as much again for panning back and forth
+    while (tiles.size() > visible.size() * 2 && !lru.empty()) {
+        tiles.erase(lru.back());
+        lru.pop_back();
+    }
+    return uploaded > 0;
+}
+
+bool TiledSlide::upload(const TileKey& key) {
+    sf::Vector2u size = pyramid.tileSize(key.level, key.x, key.y);
+    Tile& tile = tiles[key];
+    if (!tile.texture.create(size.x, size.y)) {
+        tiles.erase(key);
+        return false;
+    }
+    tile.texture.update(pyramid.tile(key.level, key.x, key.y));
+    tile.texture.setSmooth(true);
+    lru.push_front(key);
+    tile.lruPosition = lru.begin();
+    return true;
+}
+
+void TiledSlide::draw(sf::RenderTarget& target, sf::RenderStates states) const {
+    for (const TileKey& key : visible) {
+        drawTile(target, states, key);
+    }
+}
+
+void TiledSlide::drawTile(sf::RenderTarget& target, sf::RenderStates states, const TileKey& key) const {
+    auto found = tiles.find(key);
+    if (found == tiles.end()) return;
+
+    sf::Vector2u size = pyramid.size(key.level);
+    float scaleX = shownRect.width / size.x;
+    float scaleY = shownRect.height / size.y;
+    sf::Sprite sprite(found->second.texture);
+    sprite.setPosition(shownRect.left + key.x * TilePyramid::TileSize * scaleX, shownRect.top + key.y * TilePyramid::TileSize * scaleY);
+    sprite.setScale(scaleX, scaleY);
+    target.draw(sprite, states);
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include "mappedFile.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// On-disk layout of cache/tiles/<image>.tiles:
+//   TileHeader, one uint64 offset per tile (level by level, rows top to
+//   bottom), then the tiles' raw RGBA pixels. Level 0 is the full image and
+//   every level after it half the size of the one before, down to one tile.
+struct TileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t tileSize;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t levels;
+    std::uint32_t reserved;
+    std::uint64_t sourceSize;  // of the PNG the tiles were cut from, to detect stale pyramids
+    std::int64_t sourceMtime;
+};
+
+const char TileMagic[8] = {'C', 'Q', 'T', 'I', 'L', 'E', '0', '1'};
+const std::uint32_t TileVersion = 1;
+
+// Mip pyramid of one image cut into square tiles, memory mapped so a tile
+// goes to the GPU straight from the page cache
+class TilePyramid {
+public:
+    static const unsigned TileSize = 512;
+
+    TilePyramid() : offsets(nullptr) {}
+
+    static std::string cachePath(const std::string& imageName);
+
+    // Decodes images/<imageName> and writes its pyramid to path. The whole
+    // image is in memory while the levels are cut, nothing is kept afterwards.
+    static bool build(const std::string& imageName, const std::string& path);
+
+    // Fails if the file is not a pyramid of the image as it is on disk now
+    bool open(const std::string& path, const std::string& imageName);
+    void close();
+    bool isOpen() const { return file.isOpen(); }
+
+    unsigned levels() const { return static_cast<unsigned>(levelSizes.size()); }
+    sf::Vector2u size(unsigned level = 0) const { return levelSizes[level]; }
+    sf::Vector2u tileCount(unsigned level) const;
+    sf::Vector2u tileSize(unsigned level, unsigned x, unsigned y) const;
+    const sf::Uint8* tile(unsigned level, unsigned x, unsigned y) const;
+
+private:
+    MappedFile file;
+    std::vector<sf::Vector2u> levelSizes;
+    std::vector<std::size_t> firstTile; // index of each level's first tile in offsets
+    const std::uint64_t* offsets;
+};
+
+// A slide shown zoomed in. The pyramid is built in the background the first
+// time an image is zoomed and reused from the cache directory afterwards; per
+// frame only the tiles of the level closest to the zoom that intersect the
+// slide area are uploaded, so VRAM follows the viewport, not the image.
+// The top level stays resident and is drawn under tiles still on their way.
+class TiledSlide : public sf::Drawable {
+public:
+    explicit TiledSlide(ThreadPool& pool);
+
+    // Starts showing imageName, building its pyramid first if needed
+    void open(const std::string& imageName);
+    void close();
+    const std::string& imageName() const { return name; }
+    bool isReady() const { return pyramid.isOpen(); }
+    bool isBuilding() const { return building != nullptr; }
+
+    // imageRect is where the whole image would be on screen, area the part of
+    // the screen it may cover. Picks the level and uploads missing tiles until
+    // the budget is spent. Returns true if tiles were uploaded.
+    bool update(const sf::FloatRect& imageRect, const sf::FloatRect& area, sf::Time budget);
+    // Tiles of the current view that are not uploaded yet
+    std::size_t missingTiles() const { return missing; }
+
+    std::size_t residentTiles() const { return tiles.size(); }
+
+private:
+    struct TileKey {
+        unsigned level;
+        unsigned x;
+        unsigned y;
+
+        bool operator<(const TileKey& other) const {
+            if (level != other.level) return level < other.level;
+            if (y != other.y) return y < other.y;
+            return x < other.x;
+        }
+    };
+
+    struct Tile {
+        sf::Texture texture;
+        std::list<TileKey>::iterator lruPosition;
+    };
+
+    // Shared with the build task so it never outlives the slide
+    struct Build {
+        std::atomic<bool> done;
+        bool built;
+
+        Build() : done(false), built(false) {}
+    };
+
+    void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
+    bool upload(const TileKey& key);
+    void drawTile(sf::RenderTarget& target, sf::RenderStates states, const TileKey& key) const;
+
+    ThreadPool& pool;
+    std::string name;
+    TilePyramid pyramid;
+    std::shared_ptr<Build> building;
+
+    std::map<TileKey, Tile> tiles;
+    std::list<TileKey> lru; // front is the most recently drawn
+    std::vector<TileKey> visible;
+    std::size_t missing;
+    sf::FloatRect shownRect;
+};
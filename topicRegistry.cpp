@@ -0,0 +1,64 @@
+#include "topicRegistry.hpp"
+#include "catalog.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <cctype>
+#include <dirent.h>
+#include <fstream>
+
+void TopicRegistry::discover(const std::string& directory) {
+    names.clear();
+    count = 0;
+
+    std::ifstream titles(directory + "/topics.txt");
+    std::string title;
+    while (std::getline(titles, title)) {
+        if (!title.empty() && title.back() == '\r') title.pop_back();
+        names.push_back(title);
+    }
+    count = names.size();
+
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) return;
+    while (dirent* entry = readdir(dir)) {
+        int index = topicOfList(entry->d_name);
+        if (index >= 0) {
+            count = std::max(count, static_cast<std::size_t>(index) + 1);
+        }
+    }
+    closedir(dir);
+}
+
+void TopicRegistry::include(const Catalog& catalog) {
+    count = std::max(count, static_cast<std::size_t>(catalog.topicCount()));
+}
+
+std::string TopicRegistry::name(std::size_t topic) const {
+    if (topic < names.size() && !names[topic].empty()) return names[topic];
+    return "Topic " + std::to_string(topic + 1);
+}
+
+std::string TopicRegistry::listPath(int topic) {
+    return "texts/text" + std::to_string(topic) + ".txt";
+}
+
+int TopicRegistry::topicOfList(const std::string& fileName) {
+    const std::string prefix = "text";
+    const std::string suffix = ".txt";
+    if (fileName.size() <= prefix.size() + suffix.size()) return -1;
+    if (fileName.compare(0, prefix.size(), prefix) != 0) return -1;
+    if (fileName.compare(fileName.size() - suffix.size(), suffix.size(), suffix) != 0) return -1;
+
+    std::string digits = fileName.substr(prefix.size(), fileName.size() - prefix.size() - suffix.size());
+    if (digits.size() > 9) return -1;
+    for (char c : digits) {
+        if (!std::isdigit(static_cast<unsigned char>(c))) return -1;
+    }
+    // A stray text999999.txt would otherwise create a million empty topics
+    int topic = std::stoi(digits);
+    if (topic > MaxTopic) {
+        LOG_WARNING("Ignoring " << fileName << ", topics go up to " << MaxTopic);
+        return -1;
+    }
+    return topic;
+}
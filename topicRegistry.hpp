@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class Catalog;
+
+// Topics known at startup. Topic i lists its slides in texts/text<i>.txt (or
+// the catalog) and takes its title from line i of texts/topics.txt. The count
+// is whichever of these reaches furthest, so adding a lesson needs no code
+// change.
+class TopicRegistry {
+public:
+    TopicRegistry() : count(0) {}
+
+    // Scans the directory for text<N>.txt lists and reads its topics.txt
+    void discover(const std::string& directory = "texts");
+    // Also counts topics that so far only exist in the catalog
+    void include(const Catalog& catalog);
+
+    std::size_t size() const { return count; }
+    bool isEmpty() const { return count == 0; }
+
+    // Title from topics.txt, "Topic N" for topics it does not name
+    std::string name(std::size_t topic) const;
+
+    // Highest topic the catalog can store
+    static const int MaxTopic = 0xFFFF;
+
+    static std::string listPath(int topic);
+    // Topic of a text<N>.txt file name, -1 for any other name or N above MaxTopic
+    static int topicOfList(const std::string& fileName);
+
+private:
+    std::vector<std::string> names;
+    std::size_t count;
+};
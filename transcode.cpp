@@ -0,0 +1,162 @@
+#include <SFML/System.hpp>
+#include "catalog.hpp"
+#include "imageDecoder.hpp"
+#include "ImageFunctions.hpp"
+#include "logger.hpp"
+#include "threadPool.hpp"
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_set>
+#include <vector>
+
+// Offline tool: writes a copy of every image referenced by the catalog in a
+// format that decodes faster, next to the original as images/<name>.qoi or
+// images/<name>.raw. DecoderRegistry::decodeImage reads the copy while it is
+// at least as new as the original, so an edited slide is shown from the
+// original until the tool is run again. QOI is the default: raw decodes
+// fastest but takes 4 bytes per pixel on disk, so it only wins where reading
+// is cheap. The benchmark's decoder bench compares both.
+//
+// usage: transcode [--format qoi|raw] [--force] [--clean]
+
+namespace {
+
+struct TranscodeJob {
+    std::string name;
+    bool written;
+    std::size_t sourceBytes;
+    std::size_t transcodedBytes;
+};
+
+bool isUpToDate(const std::string& path, const std::string& copyPath) {
+    struct stat source;
+    struct stat copy;
+    return stat(path.c_str(), &source) == 0 && stat(copyPath.c_str(), &copy) == 0 && copy.st_mtime >= source.st_mtime;
+}
+
+bool writeFile(const std::string& path, const std::vector<unsigned char>& bytes) {
+    std::string temporaryPath = path + ".tmp";
+    std::FILE* file = std::fopen(temporaryPath.c_str(), "wb");
+    if (!file) return false;
+    bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) {
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+
+    // rename replaces the old file atomically where it can, Windows needs it removed first
+    if (std::rename(temporaryPath.c_str(), path.c_str()) == 0) return true;
+    std::remove(path.c_str());
+    return std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string format = "qoi";
+    bool force = false;
+    bool clean = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            format = argv[++i];
+        } else if (std::strcmp(argv[i], "--force") == 0) {
+            force = true;
+        } else if (std::strcmp(argv[i], "--clean") == 0) {
+            clean = true;
+        }
+    }
+    if (format != "qoi" && format != "raw") {
+        LOG_ERROR("Unknown format, expected qoi or raw: " << format);
+        return 1;
+    }
+    std::string extension = "." + format;
+
+    TopicRegistry topics;
+    topics.discover();
+
+    Catalog catalog;
+    if (!openCatalog(catalog, "texts/catalog.bin", topics)) {
+        LOG_ERROR("Could not open the catalog");
+        return 1;
+    }
+
+    std::vector<TranscodeJob> jobs;
+    std::unordered_set<std::string> seen;
+    for (int topic = 0; topic < catalog.topicCount(); ++topic) {
+        for (const auto& name : catalog.names(topic)) {
+            if (seen.insert(name).second) jobs.push_back(TranscodeJob{name, false, 0, 0});
+        }
+    }
+
+    // Copies in the other formats would shadow the new ones, or are all that --clean wants gone
+    std::size_t removed = 0;
+    for (const auto& job : jobs) {
+        for (const char* other : TranscodedExtensions) {
+            if ((clean || extension != other) && std::remove(("images/" + job.name + other).c_str()) == 0) ++removed;
+        }
+    }
+    if (clean) {
+        LOG_INFO("Removed " << removed << " transcoded images");
+        return 0;
+    }
+
+    ThreadPool pool;
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::size_t done = 0;
+    for (auto& job : jobs) {
+        TranscodeJob* target = &job;
+        pool.submit([target, extension, force, &mutex, &finished, &done] {
+            std::string path = "images/" + target->name;
+            std::string copyPath = path + extension;
+            if (force || !isUpToDate(path, copyPath)) {
+                DecoderRegistry& decoders = DecoderRegistry::instance();
+                std::vector<sf::Uint8> pixels;
+                sf::Vector2u size;
+                std::vector<unsigned char> bytes;
+                struct stat info;
+                if (stat(path.c_str(), &info) == 0 && decoders.decodeFile(path, pixels, size)) {
+                    if (extension == ".qoi") {
+                        encodeQoi(pixels.data(), size, bytes);
+                    } else {
+                        encodeRawImage(pixels.data(), size, bytes);
+                    }
+                    decoders.pool().release(std::move(pixels));
+                    target->written = writeFile(copyPath, bytes);
+                    target->sourceBytes = static_cast<std::size_t>(info.st_size);
+                    target->transcodedBytes = bytes.size();
+                }
+                if (!target->written) LOG_ERROR("Could not transcode image: " << target->name);
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            ++done;
+            finished.notify_all();
+        });
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&done, &jobs] { return done == jobs.size(); });
+    }
+
+    std::size_t written = 0;
+    std::size_t sourceBytes = 0;
+    std::size_t transcodedBytes = 0;
+    for (const auto& job : jobs) {
+        if (!job.written) continue;
+        ++written;
+        sourceBytes += job.sourceBytes;
+        transcodedBytes += job.transcodedBytes;
+    }
+
+    LOG_INFO("Transcoded " << written << " of " << jobs.size() << " images to " << format << " ("
+             << sourceBytes / 1024 << " KiB before, " << transcodedBytes / 1024 << " KiB after, "
+             << jobs.size() - written << " skipped or failed)");
+    return 0;
+}
@@ -0,0 +1,248 @@
+#include "widgets.hpp"
+#include <algorithm>
+#include <cmath>
+
+const WidgetLayer::WidgetId WidgetLayer::None;
+
+namespace {
+
+long long cellKey(int x, int y) {
+    return (static_cast<long long>(x) << 32) ^ static_cast<unsigned>(y);
+}
+
+void appendQuad(sf::VertexArray& vertices, const sf::FloatRect& rect, const sf::Color& color, const sf::FloatRect& texture = sf::FloatRect()) {
+    float left = rect.left, top = rect.top, right = rect.left + rect.width, bottom = rect.top + rect.height;
+    float u0 = texture.left, v0 = texture.top, u1 = texture.left + texture.width, v1 = texture.top + texture.height;
+
+    vertices.append(sf::Vertex(sf::Vector2f(left, top), color, sf::Vector2f(u0, v0)));
+    vertices.append(sf::Vertex(sf::Vector2f(right, top), color, sf::Vector2f(u1, v0)));
+    vertices.append(sf::Vertex(sf::Vector2f(left, bottom), color, sf::Vector2f(u0, v1)));
+    vertices.append(sf::Vertex(sf::Vector2f(left, bottom), color, sf::Vector2f(u0, v1)));
+    vertices.append(sf::Vertex(sf::Vector2f(right, top), color, sf::Vector2f(u1, v0)));
+    vertices.append(sf::Vertex(sf::Vector2f(right, bottom), color, sf::Vector2f(u1, v1)));
+}
+
+} // namespace
+
+WidgetLayer::WidgetLayer(const sf::Font& font, float cellSize)
+    : font(font), cellSize(cellSize), rectsDirty(true), labelsDirty(true), indexDirty(true),
+      rects(sf::Triangles), drawCalls(0) {}
+
+WidgetLayer::WidgetId WidgetLayer::add(const sf::FloatRect& bounds, const sf::Color& fill, const sf::String& label,
+                                       unsigned characterSize, const sf::Color& labelColor, Align align) {
+    Widget widget;
+    widget.bounds = bounds;
+    widget.fill = fill;
+    widget.label = label;
+    widget.characterSize = characterSize;
+    widget.labelColor = labelColor;
+    widget.align = align;
+    widget.visible = true;
+    widget.interactive = true;
+    widget.rectVertex = 0;
+    widgets.push_back(widget);
+
+    rectsDirty = labelsDirty = indexDirty = true;
+    return widgets.size() - 1;
+}
+
+void WidgetLayer::setBounds(WidgetId id, const sf::FloatRect& bounds) {
+    Widget& widget = widgets[id];
+    if (widget.bounds.left == bounds.left && widget.bounds.top == bounds.top &&
+        widget.bounds.width == bounds.width && widget.bounds.height == bounds.height) return;
+
+    widget.bounds = bounds;
+    rectsDirty = labelsDirty = indexDirty = true;
+}
+
+void WidgetLayer::setFill(WidgetId id, const sf::Color& fill) {
+    Widget& widget = widgets[id];
+    if (widget.fill == fill) return;
+
+    // Recolour in place when the widget keeps its quad, transparent widgets have none
+    if ((widget.fill.a == 0) != (fill.a == 0)) {
+        rectsDirty = true;
+    } else if (!rectsDirty && widget.visible && fill.a != 0) {
+        for (std::size_t i = 0; i < 6; ++i) {
+            rects[widget.rectVertex + i].color = fill;
+        }
+    }
+    widget.fill = fill;
+}
+
+void WidgetLayer::setLabel(WidgetId id, const sf::String& label) {
+    Widget& widget = widgets[id];
+    if (widget.label == label) return;
+    widget.label = label;
+    labelsDirty = true;
+}
+
+void WidgetLayer::setLabelColor(WidgetId id, const sf::Color& color) {
+    Widget& widget = widgets[id];
+    if (widget.labelColor == color) return;
+    widget.labelColor = color;
+    labelsDirty = true;
+}
+
+void WidgetLayer::setLabelOffset(WidgetId id, const sf::Vector2f& offset) {
+    widgets[id].labelOffset = offset;
+    labelsDirty = true;
+}
+
+void WidgetLayer::setVisible(WidgetId id, bool visible) {
+    Widget& widget = widgets[id];
+    if (widget.visible == visible) return;
+    widget.visible = visible;
+    rectsDirty = labelsDirty = true;
+}
+
+void WidgetLayer::setInteractive(WidgetId id, bool interactive) {
+    widgets[id].interactive = interactive;
+}
+
+WidgetLayer::WidgetId WidgetLayer::hitTest(const sf::Vector2f& point) const {
+    if (indexDirty) rebuildIndex();
+
+    auto found = cells.find(cellKey(static_cast<int>(std::floor(point.x / cellSize)), static_cast<int>(std::floor(point.y / cellSize))));
+    if (found == cells.end()) return None;
+
+    // Ids are stored in ascending order and later widgets are drawn on top
+    const std::vector<WidgetId>& ids = found->second;
+    for (auto it = ids.rbegin(); it != ids.rend(); ++it) {
+        const Widget& widget = widgets[*it];
+        if (widget.visible && widget.interactive && widget.bounds.contains(point)) return *it;
+    }
+    return None;
+}
+
+void WidgetLayer::draw(sf::RenderTarget& target, sf::RenderStates states) const {
+    if (rectsDirty) rebuildRects();
+    if (labelsDirty) rebuildLabels();
+
+    drawCalls = 0;
+    if (rects.getVertexCount() > 0) {
+        target.draw(rects, states);
+        drawCalls++;
+    }
+
+    for (const auto& batch : labels) {
+        if (batch.second.getVertexCount() == 0) continue;
+        sf::RenderStates textStates = states;
+        textStates.texture = &font.getTexture(batch.first);
+        target.draw(batch.second, textStates);
+        drawCalls++;
+    }
+}
+
+void WidgetLayer::rebuildRects() const {
+    rects.clear();
+    for (const Widget& widget : widgets) {
+        widget.rectVertex = rects.getVertexCount();
+        if (!widget.visible || widget.fill.a == 0) continue;
+        appendQuad(rects, widget.bounds, widget.fill);
+    }
+    rectsDirty = false;
+}
+
+void WidgetLayer::rebuildLabels() const {
+    for (auto& batch : labels) {
+        batch.second.clear();
+    }
+
+    for (const Widget& widget : widgets) {
+        if (!widget.visible || widget.label.isEmpty()) continue;
+
+        auto batch = labels.find(widget.characterSize);
+        if (batch == labels.end()) {
+            batch = labels.emplace(widget.characterSize, sf::VertexArray(sf::Triangles)).first;
+        }
+        appendLabel(widget, batch->second);
+    }
+    labelsDirty = false;
+}
+
+// Lays glyphs out the way sf::Text does, then moves them into place as a block
+void WidgetLayer::appendLabel(const Widget& widget, sf::VertexArray& vertices) const {
+    std::size_t first = vertices.getVertexCount();
+    float lineSpacing = font.getLineSpacing(widget.characterSize);
+    float x = 0.0f;
+    float y = static_cast<float>(widget.characterSize);
+    float minX = 0.0f, minY = 0.0f, maxX = 0.0f, maxY = 0.0f;
+    bool hasGlyph = false;
+    sf::Uint32 previous = 0;
+
+    for (std::size_t i = 0; i < widget.label.getSize(); ++i) {
+        sf::Uint32 current = widget.label[i];
+        x += font.getKerning(previous, current, widget.characterSize);
+        previous = current;
+
+        if (current == '\n') {
+            x = 0.0f;
+            y += lineSpacing;
+            continue;
+        }
+
+        const sf::Glyph& glyph = font.getGlyph(current, widget.characterSize, false);
+        if (current != ' ' && current != '\t') {
+            sf::FloatRect quad(x + glyph.bounds.left, y + glyph.bounds.top, glyph.bounds.width, glyph.bounds.height);
+            sf::FloatRect uv(static_cast<float>(glyph.textureRect.left), static_cast<float>(glyph.textureRect.top),
+                             static_cast<float>(glyph.textureRect.width), static_cast<float>(glyph.textureRect.height));
+            appendQuad(vertices, quad, widget.labelColor, uv);
+
+            if (!hasGlyph) {
+                minX = quad.left;
+                minY = quad.top;
+                maxX = quad.left + quad.width;
+                maxY = quad.top + quad.height;
+                hasGlyph = true;
+            } else {
+                minX = std::min(minX, quad.left);
+                minY = std::min(minY, quad.top);
+                maxX = std::max(maxX, quad.left + quad.width);
+                maxY = std::max(maxY, quad.top + quad.height);
+            }
+        }
+        x += glyph.advance;
+    }
+
+    float width = maxX - minX;
+    float height = maxY - minY;
+    sf::Vector2f origin;
+    switch (widget.align) {
+    case Align::Center:
+        origin = sf::Vector2f(widget.bounds.left + (widget.bounds.width - width) / 2 - minX,
+                              widget.bounds.top + (widget.bounds.height - height) / 2 - minY);
+        break;
+    case Align::TopLeft:
+        origin = sf::Vector2f(widget.bounds.left, widget.bounds.top);
+        break;
+    case Align::TopRight:
+        origin = sf::Vector2f(widget.bounds.left + widget.bounds.width - width - minX, widget.bounds.top);
+        break;
+    }
+    origin += widget.labelOffset;
+
+    // Whole pixels keep the glyphs sharp
+    origin.x = std::floor(origin.x + 0.5f);
+    origin.y = std::floor(origin.y + 0.5f);
+    for (std::size_t i = first; i < vertices.getVertexCount(); ++i) {
+        vertices[i].position += origin;
+    }
+}
+
+void WidgetLayer::rebuildIndex() const {
+    cells.clear();
+    for (WidgetId id = 0; id < widgets.size(); ++id) {
+        const sf::FloatRect& bounds = widgets[id].bounds;
+        int x0 = static_cast<int>(std::floor(bounds.left / cellSize));
+        int y0 = static_cast<int>(std::floor(bounds.top / cellSize));
+        int x1 = static_cast<int>(std::floor((bounds.left + bounds.width) / cellSize));
+        int y1 = static_cast<int>(std::floor((bounds.top + bounds.height) / cellSize));
+        for (int y = y0; y <= y1; ++y) {
+            for (int x = x0; x <= x1; ++x) {
+                cells[cellKey(x, y)].push_back(id);
+            }
+        }
+    }
+    indexDirty = false;
+}
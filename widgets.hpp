@@ -0,0 +1,80 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstddef>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+// Retained set of rectangle widgets with optional text labels.
+//
+// Layout is cached per widget and only rebuilt when a widget changes. All
+// rectangles are drawn with one vertex array and all labels of the same
+// character size with one more, so draw calls do not grow with the widget
+// count. Hit testing goes through a uniform grid over the widget bounds.
+class WidgetLayer : public sf::Drawable {
+public:
+    typedef std::size_t WidgetId;
+    static const WidgetId None = static_cast<WidgetId>(-1);
+
+    enum class Align {
+        Center,   // label centred in the rectangle
+        TopLeft,  // label's top left at the rectangle's top left
+        TopRight  // label's top right at the rectangle's top right
+    };
+
+    explicit WidgetLayer(const sf::Font& font, float cellSize = 64.0f);
+
+    WidgetId add(const sf::FloatRect& bounds, const sf::Color& fill, const sf::String& label = sf::String(),
+                 unsigned characterSize = 20, const sf::Color& labelColor = sf::Color::White, Align align = Align::Center);
+
+    void setBounds(WidgetId id, const sf::FloatRect& bounds);
+    void setFill(WidgetId id, const sf::Color& fill);
+    void setLabel(WidgetId id, const sf::String& label);
+    void setLabelColor(WidgetId id, const sf::Color& color);
+    void setLabelOffset(WidgetId id, const sf::Vector2f& offset);
+    void setVisible(WidgetId id, bool visible);
+    // Widgets that are not interactive are drawn but never returned by hitTest
+    void setInteractive(WidgetId id, bool interactive);
+
+    bool isVisible(WidgetId id) const { return widgets[id].visible; }
+    const sf::FloatRect& getBounds(WidgetId id) const { return widgets[id].bounds; }
+    std::size_t size() const { return widgets.size(); }
+
+    // Topmost visible interactive widget containing the point, or None
+    WidgetId hitTest(const sf::Vector2f& point) const;
+
+    // Number of draw calls the last draw issued
+    std::size_t lastDrawCalls() const { return drawCalls; }
+
+private:
+    struct Widget {
+        sf::FloatRect bounds;
+        sf::Color fill;
+        sf::String label;
+        unsigned characterSize;
+        sf::Color labelColor;
+        sf::Vector2f labelOffset;
+        Align align;
+        bool visible;
+        bool interactive;
+        mutable std::size_t rectVertex; // first vertex in rects, valid while the geometry is not dirty
+    };
+
+    void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
+    void rebuildRects() const;
+    void rebuildLabels() const;
+    void rebuildIndex() const;
+    void appendLabel(const Widget& widget, sf::VertexArray& vertices) const;
+
+    const sf::Font& font;
+    float cellSize;
+    std::vector<Widget> widgets;
+
+    mutable bool rectsDirty;
+    mutable bool labelsDirty;
+    mutable bool indexDirty;
+    mutable sf::VertexArray rects;
+    mutable std::map<unsigned, sf::VertexArray> labels; // one batch per character size
+    mutable std::unordered_map<long long, std::vector<WidgetId>> cells;
+    mutable std::size_t drawCalls;
+};